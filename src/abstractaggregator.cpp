@@ -1,5 +1,7 @@
 #include "abstractaggregator.h"
 
+#include <QAbstractItemModel>
+
 class qdatacube::AbstractAggregatorPrivate {
     public:
         AbstractAggregatorPrivate(const QAbstractItemModel* underlying_model) : m_underlying_model(underlying_model), m_name("unnamed") {
@@ -22,6 +24,46 @@ const QAbstractItemModel* qdatacube::AbstractAggregator::underlyingModel() const
     return d->m_underlying_model;
 }
 
+void qdatacube::AbstractAggregator::categorize(int begin, int end, int* categories) const {
+    if (hasPostings() && end - begin == underlyingModel()->rowCount()) {
+        // Distribute the rows of each category, instead of asking for the category of each row
+        for (int category = 0, ncategories = categoryCount(); category < ncategories; ++category) {
+            Q_FOREACH(int row, postings(category)) {
+                categories[row - begin] = category;
+            }
+        }
+        return;
+    }
+    for (int row = begin; row < end; ++row) {
+        *categories++ = operator()(row);
+    }
+}
+
+bool qdatacube::AbstractAggregator::hasPostings() const {
+    return false;
+}
+
+QVector<int> qdatacube::AbstractAggregator::postings(int category) const {
+    const int nrows = underlyingModel()->rowCount();
+    QVector<int> categories(nrows);
+    categorize(0, nrows, categories.data());
+    QVector<int> rv;
+    for (int row = 0; row < nrows; ++row) {
+        if (categories.at(row) == category) {
+            rv << row;
+        }
+    }
+    return rv;
+}
+
+QVector<int> qdatacube::AbstractAggregator::categoryDisplayPositions() const {
+    return QVector<int>();
+}
+
+bool qdatacube::AbstractAggregator::isThreadSafe() const {
+    return false;
+}
+
 qdatacube::AbstractAggregator::~AbstractAggregator() {
 
 }
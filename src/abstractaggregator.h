@@ -13,6 +13,7 @@
 #include <QString>
 #include <QObject>
 #include <QVariant>
+#include <QVector>
 
 template<class T >
 class QSharedPointer;
@@ -63,6 +64,54 @@ class QDATACUBE_EXPORT AbstractAggregator : public QObject {
         * dtor
         */
         virtual ~AbstractAggregator();
+
+        // Virtuals added in version 3.2 go here, after the older ones, so those keep their vtable slots
+
+        /**
+         * Categorize rows from begin to end (exclusive) in one go, as if by calling operator() for each.
+         * Override this when a batch can be done faster than row by row.
+         * @param categories output, must have room for end-begin categories
+         * Default implementation calls operator() for each row, or reads postings() if hasPostings().
+         */
+        virtual void categorize(int begin, int end, int* categories) const;
+
+        /**
+         * @return true if postings() is cheap, e.g. because the aggregator keeps the rows of each category,
+         * so a category can be enumerated without calling operator() for every row.
+         * Default implementation returns false
+         */
+        virtual bool hasPostings() const;
+
+        /**
+         * @return the rows in category, in ascending order.
+         * Default implementation calls categorize() for all rows. Aggregators returning true from hasPostings() must
+         * override this, and the default categorize() then uses the postings for all rows at once.
+         * Unlike operator(), this is only called from the thread owning the aggregator
+         */
+        virtual QVector<int> postings(int category) const;
+
+        /**
+         * @return the position of each category when displayed, indexed by category, or an empty vector
+         * if categories are displayed in category order.
+         *
+         * This lets an aggregator keep category numbers stable, e.g. by giving new categories the next free
+         * number, while the datacube still shows the categories in sorted order.
+         * Default implementation returns an empty vector
+         */
+        virtual QVector<int> categoryDisplayPositions() const;
+
+        /**
+         * @returns true if operator() and categoryCount() may be called concurrently from several threads,
+         * letting a datacube compute its buckets on the global thread pool while it is built.
+         *
+         * Implementors opting in must only read state in those calls, including the underlying model. The
+         * datacube in turn guarantees that the calls are made from inside a single call to one of its
+         * methods, so that neither the model nor the aggregator can change in between, as long as they
+         * are only changed from the thread owning the datacube.
+         *
+         * Default implementation returns false, leaving the datacube to call operator() from its own thread
+         */
+        virtual bool isThreadSafe() const;
     Q_SIGNALS:
         /**
          * Implementors must emit this signal when a category has been added
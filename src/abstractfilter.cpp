@@ -1,5 +1,9 @@
 #include "abstractfilter.h"
 
+#include <QAbstractItemModel>
+
+#include <algorithm>
+
 namespace qdatacube {
 
 class AbstractFilterPrivate {
@@ -35,6 +39,33 @@ const QAbstractItemModel* AbstractFilter::underlyingModel() const {
     return d->m_underlyingModel;
 }
 
+bool AbstractFilter::isThreadSafe() const {
+    return false;
+}
+
+bool AbstractFilter::hasIncludedRows() const {
+    return false;
+}
+
+QVector<int> AbstractFilter::includedRows() const {
+    QVector<int> rv;
+    for (int row = 0, nrows = underlyingModel()->rowCount(); row < nrows; ++row) {
+        if ((*this)(row)) {
+            rv << row;
+        }
+    }
+    return rv;
+}
+
+void AbstractFilter::evaluate(int begin, int end, quint64* included) const {
+    std::fill(included, included + ((end - begin + 63) >> 6), quint64(0));
+    for (int row = begin; row < end; ++row) {
+        if ((*this)(row)) {
+            included[(row - begin) >> 6] |= quint64(1) << ((row - begin) & 63);
+        }
+    }
+}
+
 AbstractFilter::~AbstractFilter() {
     //empty
 }
@@ -2,6 +2,7 @@
 #define ABSTRACT_FILTER_H
 
 #include <QObject>
+#include <QVector>
 #include "qdatacube_export.h"
 
 template<class T >
@@ -40,6 +41,40 @@ class QDATACUBE_EXPORT AbstractFilter : public QObject {
          * dtor
          */
         virtual ~AbstractFilter();
+
+        // Virtuals added in version 3.2 go here, after the older ones, so those keep their vtable slots
+
+        /**
+         * @return true if operator() and evaluate() may be called concurrently from several threads,
+         * letting a datacube evaluate the filter over blocks of rows on the global thread pool when it
+         * works out which rows the filter rejects, e.g. while it is built or when the filter is added.
+         * The contract is as for AbstractAggregator::isThreadSafe(): those calls must only read state,
+         * and the datacube only makes them concurrently from inside one of its own methods.
+         * Default implementation returns false.
+         */
+        virtual bool isThreadSafe() const;
+
+        /**
+         * @return true if includedRows() is cheap, e.g. because the filter reads the postings of an aggregator,
+         * so a datacube can find the rows without calling operator() for every row.
+         * Default implementation returns false
+         */
+        virtual bool hasIncludedRows() const;
+
+        /**
+         * @return the rows to be included, in ascending order.
+         * Default implementation calls operator() for every row
+         */
+        virtual QVector<int> includedRows() const;
+
+        /**
+         * Evaluate the rows from begin up to (not including) end in one go, as if by calling operator() for each.
+         * Bit i of included (bit i%64 of word i/64) is set if row begin+i is to be included, and the
+         * (end-begin+63)/64 words of included are overwritten.
+         * Reimplement if the filter can do better than a call per row, e.g. through AbstractAggregator::categorize().
+         * Default implementation calls operator() for each row
+         */
+        virtual void evaluate(int begin, int end, quint64* included) const;
     protected:
         /**
          * sets name of this filter to \param newName
@@ -78,6 +78,10 @@ QString AbstractFormatter::shortName() const {
     return d->m_shortName;
 }
 
+QString AbstractFormatter::formatRange(const ElementRange& elements) const {
+  return format(elements.toList());
+}
+
 AbstractFormatter::~AbstractFormatter()
 {
 
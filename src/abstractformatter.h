@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include "qdatacube_export.h"
+#include "elementrange.h"
 #include <QSize>
 #include <QWidget>
 
@@ -111,6 +112,13 @@ class QDATACUBE_EXPORT AbstractFormatter : public QObject {
          */
         virtual void update(AbstractFormatter::UpdateType element);
 
+    public:
+        // Virtuals added in version 3.2 go here, after the older ones, so those keep their vtable slots
+        /**
+         * @return elements formatted as format() would. The default implementation copies the elements to
+         * a list and calls format(); reimplement it to read the range in place.
+         */
+        virtual QString formatRange(const ElementRange& elements) const;
 
     private:
         QScopedPointer<AbstractFormatterPrivate> d;
@@ -1,11 +1,12 @@
 #include "andfilter.h"
+#include "filtercombination.h"
 #include <QSharedPointer>
 
 namespace qdatacube {
 class AndFilterPrivate {
 public:
-    AndFilterPrivate() {};
-    QList<AbstractFilter::Ptr> m_filterComponents;
+    AndFilterPrivate() : m_filterComponents(FilterOrder::StopOnReject) {};
+    FilterCombination m_filterComponents;
 };
 
 AndFilter::AndFilter(QAbstractItemModel* underlyingModel): AbstractFilter(underlyingModel), d(new AndFilterPrivate()) {}
@@ -15,13 +16,36 @@ void AndFilter::addFilter(AbstractFilter::Ptr filter) {
     d->m_filterComponents.append(filter);
 }
 
+QList<AbstractFilter::Ptr> AndFilter::filters() const {
+    return d->m_filterComponents.filters();
+}
+
 bool AndFilter::operator()(int row) const {
-    Q_FOREACH(AbstractFilter::Ptr filter, d->m_filterComponents) {
-       if(!(*filter)(row))  {
-           return false;
-       }
-    }
-    return true;
+    return d->m_filterComponents(row);
+}
+
+void AndFilter::evaluate(int begin, int end, quint64* included) const {
+    d->m_filterComponents.evaluate(*this, begin, end, included);
+}
+
+const FilterCombination& AndFilter::combination() const {
+    return d->m_filterComponents;
+}
+
+bool AndFilter::isThreadSafe() const {
+    return d->m_filterComponents.isThreadSafe();
+}
+
+QList<FilterStatistics> AndFilter::statistics() const {
+    return d->m_filterComponents.statistics();
+}
+
+void AndFilter::setAdaptive(bool adaptive) {
+    d->m_filterComponents.setAdaptive(adaptive);
+}
+
+bool AndFilter::isAdaptive() const {
+    return d->m_filterComponents.isAdaptive();
 }
 
 AndFilter::~AndFilter() {}
@@ -0,0 +1,127 @@
+#include "bucketindex.h"
+
+namespace qdatacube {
+
+namespace {
+
+/**
+ * @return position of the n'th (0-based) set bit in word
+ */
+int select_in_word(quint64 word, int n) {
+  int pos = 0;
+  for (int width = 32; width > 0; width >>= 1) {
+    const quint64 low = word & ((Q_UINT64_C(1) << width) - 1);
+    const int low_count = qPopulationCount(low);
+    if (n >= low_count) {
+      n -= low_count;
+      word >>= width;
+      pos += width;
+    } else {
+      word = low;
+    }
+  }
+  return pos;
+}
+
+}
+
+BucketIndex::BucketIndex() :
+    m_size(0),
+    m_count(0),
+    m_top_step(0)
+{
+}
+
+void BucketIndex::reset(const QVector< unsigned int >& counts) {
+  m_size = counts.size();
+  m_words = QVector<quint64>((m_size + 63) >> 6);
+  for (int bucket = 0; bucket < m_size; ++bucket) {
+    if (counts.at(bucket) > 0) {
+      m_words[bucket >> 6] |= Q_UINT64_C(1) << (bucket & 63);
+    }
+  }
+  build_tree();
+}
+
+void BucketIndex::reset(int size, const QVector<int>& non_empty_buckets) {
+  m_size = size;
+  m_words = QVector<quint64>((m_size + 63) >> 6);
+  Q_FOREACH(int bucket, non_empty_buckets) {
+    Q_ASSERT(bucket >= 0 && bucket < m_size);
+    m_words[bucket >> 6] |= Q_UINT64_C(1) << (bucket & 63);
+  }
+  build_tree();
+}
+
+void BucketIndex::build_tree() {
+  const int nwords = m_words.size();
+  m_tree = QVector<int>(nwords + 1);
+  m_count = 0;
+  // Linear time construction: each node pushes its sum to its parent
+  for (int i = 1; i <= nwords; ++i) {
+    const int popcount = qPopulationCount(m_words.at(i-1));
+    m_count += popcount;
+    m_tree[i] += popcount;
+    const int parent = i + (i & -i);
+    if (parent <= nwords) {
+      m_tree[parent] += m_tree.at(i);
+    }
+  }
+  m_top_step = 1;
+  while (m_top_step * 2 <= nwords) {
+    m_top_step *= 2;
+  }
+}
+
+void BucketIndex::add_to_tree(int word, int delta) {
+  for (int i = word + 1; i < m_tree.size(); i += i & -i) {
+    m_tree[i] += delta;
+  }
+  m_count += delta;
+}
+
+void BucketIndex::insert(int bucket) {
+  Q_ASSERT(bucket >= 0 && bucket < m_size);
+  Q_ASSERT(!contains(bucket));
+  m_words[bucket >> 6] |= Q_UINT64_C(1) << (bucket & 63);
+  add_to_tree(bucket >> 6, 1);
+}
+
+void BucketIndex::remove(int bucket) {
+  Q_ASSERT(bucket >= 0 && bucket < m_size);
+  Q_ASSERT(contains(bucket));
+  m_words[bucket >> 6] &= ~(Q_UINT64_C(1) << (bucket & 63));
+  add_to_tree(bucket >> 6, -1);
+}
+
+int BucketIndex::rank(int bucket) const {
+  Q_ASSERT(bucket >= 0 && bucket <= m_size);
+  const int word = bucket >> 6;
+  int rv = 0;
+  for (int i = word; i > 0; i -= i & -i) {
+    rv += m_tree.at(i);
+  }
+  if (bucket & 63) {
+    rv += qPopulationCount(m_words.at(word) & ((Q_UINT64_C(1) << (bucket & 63)) - 1));
+  }
+  return rv;
+}
+
+int BucketIndex::select(int section) const {
+  if (section < 0 || section >= m_count) {
+    return -1;
+  }
+  // Find the word holding the section by descending the tree
+  int word = 0;
+  int remaining = section;
+  for (int step = m_top_step; step > 0; step >>= 1) {
+    const int next = word + step;
+    if (next < m_tree.size() && m_tree.at(next) <= remaining) {
+      word = next;
+      remaining -= m_tree.at(next);
+    }
+  }
+  return (word << 6) + select_in_word(m_words.at(word), remaining);
+}
+
+} // end of namespace
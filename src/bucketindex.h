@@ -0,0 +1,85 @@
+#ifndef QDATACUBE_BUCKETINDEX_H
+#define QDATACUBE_BUCKETINDEX_H
+
+#include <QVector>
+
+namespace qdatacube {
+
+/**
+ * Rank/select index over the non-empty buckets in one direction of a datacube,
+ * that is, the mapping between buckets and sections.
+ *
+ * A bit per bucket marks it as non-empty, and a Fenwick tree over the population count
+ * of each 64 bit word of the bitmap gives the number of non-empty buckets before any word.
+ * Both rank and select are O(log n), as is marking a bucket empty or non-empty.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class BucketIndex {
+    public:
+        BucketIndex();
+
+        /**
+         * Rebuild the index from counts, where buckets with a count above 0 are non-empty. O(n)
+         */
+        void reset(const QVector<unsigned>& counts);
+
+        /**
+         * Rebuild the index for size buckets, of which non_empty_buckets (in any order) are non-empty.
+         * O(n/64) plus the number of non-empty buckets
+         */
+        void reset(int size, const QVector<int>& non_empty_buckets);
+
+        /**
+         * Mark bucket as non-empty
+         */
+        void insert(int bucket);
+
+        /**
+         * Mark bucket as empty
+         */
+        void remove(int bucket);
+
+        /**
+         * @return true if bucket is non-empty
+         */
+        bool contains(int bucket) const {
+            return m_words.at(bucket >> 6) & (Q_UINT64_C(1) << (bucket & 63));
+        }
+
+        /**
+         * @return number of non-empty buckets before bucket, i.e. the section of bucket if it is non-empty
+         */
+        int rank(int bucket) const;
+
+        /**
+         * @return the non-empty bucket for section, or -1 if there are too few non-empty buckets
+         */
+        int select(int section) const;
+
+        /**
+         * @return number of non-empty buckets
+         */
+        int count() const {
+            return m_count;
+        }
+
+        /**
+         * @return number of buckets, empty or not
+         */
+        int size() const {
+            return m_size;
+        }
+
+    private:
+        void build_tree();
+        void add_to_tree(int word, int delta);
+        QVector<quint64> m_words;
+        QVector<int> m_tree; // Fenwick tree over population counts of m_words, 1-based
+        int m_size;
+        int m_count;
+        int m_top_step; // largest power of two not above m_words.size()
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_BUCKETINDEX_H
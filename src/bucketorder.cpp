@@ -0,0 +1,66 @@
+#include "bucketorder.h"
+
+#include "abstractaggregator.h"
+
+namespace qdatacube {
+
+BucketOrder::BucketOrder()
+{
+}
+
+void BucketOrder::reset(const QList<QSharedPointer<AbstractAggregator> >& aggregators) {
+  m_permuted.clear();
+  int stride = 1;
+  for (int level = aggregators.size() - 1; level >= 0; --level) {
+    const AbstractAggregator* aggregator = aggregators.at(level).data();
+    const int ncats = aggregator->categoryCount();
+    const QVector<int> positions = aggregator->categoryDisplayPositions();
+    bool identity = true;
+    for (int category = 0; category < positions.size() && identity; ++category) {
+      identity = positions.at(category) == category;
+    }
+    if (!identity) {
+      Q_ASSERT(positions.size() == ncats);
+      Level permuted;
+      permuted.level = level;
+      permuted.stride = stride;
+      permuted.ncats = ncats;
+      permuted.positions = positions;
+      permuted.categories = QVector<int>(ncats);
+      for (int category = 0; category < ncats; ++category) {
+        permuted.categories[positions.at(category)] = category;
+      }
+      m_permuted << permuted;
+    }
+    stride *= ncats;
+  }
+}
+
+int BucketOrder::toDisplay(int bucket) const {
+  int rv = bucket;
+  for (QVector<Level>::const_iterator it = m_permuted.constBegin(), iend = m_permuted.constEnd(); it != iend; ++it) {
+    const int category = (bucket / it->stride) % it->ncats;
+    rv += (it->positions.at(category) - category) * it->stride;
+  }
+  return rv;
+}
+
+int BucketOrder::toBucket(int display_bucket) const {
+  int rv = display_bucket;
+  for (QVector<Level>::const_iterator it = m_permuted.constBegin(), iend = m_permuted.constEnd(); it != iend; ++it) {
+    const int position = (display_bucket / it->stride) % it->ncats;
+    rv += (it->categories.at(position) - position) * it->stride;
+  }
+  return rv;
+}
+
+int BucketOrder::category(int level, int position) const {
+  for (QVector<Level>::const_iterator it = m_permuted.constBegin(), iend = m_permuted.constEnd(); it != iend; ++it) {
+    if (it->level == level) {
+      return it->categories.at(position);
+    }
+  }
+  return position;
+}
+
+} // end of namespace
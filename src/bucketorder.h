@@ -0,0 +1,67 @@
+#ifndef QDATACUBE_BUCKETORDER_H
+#define QDATACUBE_BUCKETORDER_H
+
+#include <QList>
+#include <QSharedPointer>
+#include <QVector>
+
+namespace qdatacube {
+
+class AbstractAggregator;
+
+/**
+ * Maps between the buckets in one direction of a datacube and the order they are displayed in.
+ *
+ * Buckets are numbered in mixed radix by the category numbers of the aggregators, the first aggregator
+ * being the most significant digit. Aggregators may display their categories in another order
+ * (see AbstractAggregator::categoryDisplayPositions()), so each bucket also has a display bucket, numbered
+ * the same way but by display positions. Sections are ranks among the non-empty display buckets.
+ *
+ * Only the aggregators with a display order of their own cost anything in the conversions.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class BucketOrder {
+    public:
+        BucketOrder();
+
+        /**
+         * Recompute the order from the current categories of aggregators
+         */
+        void reset(const QList<QSharedPointer<AbstractAggregator> >& aggregators);
+
+        /**
+         * @return true if buckets are displayed in bucket order
+         */
+        bool isIdentity() const {
+            return m_permuted.isEmpty();
+        }
+
+        /**
+         * @return display bucket for bucket
+         */
+        int toDisplay(int bucket) const;
+
+        /**
+         * @return bucket for display bucket
+         */
+        int toBucket(int display_bucket) const;
+
+        /**
+         * @return the category of the aggregator at level shown at position
+         */
+        int category(int level, int position) const;
+
+    private:
+        struct Level {
+            int level;
+            int stride;
+            int ncats;
+            QVector<int> positions; // display position of each category
+            QVector<int> categories; // category at each display position
+        };
+        QVector<Level> m_permuted; // only the aggregators not displayed in category order
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_BUCKETORDER_H
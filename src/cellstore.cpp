@@ -0,0 +1,352 @@
+#include "cellstore.h"
+
+#include <algorithm>
+
+namespace qdatacube {
+
+namespace {
+const long free_key = -1;
+const long deleted_key = -2;
+const int min_slots = 16;
+// Compacting small arrays is not worth the trouble
+const int min_compact_size = 64;
+}
+
+CellStore::CellStore() :
+    m_used(0),
+    m_deleted(0),
+    m_live_capacity(0),
+    m_element_count(0),
+    m_shift(64)
+{
+}
+
+int CellStore::find_slot(long cell) const {
+  if (m_keys.isEmpty()) {
+    return -1;
+  }
+  const int mask = m_keys.size() - 1;
+  // Fibonacci hashing, the top bits of the product are the slot
+  for (int slot = int((quint64(cell) * Q_UINT64_C(0x9E3779B97F4A7C15)) >> m_shift); ; slot = (slot+1) & mask) {
+    const long key = m_keys.at(slot);
+    if (key == cell) {
+      return slot;
+    }
+    if (key == free_key) {
+      return -1;
+    }
+  }
+}
+
+int CellStore::next_used_slot(int slot) const {
+  while (slot < m_keys.size() && m_keys.at(slot) < 0) {
+    ++slot;
+  }
+  return slot;
+}
+
+void CellStore::rehash(int nslots) {
+  Q_ASSERT((nslots & (nslots-1)) == 0);
+  const QVector<long> old_keys = m_keys;
+  const QVector<Extent> old_extents = m_extents;
+  m_keys = QVector<long>(nslots, free_key);
+  m_extents = QVector<Extent>(nslots);
+  m_shift = 64;
+  for (int n = nslots; n > 1; n >>= 1) {
+    --m_shift;
+  }
+  m_deleted = 0;
+  const int mask = nslots - 1;
+  for (int old_slot = 0; old_slot < old_keys.size(); ++old_slot) {
+    const long cell = old_keys.at(old_slot);
+    if (cell < 0) {
+      continue;
+    }
+    int slot = int((quint64(cell) * Q_UINT64_C(0x9E3779B97F4A7C15)) >> m_shift);
+    while (m_keys.at(slot) != free_key) {
+      slot = (slot+1) & mask;
+    }
+    m_keys[slot] = cell;
+    m_extents[slot] = old_extents.at(old_slot);
+  }
+}
+
+int CellStore::insert_slot(long cell) {
+  Q_ASSERT(cell >= 0);
+  Q_ASSERT(find_slot(cell) == -1);
+  // Keep at most 3/4 of the slots in use, counting deleted ones as they still lengthen the probes
+  if ((m_used + m_deleted + 1) * 4 > m_keys.size() * 3) {
+    int nslots = min_slots;
+    while (nslots < (m_used + 1) * 2) {
+      nslots *= 2;
+    }
+    rehash(nslots);
+  }
+  const int mask = m_keys.size() - 1;
+  int slot = int((quint64(cell) * Q_UINT64_C(0x9E3779B97F4A7C15)) >> m_shift);
+  while (m_keys.at(slot) >= 0) {
+    slot = (slot+1) & mask;
+  }
+  if (m_keys.at(slot) == deleted_key) {
+    --m_deleted;
+  }
+  m_keys[slot] = cell;
+  m_extents[slot] = Extent();
+  ++m_used;
+  return slot;
+}
+
+void CellStore::erase_slot(int slot) {
+  Extent& extent = m_extents[slot];
+  m_live_capacity -= extent.capacity;
+  m_element_count -= extent.size;
+  extent = Extent();
+  m_keys[slot] = deleted_key;
+  --m_used;
+  ++m_deleted;
+  if (m_used == 0) {
+    clear();
+  }
+}
+
+void CellStore::compact() {
+  QVector<int> elements;
+  elements.reserve(m_element_count);
+  for (int slot = 0; slot < m_keys.size(); ++slot) {
+    if (m_keys.at(slot) < 0) {
+      continue;
+    }
+    Extent& extent = m_extents[slot];
+    const int offset = elements.size();
+    elements.resize(offset + extent.size);
+    std::copy(m_elements.constData() + extent.offset, m_elements.constData() + extent.offset + extent.size, elements.data() + offset);
+    extent.offset = offset;
+    extent.capacity = extent.size;
+  }
+  m_elements = elements;
+  m_live_capacity = m_element_count;
+}
+
+void CellStore::reserve_in_slot(int slot, int needed) {
+  if (needed <= m_extents.at(slot).capacity) {
+    return;
+  }
+  const int capacity = m_extents.at(slot).capacity;
+  const int new_capacity = qMax(needed, capacity * 2);
+  const bool last = capacity > 0 && m_extents.at(slot).offset + capacity == m_elements.size();
+  if (!last) {
+    // Moving the range leaves a hole. Reclaim the holes if they would take up more than half
+    const int holes = m_elements.size() - m_live_capacity + capacity;
+    if (m_elements.size() > min_compact_size && holes * 2 > m_elements.size()) {
+      compact();
+    }
+  }
+  Extent& extent = m_extents[slot];
+  const int old_size = m_elements.size();
+  const int new_size = (extent.capacity > 0 && extent.offset + extent.capacity == old_size) ? extent.offset + new_capacity : old_size + new_capacity;
+  if (new_size > m_elements.capacity()) {
+    m_elements.reserve(qMax(new_size, m_elements.capacity() * 2));
+  }
+  m_elements.resize(new_size);
+  if (extent.offset + extent.capacity != old_size || extent.capacity == 0) {
+    int* data = m_elements.data();
+    std::copy(data + extent.offset, data + extent.offset + extent.size, data + old_size);
+    extent.offset = old_size;
+  }
+  m_live_capacity += new_capacity - extent.capacity;
+  extent.capacity = new_capacity;
+}
+
+int CellStore::size(long cell) const {
+  const int slot = find_slot(cell);
+  return slot < 0 ? 0 : m_extents.at(slot).size;
+}
+
+bool CellStore::contains(long cell) const {
+  return find_slot(cell) >= 0;
+}
+
+bool CellStore::contains(long cell, int element) const {
+  const int slot = find_slot(cell);
+  if (slot < 0) {
+    return false;
+  }
+  const Extent& extent = m_extents.at(slot);
+  const int* begin = m_elements.constData() + extent.offset;
+  return std::find(begin, begin + extent.size, element) != begin + extent.size;
+}
+
+QList< int > CellStore::elements(long cell) const {
+  QList<int> rv;
+  const int slot = find_slot(cell);
+  if (slot >= 0) {
+    const Extent& extent = m_extents.at(slot);
+    rv.reserve(extent.size);
+    for (const int* it = m_elements.constData() + extent.offset, *end = it + extent.size; it != end; ++it) {
+      rv << *it;
+    }
+  }
+  return rv;
+}
+
+void CellStore::append(long cell, int element) {
+  int slot = find_slot(cell);
+  if (slot < 0) {
+    slot = insert_slot(cell);
+  }
+  reserve_in_slot(slot, m_extents.at(slot).size + 1);
+  Extent& extent = m_extents[slot];
+  m_elements[extent.offset + extent.size] = element;
+  ++extent.size;
+  ++m_element_count;
+}
+
+void CellStore::append(long cell, const QList< int >& elements) {
+  if (elements.isEmpty()) {
+    return;
+  }
+  int slot = find_slot(cell);
+  if (slot < 0) {
+    slot = insert_slot(cell);
+  }
+  reserve_in_slot(slot, m_extents.at(slot).size + elements.size());
+  Extent& extent = m_extents[slot];
+  std::copy(elements.constBegin(), elements.constEnd(), m_elements.data() + extent.offset + extent.size);
+  extent.size += elements.size();
+  m_element_count += elements.size();
+}
+
+bool CellStore::removeOne(long cell, int element) {
+  const int slot = find_slot(cell);
+  if (slot < 0) {
+    return false;
+  }
+  Extent& extent = m_extents[slot];
+  int* begin = m_elements.data() + extent.offset;
+  int* end = begin + extent.size;
+  int* it = std::find(begin, end, element);
+  if (it == end) {
+    return false;
+  }
+  std::copy(it + 1, end, it);
+  --extent.size;
+  --m_element_count;
+  if (extent.size == 0) {
+    erase_slot(slot);
+  }
+  return true;
+}
+
+void CellStore::set(long cell, const QList< int >& elements) {
+  int slot = find_slot(cell);
+  if (elements.isEmpty()) {
+    if (slot >= 0) {
+      erase_slot(slot);
+    }
+    return;
+  }
+  if (slot < 0) {
+    slot = insert_slot(cell);
+  }
+  m_element_count -= m_extents.at(slot).size;
+  m_extents[slot].size = 0;
+  reserve_in_slot(slot, elements.size());
+  Extent& extent = m_extents[slot];
+  std::copy(elements.constBegin(), elements.constEnd(), m_elements.data() + extent.offset);
+  extent.size = elements.size();
+  m_element_count += elements.size();
+}
+
+void CellStore::assign(const QVector< long >& cell_for_element) {
+  clear();
+  // Count the elements of each cell, using the capacity as counter
+  for (int element = 0; element < cell_for_element.size(); ++element) {
+    const long cell = cell_for_element.at(element);
+    if (cell < 0) {
+      continue;
+    }
+    int slot = find_slot(cell);
+    if (slot < 0) {
+      slot = insert_slot(cell);
+    }
+    ++m_extents[slot].capacity;
+  }
+  // Lay out the ranges in slot order
+  int offset = 0;
+  for (int slot = 0; slot < m_keys.size(); ++slot) {
+    if (m_keys.at(slot) >= 0) {
+      m_extents[slot].offset = offset;
+      offset += m_extents.at(slot).capacity;
+    }
+  }
+  m_elements.resize(offset);
+  m_live_capacity = offset;
+  m_element_count = offset;
+  // The table is not rehashed any more, so the slots found now are final
+  int* elements = m_elements.data();
+  for (int element = 0; element < cell_for_element.size(); ++element) {
+    const long cell = cell_for_element.at(element);
+    if (cell < 0) {
+      continue;
+    }
+    Extent& extent = m_extents[find_slot(cell)];
+    elements[extent.offset + extent.size++] = element;
+  }
+}
+
+void CellStore::remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows) {
+  Q_ASSERT(row_map.isEmpty() || row_map.size() == nrows);
+  for (int slot = 0; slot < m_keys.size(); ++slot) {
+    const long cell = m_keys.at(slot);
+    if (cell < 0) {
+      continue;
+    }
+    const long row = row_map.isEmpty() ? cell % nrows : row_map.at(cell % nrows);
+    const long column = column_map.isEmpty() ? cell / nrows : column_map.at(cell / nrows);
+    if (row < 0 || column < 0) {
+      erase_slot(slot); // Clears the store if it was the last cell, ending the loop
+    } else {
+      m_keys[slot] = row + column*new_nrows;
+    }
+  }
+  if (!m_keys.isEmpty()) {
+    rehash(m_keys.size());
+  }
+}
+
+void CellStore::clear() {
+  m_keys = QVector<long>();
+  m_extents = QVector<Extent>();
+  m_elements = QVector<int>();
+  m_used = 0;
+  m_deleted = 0;
+  m_live_capacity = 0;
+  m_element_count = 0;
+  m_shift = 64;
+}
+
+void CellStore::squeeze() {
+  if (m_used == 0) {
+    clear();
+    return;
+  }
+  compact();
+  m_elements.squeeze();
+  // Smallest table within the load limit
+  int nslots = min_slots;
+  while (m_used * 4 > nslots * 3) {
+    nslots *= 2;
+  }
+  if (nslots != m_keys.size() || m_deleted > 0) {
+    rehash(nslots);
+  }
+}
+
+qint64 CellStore::memoryUsage() const {
+  return sizeof(*this)
+      + qint64(m_keys.capacity()) * sizeof(long)
+      + qint64(m_extents.capacity()) * sizeof(Extent)
+      + qint64(m_elements.capacity()) * sizeof(int);
+}
+
+} // end of namespace
@@ -0,0 +1,221 @@
+#ifndef QDATACUBE_CELLSTORE_H
+#define QDATACUBE_CELLSTORE_H
+
+#include <QList>
+#include <QVector>
+
+namespace qdatacube {
+
+/**
+ * Compact storage of the elements in the cells of a datacube, keyed by cell index
+ * (bucket_row + bucket_column*number_of_row_buckets).
+ *
+ * All elements live in one contiguous array, where each non-empty cell owns a range
+ * given by offset, size and capacity. The ranges are found through an open addressing
+ * hash table over the cell indexes, so there is no heap allocation per cell.
+ *
+ * A cell that runs out of slack is grown in place if it is the last range in the array,
+ * otherwise moved to the end of the array with double capacity. The holes left behind are
+ * reclaimed by compacting the array once they make up more than half of it.
+ *
+ * Element order within a cell is preserved.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class CellStore {
+    private:
+        struct Extent {
+            Extent() : offset(0), size(0), capacity(0) {}
+            int offset;
+            int size;
+            int capacity;
+        };
+    public:
+        CellStore();
+
+        /**
+         * @return number of elements in cell
+         */
+        int size(long cell) const;
+
+        /**
+         * @return true if cell has any elements
+         */
+        bool contains(long cell) const;
+
+        /**
+         * @return true if cell contains element
+         */
+        bool contains(long cell, int element) const;
+
+        /**
+         * @return elements in cell, or an empty list
+         */
+        QList<int> elements(long cell) const;
+
+        /**
+         * Append element to cell
+         */
+        void append(long cell, int element);
+
+        /**
+         * Append elements to cell
+         */
+        void append(long cell, const QList<int>& elements);
+
+        /**
+         * Remove first occurrence of element from cell. The cell is removed when it becomes empty
+         * @return true if element was found
+         */
+        bool removeOne(long cell, int element);
+
+        /**
+         * Replace content of cell with elements. An empty list removes the cell
+         */
+        void set(long cell, const QList<int>& elements);
+
+        /**
+         * Replace the content of the store, putting each element e in cell cell_for_element[e],
+         * or in no cell if that is negative. The elements are counting sorted straight into
+         * place, in ascending order within each cell, and without slack.
+         */
+        void assign(const QVector<long>& cell_for_element);
+
+        /**
+         * Move the cells to new bucket coordinates, as when the buckets of a datacube are laid out anew:
+         * cell r + c*nrows moves to row_map[r] + column_map[c]*new_nrows, or is dropped if either is -1.
+         * An empty map leaves that coordinate as it is. Only the cell indexes are touched, the elements stay put.
+         */
+        void remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows);
+
+        /**
+         * Remove all cells
+         */
+        void clear();
+
+        /**
+         * @return number of non-empty cells
+         */
+        int count() const {
+            return m_used;
+        }
+
+        /**
+         * @return total number of elements in all cells
+         */
+        int elementCount() const {
+            return m_element_count;
+        }
+
+        /**
+         * Move all cells together and drop any slack
+         */
+        void squeeze();
+
+        /**
+         * @return approximate number of bytes allocated by the store
+         */
+        qint64 memoryUsage() const;
+
+        /**
+         * Iterator over the non-empty cells, in no particular order
+         */
+        class const_iterator {
+            public:
+                long key() const {
+                    return m_store->m_keys.at(m_slot);
+                }
+                int size() const {
+                    return m_store->m_extents.at(m_slot).size;
+                }
+                const int* begin() const {
+                    return m_store->m_elements.constData() + m_store->m_extents.at(m_slot).offset;
+                }
+                const int* end() const {
+                    return begin() + size();
+                }
+                QList<int> value() const {
+                    return m_store->elements(key());
+                }
+                const_iterator& operator++() {
+                    m_slot = m_store->next_used_slot(m_slot+1);
+                    return *this;
+                }
+                bool operator==(const const_iterator& rhs) const {
+                    return m_slot == rhs.m_slot;
+                }
+                bool operator!=(const const_iterator& rhs) const {
+                    return m_slot != rhs.m_slot;
+                }
+            protected:
+                const_iterator(const CellStore* store, int slot) : m_store(store), m_slot(slot) {}
+                const CellStore* m_store;
+                int m_slot;
+                friend class CellStore;
+        };
+
+        /**
+         * Iterator allowing the elements to be changed in place
+         */
+        class iterator : public const_iterator {
+            public:
+                int* begin() const {
+                    return const_cast<CellStore*>(m_store)->m_elements.data() + m_store->m_extents.at(m_slot).offset;
+                }
+                int* end() const {
+                    return begin() + size();
+                }
+                iterator& operator++() {
+                    const_iterator::operator++();
+                    return *this;
+                }
+            private:
+                iterator(CellStore* store, int slot) : const_iterator(store, slot) {}
+                friend class CellStore;
+        };
+
+        /**
+         * @return iterator at cell, or constEnd() if it is empty
+         */
+        const_iterator constFind(long cell) const {
+            const int slot = find_slot(cell);
+            return slot < 0 ? constEnd() : const_iterator(this, slot);
+        }
+
+        const_iterator constBegin() const {
+            return const_iterator(this, next_used_slot(0));
+        }
+        const_iterator constEnd() const {
+            return const_iterator(this, m_keys.size());
+        }
+        iterator begin() {
+            return iterator(this, next_used_slot(0));
+        }
+        iterator end() {
+            return iterator(this, m_keys.size());
+        }
+
+    private:
+        int find_slot(long cell) const;
+        int insert_slot(long cell);
+        void erase_slot(int slot);
+        void rehash(int nslots);
+        int next_used_slot(int slot) const;
+        /**
+         * Make room for at least needed elements in the range of slot, moving it if neccessary
+         */
+        void reserve_in_slot(int slot, int needed);
+        void compact();
+
+        QVector<long> m_keys; // cell index per slot, or one of the free markers
+        QVector<Extent> m_extents; // range in m_elements per slot
+        QVector<int> m_elements;
+        int m_used; // number of slots holding a cell
+        int m_deleted; // number of slots marked as deleted
+        int m_live_capacity; // sum of capacities of all cells, the rest of m_elements is holes
+        int m_element_count;
+        int m_shift;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_CELLSTORE_H
@@ -9,42 +9,147 @@
 #include <QStringList>
 #include <QAbstractItemModel>
 #include <QSet>
+#include <algorithm>
 
 namespace qdatacube {
 
 class ColumnAggregatorPrivate {
   public:
-    ColumnAggregatorPrivate(ColumnAggregator* columnaggregator, int section) : q(columnaggregator), section(section), trim_right(false), max_chars(3), possible_removed_counts(0) {
+    ColumnAggregatorPrivate(ColumnAggregator* columnaggregator, int section) : q(columnaggregator), section(section), trim_right(false), max_chars(3), ntombstones(0), postings_valid(false) {
     }
     ColumnAggregator* q;
-    QStringList categories;
+    QStringList categories; // in order of appearance, new categories getting the next number
     typedef QHash<QString, int> cat_map_t;
-    cat_map_t cat_map;
+    cat_map_t cat_map; // code of each category string
+    QVector<int> display_positions; // sorted position of each category
     int section;
     bool trim_right;
     int max_chars;
-    int possible_removed_counts;
+    // Each row has a code that is never renumbered when a category is removed, so removing one only renumbers the
+    // categories after it, not the rows. The code of a removed category is left as a tombstone until compact()
+    QVector<int> row_codes; // code for each row in the model, kept up to date from the model signals
+    QVector<int> code_categories; // category of each code, or -1 for a tombstone
+    QVector<int> category_codes; // code of each category
+    int ntombstones;
+    QVector<int> category_counts; // number of rows in each category
+    mutable QVector<QVector<int> > postings; // sorted rows of each category, if postings_valid
+    mutable bool postings_valid;
+    /**
+     * Build postings from row_codes, if not valid
+     */
+    void ensure_postings() const;
     void add_new_category(QString data);
     void remove_category(QString category);
+    /**
+     * Count row out of its category, removing the category if it was the last row in it
+     */
+    void release_category(int category);
+    /**
+     * Replace all categories with the unique strings in sorted_categories, which must be sorted
+     */
+    void set_categories(const QStringList& sorted_categories);
+    /**
+     * @return the category string of row in the model, trimmed if requested
+     */
+    QString row_value(int row) const;
+    /**
+     * Recompute row_codes and category_counts for all rows from the model
+     */
+    void reset_row_categories();
+    /**
+     * @return category of row
+     */
+    int row_category(int row) const {
+      return code_categories.at(row_codes.at(row));
+    }
+    /**
+     * Renumber the codes as the categories, dropping the tombstones. O(rows)
+     */
+    void compact();
 };
 
+QString ColumnAggregatorPrivate::row_value(int row) const {
+  const QAbstractItemModel* model = q->underlyingModel();
+  QString data = model->data(model->index(row, section)).toString();
+  if (trim_right) {
+    data = data.right(max_chars);
+  }
+  return data;
+}
+
+void ColumnAggregatorPrivate::reset_row_categories() {
+  postings_valid = false;
+  const int nrows = q->underlyingModel()->rowCount();
+  row_codes.resize(nrows);
+  category_counts = QVector<int>(categories.size());
+  for (int row=0; row<nrows; ++row) {
+    const QString data = row_value(row);
+    Q_ASSERT(cat_map.contains(data));
+    const int code = cat_map.value(data, 0);
+    row_codes[row] = code;
+    ++category_counts[code_categories.at(code)];
+  }
+}
+
+void ColumnAggregatorPrivate::compact() {
+  for (QVector<int>::iterator it = row_codes.begin(), iend = row_codes.end(); it != iend; ++it) {
+    *it = code_categories.at(*it);
+  }
+  for (int category = 0; category < categories.size(); ++category) {
+    cat_map[categories.at(category)] = category;
+    category_codes[category] = category;
+  }
+  code_categories = category_codes;
+  ntombstones = 0;
+}
+
+void ColumnAggregatorPrivate::ensure_postings() const {
+  if (postings_valid) {
+    return;
+  }
+  postings = QVector<QVector<int> >(categories.size());
+  for (int category = 0; category < categories.size(); ++category) {
+    postings[category].reserve(category_counts.at(category));
+  }
+  for (int row = 0; row < row_codes.size(); ++row) {
+    postings[row_category(row)] << row;
+  }
+  postings_valid = true;
+}
+
+void ColumnAggregatorPrivate::release_category(int category) {
+  Q_ASSERT(category_counts.at(category) > 0);
+  if (--category_counts[category] == 0) {
+    remove_category(categories.at(category));
+  }
+}
+
+void ColumnAggregatorPrivate::set_categories(const QStringList& sorted_categories) {
+  categories = sorted_categories;
+  cat_map.clear();
+  display_positions.resize(categories.size());
+  category_codes.resize(categories.size());
+  for (int i=0; i<categories.size(); ++i) {
+    cat_map.insert(categories.at(i), i);
+    display_positions[i] = i;
+    category_codes[i] = i;
+  }
+  code_categories = category_codes;
+  ntombstones = 0;
+}
+
 void ColumnAggregator::setTrimNewCategoriesFromRight(int max_chars) {
   d->trim_right = true;
   d->max_chars = max_chars;
   // Rebuild categories
-  QStringList cats;
-  ColumnAggregatorPrivate::cat_map_t map;
+  QSet<QString> trimmed;
   Q_FOREACH(QString cat, d->categories) {
-    cat = cat.right(max_chars);
-    if (cats.isEmpty() || cats.last() != cat) {
-      cats << cat;
-    }
-  }
-  d->categories = cats;
-  for (int i=0; i<cats.size(); ++i) {
-    map.insert(cats.at(i),i);
+    trimmed << cat.right(max_chars);
   }
-  d->cat_map = map;
+  QStringList cats = trimmed.toList();
+  qSort(cats);
+  d->set_categories(cats);
+  d->reset_row_categories();
 }
 
 int ColumnAggregator::categoryCount() const {
@@ -65,18 +170,12 @@ QVariant ColumnAggregator::categoryHeaderData(int category, int role) const {
 ColumnAggregator::ColumnAggregator(const QAbstractItemModel* model, int section): AbstractAggregator(model), d(new ColumnAggregatorPrivate(this,section)) {
   QSet<QString> categories;
   for (int i=0, iend = underlyingModel()->rowCount(); i<iend; ++i) {
-    QString cat = underlyingModel()->data(underlyingModel()->index(i, d->section)).toString();
-    if (d->trim_right) {
-      cat = cat.right(d->max_chars);
-    }
-    categories << cat;
-  }
-  d->categories = categories.toList();
-  qSort(d->categories);
-  for(int i=0; i<d->categories.size(); ++i) {
-    QString cat = d->categories.at(i);
-    d->cat_map.insert(cat, i);
+    categories << d->row_value(i);
   }
+  QStringList sorted_categories = categories.toList();
+  qSort(sorted_categories);
+  d->set_categories(sorted_categories);
+  d->reset_row_categories();
   connect(underlyingModel(), SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(refresh_categories_in_rect(QModelIndex,QModelIndex)));
   connect(underlyingModel(), SIGNAL(rowsInserted(const QModelIndex&,int, int)), SLOT(add_rows_to_categories(const QModelIndex&,int,int)));
   connect(underlyingModel(), SIGNAL(modelReset()), SLOT(resetCategories()));
@@ -87,13 +186,33 @@ ColumnAggregator::ColumnAggregator(const QAbstractItemModel* model, int section)
 
 int ColumnAggregator::operator()(int row) const {
   Q_ASSERT(underlyingModel()->rowCount() > row);
-  QString data = underlyingModel()->data(underlyingModel()->index(row, d->section)).toString();
-  if (d->trim_right) {
-    data = data.right(d->max_chars);
+  return d->row_category(row);
+}
+
+void ColumnAggregator::categorize(int begin, int end, int* categories) const {
+  Q_ASSERT(end <= d->row_codes.size());
+  const int* code_categories = d->code_categories.constData();
+  for (const int* code = d->row_codes.constData() + begin, *code_end = d->row_codes.constData() + end; code != code_end; ++code) {
+    *categories++ = code_categories[*code];
   }
-  int rv = d->cat_map.value(data, 0);
-  Q_ASSERT(d->cat_map.contains(data));
-  return rv;
+}
+
+QVector<int> ColumnAggregator::categoryDisplayPositions() const {
+  return d->display_positions;
+}
+
+bool ColumnAggregator::hasPostings() const {
+  return true;
+}
+
+QVector<int> ColumnAggregator::postings(int category) const {
+  d->ensure_postings();
+  return d->postings.at(category);
+}
+
+bool ColumnAggregator::isThreadSafe() const {
+  // The categories are only read from row_codes and code_categories, which are changed from the model signals only
+  return true;
 }
 
 ColumnAggregator::~ColumnAggregator() {
@@ -108,12 +227,15 @@ void ColumnAggregator::add_rows_to_categories(const QModelIndex& parent, int sta
   if (parent.isValid()) {
     return;
   }
+  // Every row after start moves, so the postings are built again when needed
+  d->postings_valid = false;
+  d->row_codes.insert(start, end-start+1, 0);
   for (int row=start; row<=end; ++row) {
-    QString data = underlyingModel()->index(row, d->section).data().toString();
-    if (d->trim_right) {
-      data = data.right(d->max_chars);
-    }
+    const QString data = d->row_value(row);
     d->add_new_category(data);
+    const int code = d->cat_map.value(data);
+    d->row_codes[row] = code;
+    ++d->category_counts[d->code_categories.at(code)];
   }
 }
 
@@ -125,47 +247,87 @@ void ColumnAggregator::refresh_categories_in_rect(QModelIndex top_left, QModelIn
     return;
   }
   for (int row=top_left.row(); row<=bottom_right.row(); ++row) {
-    QString data = underlyingModel()->index(row, d->section).data().toString();
-    if (d->trim_right) {
-      data = data.right(d->max_chars);
-    }
+    const QString data = d->row_value(row);
     d->add_new_category(data);
-  }
-  d->possible_removed_counts += bottom_right.row() - top_left.row();
-  if (d->possible_removed_counts*2 > underlyingModel()->rowCount()) {
-    resetCategories();
+    const int old_category = d->row_category(row);
+    const int code = d->cat_map.value(data);
+    const int category = d->code_categories.at(code);
+    if (category != old_category) {
+      if (d->postings_valid) {
+        QVector<int>& old_rows = d->postings[old_category];
+        old_rows.erase(std::lower_bound(old_rows.begin(), old_rows.end(), row));
+        QVector<int>& rows = d->postings[category];
+        rows.insert(std::lower_bound(rows.begin(), rows.end(), row), row);
+      }
+      d->row_codes[row] = code;
+      ++d->category_counts[category];
+      d->release_category(old_category);
+    }
   }
 
 }
 
 void ColumnAggregatorPrivate::add_new_category(QString data)
 {
-  int index = cat_map.size();
   if (!cat_map.contains(data)) {
-    for (ColumnAggregatorPrivate::cat_map_t::iterator it = cat_map.begin(), iend = cat_map.end(); it != iend; ++it) {
-      if (it.key() > data) {
-        index = qMin(index,it.value());
-        ++it.value();
+    // The new category gets the next number, and is slotted into the display order
+    int position = 0;
+    Q_FOREACH(const QString& category, categories) {
+      if (category < data) {
+        ++position;
+      }
+    }
+    for (QVector<int>::iterator it = display_positions.begin(), iend = display_positions.end(); it != iend; ++it) {
+      if (*it >= position) {
+        ++*it;
       }
     }
-    cat_map.insert(data, index);
-    categories.insert(index, data);
+    const int index = categories.size();
+    cat_map.insert(data, code_categories.size());
+    category_codes << code_categories.size();
+    code_categories << index;
+    categories << data;
+    display_positions << position;
+    category_counts << 0;
+    if (postings_valid) {
+      postings << QVector<int>();
+    }
     emit q->categoryAdded(index);
   }
 }
 void ColumnAggregatorPrivate::remove_category(QString category)
 {
-  const int index = cat_map.value(category, -1);
-  if (index<0) {
+  const int code = cat_map.value(category, -1);
+  if (code<0) {
     Q_ASSERT(false);
     return;
   }
+  const int index = code_categories.at(code);
+  // The rows keep their codes, only the categories after index move down
   for (int i=index+1; i<categories.size(); ++i) {
-    int rv = --cat_map[categories[i]];
-    Q_ASSERT(rv>=index);
-    Q_UNUSED(rv);
+    --code_categories[category_codes.at(i)];
   }
+  code_categories[code] = -1;
+  category_codes.remove(index);
+  ++ntombstones;
+  cat_map.remove(category);
   categories.removeAt(index);
+  category_counts.remove(index);
+  if (postings_valid) {
+    Q_ASSERT(postings.at(index).isEmpty());
+    postings.remove(index);
+  }
+  const int position = display_positions.at(index);
+  display_positions.remove(index);
+  for (QVector<int>::iterator it = display_positions.begin(), iend = display_positions.end(); it != iend; ++it) {
+    if (*it > position) {
+      --*it;
+    }
+  }
+  if (ntombstones > categories.size()) {
+    // Renumbering the rows only once the tombstones outnumber the categories keeps removal O(categories) amortized
+    compact();
+  }
   emit q->categoryRemoved(index);
 
 }
@@ -175,20 +337,22 @@ void ColumnAggregator::remove_rows_from_categories(const QModelIndex& parent, in
   if (parent.isValid()) {
     return;
   }
-  d->possible_removed_counts += (end-start);
-  if (d->possible_removed_counts*2 > underlyingModel()->rowCount()) {
-    resetCategories();
+  d->postings_valid = false;
+  QVector<int> released(end-start+1);
+  categorize(start, end+1, released.data());
+  d->row_codes.remove(start, end-start+1);
+  // Release from the highest category, so removing a category does not renumber the ones still to release
+  std::sort(released.begin(), released.end());
+  for (int i=released.size()-1; i>=0; --i) {
+    d->release_category(released.at(i));
   }
 }
 
 void ColumnAggregator::resetCategories() {
+  d->postings_valid = false;
   QSet<QString> categories;
   for (int i=0, iend = underlyingModel()->rowCount(); i<iend; ++i) {
-    QString cat = underlyingModel()->data(underlyingModel()->index(i, d->section)).toString();
-    if (d->trim_right) {
-      cat = cat.right(d->max_chars);
-    }
-    categories << cat;
+    categories << d->row_value(i);
   }
   Q_FOREACH(QString cat, d->categories) {
     if (!categories.contains(cat)) {
@@ -199,6 +363,7 @@ void ColumnAggregator::resetCategories() {
   Q_FOREACH(QString cat, categories) {
     d->add_new_category(cat);
   }
+  d->reset_row_categories();
 
 }
 
@@ -32,6 +32,12 @@ namespace qdatacube {
  *
  * will report 3 categories, and place row 0 and 2 in the London category, row 1
  * in the Newcastle category and row 3 in the York category.
+ *
+ * Categories are numbered in sorted order initially, and categories appearing later get the next
+ * free number. They are still displayed in sorted order, see categoryDisplayPositions().
+ * A category is removed as soon as it has no rows left, which renumbers the categories after it, as for
+ * any categoryRemoved(). The rows are not renumbered, so removing a category costs time in the number of
+ * categories rather than rows.
  */
 
 class ColumnAggregatorPrivate;
@@ -41,6 +47,8 @@ class QDATACUBE_EXPORT ColumnAggregator : public AbstractAggregator {
         ColumnAggregator(const QAbstractItemModel* model,  int section);
         ~ColumnAggregator();
         virtual int operator()(int row) const;
+        virtual void categorize(int begin, int end, int* categories) const;
+        virtual bool isThreadSafe() const;
         /**
          * Return section
          */
@@ -50,6 +58,16 @@ class QDATACUBE_EXPORT ColumnAggregator : public AbstractAggregator {
 
         virtual QVariant categoryHeaderData(int category, int role = Qt::DisplayRole) const;
 
+        virtual QVector<int> categoryDisplayPositions() const;
+
+        /**
+         * The rows of each category are kept once asked for, patched as rows change category and built again
+         * after rows are inserted or removed
+         */
+        virtual bool hasPostings() const;
+
+        virtual QVector<int> postings(int category) const;
+
         /**
          * Trim categories from the right to max max_chars characters.
          * NOTICE This also trims existing categories in spite of the functions name.
@@ -59,8 +77,8 @@ class QDATACUBE_EXPORT ColumnAggregator : public AbstractAggregator {
         void setTrimNewCategoriesFromRight(int max_chars);
     public Q_SLOTS:
         /**
-         * Recalculate categories. This is also triggered automatically when the number of changed or removed rows
-         * exceeds the half the current size
+         * Recalculate categories from the whole model. Not needed to keep the categories up to date, as each
+         * category counts its rows and is removed as soon as it has none left
          */
         void resetCategories();
     private:
@@ -0,0 +1,75 @@
+#include "columnmeanformatter.h"
+#include <QAbstractItemModel>
+#include <QEvent>
+#include <stdexcept>
+#include <QWidget>
+#include "datacubeview.h"
+namespace qdatacube {
+
+class ColumnMeanFormatterPrivate {
+    public:
+        ColumnMeanFormatterPrivate(int column, int precision, QString suffix, double scale) : m_column(column), m_precision(precision), m_suffix(suffix), m_scale(scale) {
+        }
+        const int m_column;
+        const int m_precision;
+        QString m_suffix;
+        const double m_scale;
+};
+
+ColumnMeanFormatter::ColumnMeanFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column, int precision, QString suffix, double scale)
+ : AbstractFormatter(underlying_model, view), d(new ColumnMeanFormatterPrivate(column, precision, suffix, scale))
+{
+  if (column >= underlying_model->columnCount()|| column<0) {
+    throw std::runtime_error(QString("Column %1 must be in the underlying model, ie., be between 0 and %2").arg(column).arg(underlying_model->columnCount()).toStdString());
+  }
+  update(qdatacube::AbstractFormatter::CellSize);
+  setShortName("AVG");
+  setName(QString("Mean of %1").arg(underlyingModel()->headerData(d->m_column, Qt::Horizontal).toString()));
+}
+
+QString ColumnMeanFormatter::format(QList< int > rows) const
+{
+  Measure measure;
+  Q_FOREACH(int element, rows) {
+    measure.add(underlyingModel()->index(element, d->m_column).data().toDouble());
+  }
+  return formatMeasure(measure);
+}
+
+QString ColumnMeanFormatter::formatRange(const ElementRange& elements) const
+{
+  if (elements.hasMeasure(d->m_column)) {
+    return formatMeasure(elements.measure(d->m_column));
+  }
+  Measure measure;
+  for (ElementRange::const_iterator it = elements.begin(), iend = elements.end(); it != iend; ++it) {
+    measure.add(underlyingModel()->index(*it, d->m_column).data().toDouble());
+  }
+  return formatMeasure(measure);
+}
+
+QString ColumnMeanFormatter::formatMeasure(const Measure& measure) const
+{
+  return QString::number(measure.mean()*d->m_scale,'f',d->m_precision) + d->m_suffix;
+}
+
+void ColumnMeanFormatter::update(AbstractFormatter::UpdateType element) {
+    if(element == qdatacube::AbstractFormatter::CellSize) {
+        if(datacubeView()) {
+            // The mean is between the smallest and the largest value, so use the widest of those
+            Measure measure;
+            for (int element = 0, nelements = underlyingModel()->rowCount(); element < nelements; ++element) {
+                measure.add(underlyingModel()->index(element, d->m_column).data().toDouble());
+            }
+            const double widest = measure.count() > 0 ? qMax(qAbs(measure.min()), qAbs(measure.max())) : 0.0;
+            QString big_cell_contents = QString::number(-widest*d->m_scale, 'f', d->m_precision) + d->m_suffix;
+            setCellSize(QSize(datacubeView()->fontMetrics().width(big_cell_contents), datacubeView()->fontMetrics().lineSpacing()));
+        }
+    }
+}
+
+ColumnMeanFormatter::~ColumnMeanFormatter() {
+
+}
+
+} // end of namespace
@@ -0,0 +1,33 @@
+#ifndef QDATACUBE_COLUMN_STDDEV_FORMATTER_H
+#define QDATACUBE_COLUMN_STDDEV_FORMATTER_H
+
+#include "abstractformatter.h"
+#include "qdatacube_export.h"
+namespace qdatacube {
+
+/**
+  * Formatter that takes a column and uses the sample standard deviation of that for display.
+  * Cells and totals are read in O(1) per cell if the datacube measures the column, see Datacube::addMeasure()
+  */
+class ColumnStddevFormatterPrivate;
+class QDATACUBE_EXPORT ColumnStddevFormatter : public AbstractFormatter {
+    public:
+        /**
+         * @param underlying_model the underlying_model
+         * @param column the column of the underlying model. Should provide data convertible to double
+         * @param precision precision of the output
+         * @param scale this is multiplied on the sample standard deviation before displaying (e.g. using .001 to convert kg to T)
+         * @param suffix a (small) string that is appended to the format, e.g. "t" for tonnes.
+         */
+        ColumnStddevFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column, int precision, QString suffix, double scale = 1.0 );
+        virtual QString format(QList< int > rows) const;
+        virtual QString formatRange(const ElementRange& elements) const;
+        virtual ~ColumnStddevFormatter();
+    protected:
+        virtual void update(UpdateType element);
+    private:
+        QString formatMeasure(const Measure& measure) const;
+        QScopedPointer<ColumnStddevFormatterPrivate> d;
+};
+} // end of namespace
+#endif // QDATACUBE_COLUMN_STDDEV_FORMATTER_H
@@ -35,6 +35,19 @@ QString ColumnSumFormatter::format(QList< int > rows) const
   }
   return QString::number(accumulator*d->m_scale,'f',d->m_precision) + d->m_suffix;
 }
+
+QString ColumnSumFormatter::formatRange(const ElementRange& elements) const
+{
+  if (elements.hasMeasure(d->m_column)) {
+    return QString::number(elements.measure(d->m_column).sum()*d->m_scale,'f',d->m_precision) + d->m_suffix;
+  }
+  double accumulator = 0;
+  for (ElementRange::const_iterator it = elements.begin(), iend = elements.end(); it != iend; ++it) {
+    accumulator += underlyingModel()->index(*it, d->m_column).data().toDouble();
+  }
+  return QString::number(accumulator*d->m_scale,'f',d->m_precision) + d->m_suffix;
+}
+
 void ColumnSumFormatter::update(AbstractFormatter::UpdateType element) {
     if(element == qdatacube::AbstractFormatter::CellSize) {
         if(datacubeView()) {
@@ -20,6 +20,7 @@ class QDATACUBE_EXPORT ColumnSumFormatter : public AbstractFormatter {
          */
         ColumnSumFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column, int precision, QString suffix, double scale = 1.0 );
         virtual QString format(QList< int > rows) const;
+        virtual QString formatRange(const ElementRange& elements) const;
         virtual ~ColumnSumFormatter();
     protected:
         virtual void update(UpdateType element);
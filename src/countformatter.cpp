@@ -18,6 +18,10 @@ QString CountFormatter::format(QList< int > rows) const {
   return QString::number(rows.size()*m_multiplier);
 }
 
+QString CountFormatter::formatRange(const ElementRange& elements) const {
+  return QString::number(elements.size()*m_multiplier);
+}
+
 void CountFormatter::update(AbstractFormatter::UpdateType updateType) {
     if(updateType == qdatacube::AbstractFormatter::CellSize) {
         if(datacubeView()) {
@@ -18,6 +18,7 @@ class QDATACUBE_EXPORT CountFormatter : public AbstractFormatter {
          */
         CountFormatter(QAbstractItemModel* underlyingModel, qdatacube::DatacubeView* view = 0L, const double multiplier = 1.0);
         virtual QString format(QList< int > rows) const;
+        virtual QString formatRange(const ElementRange& elements) const;
     protected:
         virtual void update(qdatacube::AbstractFormatter::UpdateType updateType);
     private:
@@ -22,9 +22,12 @@
 #include "datacube.h"
 #include "abstractaggregator.h"
 #include "abstractfilter.h"
+#include "filterbyaggregate.h"
+#include "filterbycategories.h"
 
 #include <QVector>
 #include <algorithm>
+#include <functional>
 
 #include <QAbstractItemModel>
 #include "cell.h"
@@ -32,11 +35,88 @@
 #include "datacubeselection_p.h"
 
 #include "datacube_p.h"
+#include "elementrange_p.h"
 
+#include <QElapsedTimer>
 #include <QSharedPointer>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 namespace qdatacube {
 
+namespace {
+
+// Elements per chunk below which computing buckets or evaluating filters in parallel does not pay off
+const int min_parallel_chunk = 16384;
+
+// Number of elements categorized at a time, keeping the temporary arrays small
+const int categorize_block = 4096;
+
+/**
+ * @return sorted sections as ranges of (first, count)
+ */
+QList<QPair<int, int> > to_ranges(const QList<int>& sections) {
+  QList<QPair<int, int> > rv;
+  Q_FOREACH(int section, sections) {
+    if (!rv.isEmpty() && rv.last().first + rv.last().second == section) {
+      ++rv.last().second;
+    } else {
+      rv << qMakePair(section, 1);
+    }
+  }
+  return rv;
+}
+
+struct ElementChunk {
+  int begin;
+  int end;
+};
+
+/**
+ * Computes the cells for a chunk of elements, for QtConcurrent::blockingMap
+ */
+class ComputeChunkCells {
+  public:
+    typedef void result_type;
+    ComputeChunkCells(DatacubePrivate* datacube, long* cell_for_element) : m_datacube(datacube), m_cell_for_element(cell_for_element) {}
+    void operator()(const ElementChunk& chunk) const {
+      m_datacube->compute_cells(chunk.begin, chunk.end, m_cell_for_element);
+    }
+  private:
+    DatacubePrivate* m_datacube;
+    long* m_cell_for_element;
+};
+
+/**
+ * Rows of a batch evaluated by rejected_elements(), and how long the filter took for them
+ */
+struct FilterBlock {
+  int begin;
+  int end;
+  qint64 nsecs;
+};
+
+/**
+ * Evaluates a filter over a block of rows, for QtConcurrent::blockingMap. The blocks start at multiples of 64,
+ * so each one writes its own words of included, which has a bit per row
+ */
+class EvaluateFilterBlock {
+  public:
+    typedef void result_type;
+    EvaluateFilterBlock(const AbstractFilter* filter, quint64* included) : m_filter(filter), m_included(included) {}
+    void operator()(FilterBlock& block) const {
+      QElapsedTimer timer;
+      timer.start();
+      m_filter->evaluate(block.begin, block.end, m_included + (block.begin >> 6));
+      block.nsecs = timer.nsecsElapsed();
+    }
+  private:
+    const AbstractFilter* m_filter;
+    quint64* m_included;
+};
+
+}
+
 int DatacubePrivate::computeBucketForIndex(Qt::Orientation orientation, int index) {
   qdatacube::Datacube::Aggregators& aggregators = orientation == Qt::Horizontal ? col_aggregators : row_aggregators;
   int stride = 1;
@@ -50,70 +130,62 @@ int DatacubePrivate::computeBucketForIndex(Qt::Orientation orientation, int inde
   return rv;
 }
 
-int DatacubePrivate::bucket_for_row(const int row) const {
-  int r = row;
-  for (int bucket = 0; bucket < row_counts.size(); ++bucket) {
-    if (row_counts[bucket] > 0) {
-      if (r-- == 0) {
-        return bucket;
-      }
+void DatacubePrivate::compute_buckets(Qt::Orientation orientation, int begin, int end, int* buckets) const {
+  const Datacube::Aggregators& aggregators = orientation == Qt::Horizontal ? col_aggregators : row_aggregators;
+  std::fill(buckets, buckets + (end-begin), 0);
+  QVector<int> categories(end-begin);
+  int stride = 1;
+  for (int aggregator_index = aggregators.size()-1; aggregator_index>=0; --aggregator_index) {
+    const AbstractAggregator* aggregator = aggregators.at(aggregator_index).data();
+    aggregator->categorize(begin, end, categories.data());
+    for (int i=0; i<end-begin; ++i) {
+      buckets[i] += stride * categories.at(i);
     }
+    stride *= aggregator->categoryCount();
   }
-  Q_ASSERT_X(false, "QDatacube", QString("Row %1 too big for qdatacube with %2 rows").arg(row).arg(row_counts.size() - std::count(row_counts.begin(), row_counts.end(), 0u)).toLocal8Bit().data());
-  return -1;
+}
+
+int DatacubePrivate::bucket_for_row(const int row) const {
+  const int display_bucket = row_index.select(row);
+  Q_ASSERT_X(display_bucket >= 0, "QDatacube", QString("Row %1 too big for qdatacube with %2 rows").arg(row).arg(row_index.count()).toLocal8Bit().data());
+  return row_order.toBucket(display_bucket);
 }
 
 int DatacubePrivate::bucket_for_column(int column) const {
-  int c = column;
-  for (int bucket = 0; bucket < col_counts.size(); ++bucket) {
-    if (col_counts[bucket] > 0) {
-      if (c-- == 0) {
-        return bucket;
-      }
-    }
-  }
-  Q_ASSERT_X(false, "qdatacube", QString("Column %1 too big for qdatacube with %2 columns").arg(column).arg(col_counts.size() - std::count(col_counts.begin(), col_counts.end(), 0u)).toLocal8Bit().data());
-  return -1;
+  const int display_bucket = col_index.select(column);
+  Q_ASSERT_X(display_bucket >= 0, "qdatacube", QString("Column %1 too big for qdatacube with %2 columns").arg(column).arg(col_index.count()).toLocal8Bit().data());
+  return col_order.toBucket(display_bucket);
 }
 
-const QList< int >& DatacubePrivate::cell(long bucket_row, long bucket_column) const {
+QList< int > DatacubePrivate::cell(long bucket_row, long bucket_column) const {
   const long i = bucket_row + bucket_column*row_counts.size();
-  cells_t::const_iterator it = cells.constFind(i);
-  static const QList<int> empty_list;
-  if(it == cells.constEnd()) {
-    return empty_list;
-  }
-  return it.value();
+  return cells.elements(i);
+}
+
+int DatacubePrivate::cellSize(long int bucket_row, long int bucket_column) const {
+  const long i = bucket_row + bucket_column*row_counts.size();
+  return cells.size(i);
 }
 
 void DatacubePrivate::cellAppend(CellPoint point, QList< int > listadd) {
     const long i = point.row + point.column*row_counts.size();
-    cells[i].append(listadd);
+    cells.append(i, listadd);
 }
 
 void DatacubePrivate::cellAppend(long int bucket_row, long bucket_column, int to_add) {
     const long i = bucket_row + bucket_column*row_counts.size();
-    Q_ASSERT(!cells[i].contains(to_add));
-    cells[i].append(to_add);
+    Q_ASSERT(!cells.contains(i, to_add));
+    cells.append(i, to_add);
 }
 
 bool DatacubePrivate::cellRemoveOne(long row, long column, int index) {
     const long i = row + column*row_counts.size();
-    cells_t::iterator it = cells.find(i);
-    if(it == cells.end()) {
-        return false;
-    }
-    bool success = it.value().removeOne(index);
-    if(it.value().isEmpty()) {
-        cells.remove(i);
-    }
-    return success;
+    return cells.removeOne(i, index);
 }
 
 int DatacubePrivate::hasCell(long int bucket_row, long bucket_column) const {
     const long i = bucket_row + bucket_column*row_counts.size();
-    cells_t::const_iterator it = cells.constFind(i);
-    return it != cells.constEnd();
+    return cells.contains(i);
 }
 
 void DatacubePrivate::setCell(long int bucket_row, long bucket_column, const QList< int >& cell_content) {
@@ -122,61 +194,258 @@ void DatacubePrivate::setCell(long int bucket_row, long bucket_column, const QLi
 
 void DatacubePrivate::setCell(CellPoint point, const QList< int >& cell_content) {
     const long i = point.row + point.column*row_counts.size();
-    cells_t::iterator it = cells.find(i);
-    if(it == cells.end()) {
-        if(!cell_content.isEmpty()) {
-            cells.insert(i,cell_content);
-        }
-    } else {
-        if(cell_content.isEmpty()) {
-            cells.erase(it);
-        } else {
-            *it = cell_content;
-        }
-    }
+    cells.set(i, cell_content);
 }
 
+int DatacubePrivate::bucket_to_column(int bucket_column) const {
+  return col_index.rank(col_order.toDisplay(bucket_column));
+}
 
+int DatacubePrivate::bucket_to_row(int bucket_row) const {
+  return row_index.rank(row_order.toDisplay(bucket_row));
+}
 
-int DatacubePrivate::bucket_to_column(int bucket_column) const {
-  int rv = 0;
-  for (int i=0; i<bucket_column; ++i) {
-    if (col_counts[i]>0) {
-      ++rv;
+void DatacubePrivate::connect_model() {
+  disconnect(model, 0, this, 0);
+  connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), SLOT(update_data(QModelIndex,QModelIndex)));
+  connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), SLOT(remove_data(QModelIndex,int,int)));
+  connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), SLOT(insert_data(QModelIndex,int,int)));
+}
+
+void DatacubePrivate::begin_update() {
+  ++update_depth;
+}
+
+void DatacubePrivate::end_update() {
+  Q_ASSERT(update_depth > 0);
+  if (--update_depth > 0) {
+    return;
+  }
+  // Take the changes first, so listeners can open updates of their own
+  const bool needs_reset = update_needs_reset;
+  const QHash<int, bool> rows_were_non_empty = row_was_non_empty;
+  const QHash<int, bool> columns_were_non_empty = column_was_non_empty;
+  const QSet<long> cells_changed = changed_cells;
+  const QSet<int> row_buckets_changed = changed_row_buckets;
+  const QSet<int> column_buckets_changed = changed_column_buckets;
+  update_needs_reset = false;
+  row_was_non_empty.clear();
+  column_was_non_empty.clear();
+  changed_cells.clear();
+  changed_row_buckets.clear();
+  changed_column_buckets.clear();
+  if (needs_reset) {
+    // aboutToBeReset() went out before the first change that needed the reset
+    emit q->reset();
+    return;
+  }
+
+  // Without a reset, the update removed no sections, so the sections were only inserted
+  const QList<QPair<int, int> > inserted_rows = inserted_sections(Qt::Vertical, rows_were_non_empty);
+  const QList<QPair<int, int> > inserted_columns = inserted_sections(Qt::Horizontal, columns_were_non_empty);
+
+  // Sections inserted by the update need no more signals
+  QList<int> rows_changed;
+  Q_FOREACH(int bucket, row_buckets_changed) {
+    const int display_bucket = row_order.toDisplay(bucket);
+    if (row_index.contains(display_bucket) && rows_were_non_empty.value(display_bucket, true)) {
+      rows_changed << row_index.rank(display_bucket);
     }
   }
-  return rv;
+  QList<int> columns_changed;
+  Q_FOREACH(int bucket, column_buckets_changed) {
+    const int display_bucket = col_order.toDisplay(bucket);
+    if (col_index.contains(display_bucket) && columns_were_non_empty.value(display_bucket, true)) {
+      columns_changed << col_index.rank(display_bucket);
+    }
+  }
+  std::sort(rows_changed.begin(), rows_changed.end());
+  std::sort(columns_changed.begin(), columns_changed.end());
+  QList<QPair<int, int> > cells;
+  const long nrows = row_counts.size();
+  Q_FOREACH(long cell, cells_changed) {
+    const int row_bucket = cell % nrows;
+    const int column_bucket = cell / nrows;
+    if (row_buckets_changed.contains(row_bucket) || column_buckets_changed.contains(column_bucket)) {
+      continue;
+    }
+    const int row_display_bucket = row_order.toDisplay(row_bucket);
+    const int column_display_bucket = col_order.toDisplay(column_bucket);
+    if (!row_index.contains(row_display_bucket) || !rows_were_non_empty.value(row_display_bucket, true)) {
+      continue;
+    }
+    if (!col_index.contains(column_display_bucket) || !columns_were_non_empty.value(column_display_bucket, true)) {
+      continue;
+    }
+    cells << qMakePair(row_index.rank(row_display_bucket), col_index.rank(column_display_bucket));
+  }
+
+  // Insertions first range first, so the sections before each are those after the update
+  typedef QPair<int, int> range_t;
+  Q_FOREACH(const range_t& range, inserted_rows) {
+    emit q->rowsAboutToBeInserted(range.first, range.second);
+    emit q->rowsInserted(range.first, range.second);
+  }
+  Q_FOREACH(const range_t& range, inserted_columns) {
+    emit q->columnsAboutToBeInserted(range.first, range.second);
+    emit q->columnsInserted(range.first, range.second);
+  }
+  Q_FOREACH(const range_t& range, to_ranges(rows_changed)) {
+    emit q->headersChanged(Qt::Vertical, range.first, range.first + range.second - 1);
+  }
+  Q_FOREACH(const range_t& range, to_ranges(columns_changed)) {
+    emit q->headersChanged(Qt::Horizontal, range.first, range.first + range.second - 1);
+  }
+  Q_FOREACH(int row, rows_changed) {
+    for (int column = 0, ncolumns = col_index.count(); column < ncolumns; ++column) {
+      emit q->dataChanged(row, column);
+    }
+  }
+  Q_FOREACH(int column, columns_changed) {
+    for (int row = 0, nrows = row_index.count(); row < nrows; ++row) {
+      if (!std::binary_search(rows_changed.constBegin(), rows_changed.constEnd(), row)) {
+        emit q->dataChanged(row, column);
+      }
+    }
+  }
+  Q_FOREACH(const range_t& cell, cells) {
+    emit q->dataChanged(cell.first, cell.second);
+  }
+}
 
+void DatacubePrivate::set_bucket_non_empty(Qt::Orientation orientation, int bucket, bool non_empty) {
+  const bool horizontal = orientation == Qt::Horizontal;
+  BucketIndex& index = horizontal ? col_index : row_index;
+  QHash<int, bool>& was_non_empty = horizontal ? column_was_non_empty : row_was_non_empty;
+  const int display_bucket = (horizontal ? col_order : row_order).toDisplay(bucket);
+  (horizontal ? col_headers : row_headers).invalidate();
+  Q_ASSERT(non_empty || update_needs_reset); // a section removed needs the reset announced before
+  if (!was_non_empty.contains(display_bucket)) {
+    was_non_empty.insert(display_bucket, !non_empty);
+  }
+  if (non_empty) {
+    index.insert(display_bucket);
+  } else {
+    index.remove(display_bucket);
+  }
 }
 
-int DatacubePrivate::bucket_to_row(int bucket_row) const {
-  int rv = 0;
-  for (int i=0; i<bucket_row; ++i) {
-    if (row_counts[i]>0) {
-      ++rv;
+QList<QPair<int, int> > DatacubePrivate::inserted_sections(Qt::Orientation orientation, const QHash<int, bool>& was_non_empty) const {
+  const BucketIndex& index = orientation == Qt::Horizontal ? col_index : row_index;
+  QList<int> display_buckets = was_non_empty.keys();
+  std::sort(display_buckets.begin(), display_buckets.end());
+  QList<int> sections;
+  Q_FOREACH(int display_bucket, display_buckets) {
+    if (!was_non_empty.value(display_bucket) && index.contains(display_bucket)) {
+      sections << index.rank(display_bucket);
     }
   }
-  return rv;
+  return to_ranges(sections);
+}
+
+void DatacubePrivate::begin_reset() {
+  if (update_depth == 0) {
+    emit q->aboutToBeReset();
+  } else {
+    announce_reset();
+  }
+}
 
+void DatacubePrivate::announce_reset() {
+  Q_ASSERT(update_depth > 0);
+  if (!update_needs_reset) {
+    update_needs_reset = true;
+    emit q->aboutToBeReset();
+  }
 }
+
+void DatacubePrivate::end_reset() {
+  if (update_depth == 0) {
+    emit q->reset();
+    return;
+  }
+  Q_ASSERT(update_needs_reset);
+  // Selections follow the bucket layout on reset(), which cannot wait for the update to end
+  Q_FOREACH(DatacubeSelection* selection, selection_models) {
+    selection->d->reset();
+  }
+}
+
+void DatacubePrivate::reset_bucket_indexes() {
+  reset_bucket_index(Qt::Vertical);
+  reset_bucket_index(Qt::Horizontal);
+}
+
+const HeaderIndex& DatacubePrivate::header_index(Qt::Orientation orientation, int level) {
+  const bool horizontal = orientation == Qt::Horizontal;
+  HeaderIndex& headers = horizontal ? col_headers : row_headers;
+  if (!headers.isValid(level)) {
+    refresh_measures(orientation);
+    headers.build(level, horizontal ? col_counts : row_counts, horizontal ? col_measures : row_measures,
+                  horizontal ? col_index : row_index, horizontal ? col_order : row_order);
+  } else if (headers.hasStale(level)) {
+    refresh_measures(orientation);
+    headers.refresh(level, horizontal ? col_measures : row_measures, horizontal ? col_order : row_order);
+  }
+  return headers;
+}
+
+void DatacubePrivate::reset_bucket_index(Qt::Orientation orientation) {
+  // The buckets may be numbered anew
+  forget_dropped_cells();
+  const bool horizontal = orientation == Qt::Horizontal;
+  BucketOrder& order = horizontal ? col_order : row_order;
+  BucketIndex& index = horizontal ? col_index : row_index;
+  const QVector<unsigned>& counts = horizontal ? col_counts : row_counts;
+  const Datacube::Aggregators& aggregators = horizontal ? col_aggregators : row_aggregators;
+  QVector<int> strides(aggregators.size());
+  for (int level = aggregators.size()-1, stride = 1; level >= 0; --level) {
+    strides[level] = stride;
+    stride *= aggregators.at(level)->categoryCount();
+  }
+  (horizontal ? col_headers : row_headers).reset(strides);
+  order.reset(aggregators);
+  if (order.isIdentity()) {
+    index.reset(counts);
+  } else {
+    QVector<int> non_empty;
+    for (int bucket = 0; bucket < counts.size(); ++bucket) {
+      if (counts.at(bucket) > 0) {
+        non_empty << order.toDisplay(bucket);
+      }
+    }
+    index.reset(counts.size(), non_empty);
+  }
+}
+
 DatacubePrivate::DatacubePrivate(Datacube* datacube, const QAbstractItemModel* model) :
                                q(datacube),
-                               model(model)
+                               model(model),
+                               update_depth(0),
+                               update_needs_reset(false)
 {
   col_counts = QVector<unsigned>(1);
   row_counts = QVector<unsigned>(1);
+  reset_bucket_indexes();
+  element_map.reset(model->rowCount());
+  reverse_index.resize(model->rowCount());
 }
 
 DatacubePrivate::DatacubePrivate(Datacube* datacube, const QAbstractItemModel* model,
                                AbstractAggregator::Ptr row_aggregator,
                                AbstractAggregator::Ptr column_aggregator) :
     q(datacube),
-    model(model)
+    model(model),
+    update_depth(0),
+    update_needs_reset(false)
 {
   col_aggregators << column_aggregator;
   row_aggregators << row_aggregator;
   col_counts = QVector<unsigned>(column_aggregator->categoryCount());
   row_counts = QVector<unsigned>(row_aggregator->categoryCount());
+  reset_bucket_indexes();
+  element_map.reset(model->rowCount());
+  reverse_index.resize(model->rowCount());
 }
 
 Datacube::Datacube(const QAbstractItemModel* model,
@@ -186,16 +455,12 @@ Datacube::Datacube(const QAbstractItemModel* model,
     QObject(parent),
     d(new DatacubePrivate(this, model, row_aggregator, column_aggregator))
 {
-  connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), d.data(), SLOT(update_data(QModelIndex,QModelIndex)));
-  connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), d.data(), SLOT(remove_data(QModelIndex,int,int)));
-  connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), d.data(), SLOT(insert_data(QModelIndex,int,int)));
+  d->connect_model();
   connect(column_aggregator.data(), SIGNAL(categoryAdded(int)), d.data(), SLOT(slot_aggregator_category_added(int)));
   connect(row_aggregator.data(), SIGNAL(categoryAdded(int)), d.data(), SLOT(slot_aggregator_category_added(int)));
   connect(column_aggregator.data(), SIGNAL(categoryRemoved(int)), d.data(), SLOT(slot_aggregator_category_removed(int)));
   connect(row_aggregator.data(), SIGNAL(categoryRemoved(int)), d.data(), SLOT(slot_aggregator_category_removed(int)));;
-  for (int element = 0, nelements = model->rowCount(); element < nelements; ++element) {
-    d->add(element);
-  }
+  d->rebuild();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   check();
 #endif
@@ -206,12 +471,8 @@ Datacube::Datacube(const QAbstractItemModel* model, QObject* parent)
   : QObject(parent),
     d(new DatacubePrivate(this, model))
 {
-  connect(model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), d.data(), SLOT(update_data(QModelIndex,QModelIndex)));
-  connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)), d.data(), SLOT(remove_data(QModelIndex,int,int)));
-  connect(model, SIGNAL(rowsInserted(QModelIndex,int,int)), d.data(), SLOT(insert_data(QModelIndex,int,int)));
-  for (int element = 0, nelements = model->rowCount(); element < nelements; ++element) {
-    d->add(element);
-  }
+  d->connect_model();
+  d->rebuild();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   check();
 #endif
@@ -225,14 +486,36 @@ void Datacube::addFilter(AbstractFilter::Ptr filter) {
   if (!filter) {
     return;
   }
-  for (int row = 0, nrows = d->model->rowCount(); row<nrows; ++row) {
-    const bool was_included = d->reverse_index.contains(row);
-    const bool included = (*filter)(row);
-    if (was_included && !included) {
+  Qt::Orientation orientation;
+  int headerno;
+  QBitArray kept;
+  if (d->find_filter_dimension(*filter, orientation, headerno, kept)) {
+    // The filter keeps some categories of a header, so whole slices of buckets go at once, and come back when it goes
+    d->filters << filter;
+    d->filter_order.append();
+    d->dropped_cells << DatacubePrivate::cells_t();
+    QVector<quint64> unknown;
+    const QVector<quint64> rejected = d->rejected_elements(d->filters.size() - 1, orientation, headerno, kept,
+                                                           d->filter_cache.excluded(), unknown);
+    d->filter_cache.appendFilter(rejected, unknown);
+    d->begin_update();
+    d->drop_other_categories(orientation, headerno, kept, d->dropped_cells.last());
+    d->end_update();
+  } else {
+    // The filter is run once per row not excluded already, while removing it again mostly reads the cache
+    d->filters << filter;
+    d->filter_order.append();
+    d->dropped_cells << DatacubePrivate::cells_t();
+    QVector<quint64> unknown;
+    const QVector<quint64> rejected = d->rejected_elements(d->filters.size() - 1, d->filter_cache.excluded(), unknown);
+    const QList<int> excluded = d->to_rows(d->filter_cache.appendFilter(rejected, unknown));
+    d->begin_update();
+    Q_FOREACH(int row, excluded) {
       d->remove(row);
     }
+    d->end_update();
   }
-  d->filters << filter;
+  d->connect_model();
   emit filterChanged();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   check();
@@ -241,25 +524,83 @@ void Datacube::addFilter(AbstractFilter::Ptr filter) {
 
 bool Datacube::removeFilter(AbstractFilter::Ptr filter)
 {
-  for (Filters::iterator it = d->filters.begin(), iend = d->filters.end(); it != iend; ++it) {
-    if (*it == filter) {
-      Filters::value_type removed_filter = *it;
-      d->filters.erase(it);
-      for (int row = 0, nrows = d->model->rowCount(); row<nrows; ++row) {
-        if (d->filtered_in(row)) {
-          const bool excluded = !(*filter)(row);
-          if (excluded) {
-            d->add(row);
-          }
-        }
-      }
-      emit filterChanged();
-      return true;
+  const int index = d->filters.indexOf(filter);
+  if (index < 0) {
+    return false;
+  }
+  d->filters.removeAt(index);
+  d->filter_order.remove(index);
+  DatacubePrivate::cells_t dropped = d->dropped_cells.takeAt(index);
+  // Only the elements no other filter rejects come back, and only the filters not run for them before are called
+  const QList<int> ids = d->filter_cache.removeFilter(index);
+  const QList<int> rows = d->to_rows(ids);
+  QList<int> included;
+  for (int i = 0; i < ids.size(); ++i) {
+    if (!d->filter_cache.hasUnknown(ids.at(i)) || d->evaluate_filters(rows.at(i), ids.at(i), true)) {
+      included << ids.at(i);
     }
   }
-  return false;
+  d->begin_update();
+  // The cells dropped by a filter on a header go back as they were, the other elements are added a row at a time
+  d->add_rows(d->to_rows(d->restore_cells(dropped, included)));
+  d->end_update();
+  emit filterChanged();
+#ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
+  check();
+#endif
+  return true;
 }
 
+bool Datacube::replaceFilter(AbstractFilter::Ptr old_filter, AbstractFilter::Ptr new_filter)
+{
+  const int index = d->filters.indexOf(old_filter);
+  if (index < 0 || !new_filter) {
+    return false;
+  }
+#ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
+  check();
+#endif
+  d->filters[index] = new_filter;
+  d->filter_order.clear(index);
+  // The elements the old filter dropped with their cells are not in the datacube, so they are added back by row
+  d->dropped_cells[index] = DatacubePrivate::cells_t();
+  Qt::Orientation orientation;
+  int headerno;
+  QBitArray kept;
+  const bool on_header = d->find_filter_dimension(*new_filter, orientation, headerno, kept);
+  // The new filter is evaluated where no other filter rejects, and only the elements changing sides are touched
+  const QVector<quint64> excluded_by_others = d->filter_cache.excluded(index);
+  QVector<quint64> unknown;
+  const QVector<quint64> rejected = on_header ? d->rejected_elements(index, orientation, headerno, kept, excluded_by_others, unknown)
+                                              : d->rejected_elements(index, excluded_by_others, unknown);
+  QList<int> excluded_ids;
+  QList<int> included_ids;
+  d->filter_cache.replaceFilter(index, rejected, unknown, excluded_ids, included_ids);
+  const QList<int> rows = d->to_rows(included_ids);
+  QList<int> included;
+  for (int i = 0; i < included_ids.size(); ++i) {
+    if (!d->filter_cache.hasUnknown(included_ids.at(i)) || d->evaluate_filters(rows.at(i), included_ids.at(i), true)) {
+      included << rows.at(i);
+    }
+  }
+  d->begin_update();
+  if (on_header) {
+    // The elements now rejected are those in the other categories of the header, so their slices go at once
+    d->drop_other_categories(orientation, headerno, kept, d->dropped_cells[index]);
+  } else {
+    Q_FOREACH(int row, d->to_rows(excluded_ids)) {
+      d->remove(row);
+    }
+  }
+  d->add_rows(included);
+  d->end_update();
+  d->connect_model();
+  emit filterChanged();
+#ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
+  check();
+#endif
+  return true;
+}
 
 void Datacube::check() const {
   int total_count = 0;
@@ -276,7 +617,16 @@ void Datacube::check() const {
     if (included) {
       ++total_count;
     }
+    const int element = d->element_map.id(i);
+    Q_ASSERT(d->filter_cache.isIncluded(element) == included);
+    Q_ASSERT(!d->filter_cache.hasUnknown(element) || !included);
+    for (int filter_index = 0; filter_index < d->filters.size(); ++filter_index) {
+      Q_ASSERT(d->filter_cache.isUnknown(filter_index, element) || d->filter_cache.rejects(filter_index, element) == !(*d->filters.at(filter_index))(i));
+    }
+    Q_UNUSED(element);
   }
+  Q_ASSERT(d->filter_cache.filterCount() == d->filters.size());
+  Q_ASSERT(d->filter_order.count() == d->filters.size());
   int failcols = 0;
   int failrows = 0;
   QVector<unsigned> check_row_counts(d->row_counts.size());
@@ -284,7 +634,7 @@ void Datacube::check() const {
   for (int c=0; c<d->col_counts.size(); ++c) {
     unsigned col_count = 0;
     for (int r=0; r<d->row_counts.size(); ++r) {
-      const int nelements = d->cell(r,c).size();
+      const int nelements = d->cellSize(r,c);
       check_row_counts[r] += nelements;
       col_count += nelements;
     }
@@ -296,28 +646,54 @@ void Datacube::check() const {
     count += col_count;
   }
   Q_ASSERT_X(count == total_count, __func__, QString("%1 == %2").arg(count).arg(total_count).toLocal8Bit().data());
+  for (int c=0; c<d->col_counts.size(); ++c) {
+    Q_ASSERT(d->col_index.contains(d->col_order.toDisplay(c)) == (d->col_counts[c] > 0));
+  }
+  for (int r=0; r<d->row_counts.size(); ++r) {
+    Q_ASSERT(d->row_index.contains(d->row_order.toDisplay(r)) == (d->row_counts[r] > 0));
+  }
   for (int i=0; i<d->row_counts.size(); ++i) {
         if(check_row_counts[i] != d->row_counts[i]) {
             qDebug() << "row" << "found, expected" << check_row_counts[i] << "!=" << d->row_counts[i];
             failrows++;
             Q_ASSERT(check_row_counts[i] == d->row_counts[i]);
         }
+  }
+  for (DatacubePrivate::cells_t::const_iterator it = d->cells.constBegin(), iend = d->cells.constEnd(); it != iend; ++it) {
+    const Measure* measures = d->measures.find(it.key());
+    for (int measure = 0; measure < d->measures.count(); ++measure) {
+      Q_ASSERT(measures && measures[measure].count() == it.size());
+    }
+    Q_UNUSED(measures);
   }
     qDebug() << "check done" << failcols << failrows;
 }
 
+void Datacube::beginUpdate() {
+  d->begin_update();
+}
+
+void Datacube::endUpdate() {
+  d->end_update();
+#ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
+  check();
+#endif
+}
+
 void Datacube::resetFilter() {
   if (d->filters.empty()) {
     return;
   }
+  d->begin_reset();
   d->filters.clear();
-  for (int row = 0, nrows = d->model->rowCount(); row<nrows; ++row) {
-    const bool was_included = d->reverse_index.contains(row);
-    if (!was_included) {
-      d->add(row);
-    }
-  }
+  d->filter_order.reset(0);
+  d->dropped_cells.clear();
+  d->rebuild();
+  d->end_reset();
   emit filterChanged();
+#ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
+  check();
+#endif
 
 }
 
@@ -326,45 +702,47 @@ int Datacube::headerCount(Qt::Orientation orientation) const {
 }
 
 int Datacube::elementCount(int row, int column) const {
-  return  elements(row,column).size();
+  return d->cellSize(d->bucket_for_row(row), d->bucket_for_column(column));
 }
 
 int Datacube::columnCount() const {
-  return d->col_counts.size() - std::count(d->col_counts.begin(), d->col_counts.end(), 0u);
+  return d->col_index.count();
 }
 
 int Datacube::rowCount() const {
-  return d->row_counts.size() - std::count(d->row_counts.begin(), d->row_counts.end(), 0u);
+  return d->row_index.count();
 }
 
 QList< int > Datacube::elements(int row, int column) const {
   // Note that this function should be very fast indeed.
   const int row_section = d->bucket_for_row(row);
   const int col_section = d->bucket_for_column(column);
-  return d->cell(row_section, col_section);
+  return d->to_rows(d->cell(row_section, col_section));
 
 }
 
+ElementRange Datacube::elementRange(int row, int column) const {
+  ElementRange rv = d->element_range();
+  const long cell = d->bucket_for_row(row) + long(d->bucket_for_column(column))*d->row_counts.size();
+  const DatacubePrivate::cells_t::const_iterator it = d->cells.constFind(cell);
+  if (it != d->cells.constEnd()) {
+    rv.d->append(it.begin(), it.end());
+    rv.d->size = it.size();
+    rv.d->totals = d->measures.find(cell);
+    rv.d->cell = cell;
+  }
+  return rv;
+}
+
 QList< Datacube::HeaderDescription > Datacube::headers(Qt::Orientation orientation, int index) const {
   QList< HeaderDescription > rv;
-  Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
-  const QVector<unsigned>& counts = (orientation == Qt::Horizontal) ? d->col_counts : d->row_counts;
-  AbstractAggregator::Ptr aggregator = aggregators.at(index);
-  const int ncats = aggregator->categoryCount();
-  int stride = 1;
-  for (int i=index+1; i<aggregators.size(); ++i) {
-    stride *= aggregators.at(i)->categoryCount();
-  }
-  for (int c=0; c<counts.size(); c+=stride) {
-    int count = 0;
-    for (int i=0;i<stride; ++i) {
-      if (counts.at(c+i)>0) {
-        ++count;
-      }
-    }
-    if (count > 0 ) {
-      rv << HeaderDescription((c/stride)%ncats, count);
-    }
+  const HeaderIndex& header_index = d->header_index(orientation, index);
+  const BucketOrder& order = (orientation == Qt::Horizontal) ? d->col_order : d->row_order;
+  const Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
+  const int ncats = aggregators.at(index)->categoryCount();
+  for (int header_section = 0, nheader_sections = header_index.count(index); header_section < nheader_sections; ++header_section) {
+    const int category = order.category(index, header_index.group(index, header_section) % ncats);
+    rv << HeaderDescription(category, header_index.span(index, header_section));
   }
   return rv;
 }
@@ -373,110 +751,238 @@ Datacube::~Datacube() {
   // Need to declare here so datacube_colrow_t's destructor is visible
 }
 
-void DatacubePrivate::add(int index) {
-    Q_ASSERT(index < model->rowCount());
+void DatacubePrivate::add(int row) {
+  add(row, computeRowBucketForIndex(row), computeColumnBucketForIndex(row));
+}
+
+void DatacubePrivate::add(int row, int rowBucket, int columnBucket) {
+    Q_ASSERT(row < model->rowCount());
+    Q_ASSERT(update_depth > 0); // the signals are sent from end_update()
 
-  // Compute bucket
-  int rowBucket = computeRowBucketForIndex(index);
   if (rowBucket == -1) {
     // Our datacube does not cover that container. Just ignore it.
     return;
   }
-  int columnBucket = computeColumnBucketForIndex(index);
   Q_ASSERT(columnBucket>=0); // Every container should be in both rows and columns, or neither place.
+  const int index = element_map.id(row);
+  if (has_values()) {
+    read_values(row, index);
+  }
 
-  // Check if rows/columns are added, and notify listernes as neccessary
-  int row_to_add = -1;
-  int column_to_add = -1;
-    {
-        unsigned int& section_count = row_counts[rowBucket];
-        section_count += 1;
-        if(section_count == 1) {
-            row_to_add = bucket_to_row(rowBucket);;
-            emit q->rowsAboutToBeInserted(row_to_add,1);
-        }
-    }
-    {
-        unsigned int& section_count = col_counts[columnBucket];
-        section_count += 1;
-        if(section_count == 1) {
-            column_to_add = bucket_to_column(columnBucket);
-            emit q->columnsAboutToBeInserted(column_to_add,1);
-        }
-    }
+  if (++row_counts[rowBucket] == 1) {
+    set_bucket_non_empty(Qt::Vertical, rowBucket, true);
+  } else {
+    row_headers.addCount(row_order.toDisplay(rowBucket), 1);
+  }
+  if (++col_counts[columnBucket] == 1) {
+    set_bucket_non_empty(Qt::Horizontal, columnBucket, true);
+  } else {
+    col_headers.addCount(col_order.toDisplay(columnBucket), 1);
+  }
 
   // Actually add
+  const long cell = rowBucket + long(columnBucket)*row_counts.size();
   cellAppend(rowBucket, columnBucket,index);
+  if (has_values()) {
+    add_values(cell, rowBucket, columnBucket, index);
+  }
   Q_ASSERT(!reverse_index.contains(index));
   reverse_index.insert(index, Cell(rowBucket, columnBucket));
+  changed_cells << cell;
 
   // Notify various listerners
   Q_FOREACH(DatacubeSelection* selection, selection_models) {
     selection->d->datacube_adds_element_to_bucket(rowBucket, columnBucket, index);
   }
-  if(column_to_add>=0) {
-    emit q->columnsInserted(column_to_add,1);
+}
+
+void DatacubePrivate::add_rows(QList<int> rows) {
+  Q_ASSERT(update_depth > 0);
+  if (rows.isEmpty()) {
+    return;
   }
-  if(row_to_add>=0) {
-    emit q->rowsInserted(row_to_add,1);
+  std::sort(rows.begin(), rows.end());
+  const int begin = rows.first();
+  const int end = rows.last() + 1;
+  if (4L*rows.size() < end - begin) {
+    // Too sparse for categorizing the rows in between to pay off
+    Q_FOREACH(int row, rows) {
+      add(row);
+    }
+    return;
   }
-  if(row_to_add==-1 && column_to_add==-1) {
-    emit q->dataChanged(bucket_to_row(rowBucket),bucket_to_column(columnBucket));
+  QVector<int> row_buckets(end - begin);
+  QVector<int> column_buckets(end - begin);
+  compute_buckets(Qt::Vertical, begin, end, row_buckets.data());
+  compute_buckets(Qt::Horizontal, begin, end, column_buckets.data());
+  Q_FOREACH(int row, rows) {
+    add(row, row_buckets.at(row - begin), column_buckets.at(row - begin));
+  }
+}
+
+void DatacubePrivate::compute_cells(int begin, int end, long* cell_for_element) {
+  const long nrows = row_counts.size();
+  int row_buckets[categorize_block];
+  int column_buckets[categorize_block];
+  for (int block_begin = begin; block_begin < end; block_begin += categorize_block) {
+    const int block_end = qMin(block_begin + categorize_block, end);
+    compute_buckets(Qt::Vertical, block_begin, block_end, row_buckets);
+    compute_buckets(Qt::Horizontal, block_begin, block_end, column_buckets);
+    for (int element = block_begin; element < block_end; ++element) {
+      const bool included = filtered_in(element);
+      cell_for_element[element] = included ? row_buckets[element-block_begin] + column_buckets[element-block_begin]*nrows : -1;
+    }
   }
 }
 
-void DatacubePrivate::remove(int index) {
+bool DatacubePrivate::parallel_build_possible() const {
+  Q_FOREACH(AbstractAggregator::Ptr aggregator, row_aggregators + col_aggregators) {
+    if (!aggregator->isThreadSafe()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void DatacubePrivate::rebuild() {
+  reset_filter_cache();
+  const int nelements = model->rowCount();
+  QVector<long> cell_for_element(nelements);
+  // The aggregators are by far the most expensive part, so they are run in parallel if they allow it, as the filters
+  // were by reset_filter_cache() above.
+  // The counting below is cheap in comparison, and per thread histograms could be as big as the number of buckets.
+  const int nthreads = QThreadPool::globalInstance()->maxThreadCount();
+  if (nthreads > 1 && nelements >= 2*min_parallel_chunk && parallel_build_possible()) {
+    const int nchunks = qMin(nthreads*4, nelements/min_parallel_chunk);
+    QVector<ElementChunk> chunks(nchunks);
+    for (int i=0; i<nchunks; ++i) {
+      chunks[i].begin = int(long(nelements)*i/nchunks);
+      chunks[i].end = int(long(nelements)*(i+1)/nchunks);
+    }
+    QtConcurrent::blockingMap(chunks, ComputeChunkCells(this, cell_for_element.data()));
+  } else {
+    compute_cells(0, nelements, cell_for_element.data());
+  }
+  if (!element_map.isIdentity()) {
+    // Move the cells from rows to element ids
+    QVector<long> cell_for_id(element_map.idCount(), -1);
+    const QVector<int> ids = element_map.ids();
+    for (int row = 0; row < nelements; ++row) {
+      cell_for_id[ids.at(row)] = cell_for_element.at(row);
+    }
+    cell_for_element = cell_for_id;
+  }
+  const long nrows = row_counts.size();
+  row_counts = QVector<unsigned>(row_counts.size());
+  col_counts = QVector<unsigned>(col_counts.size());
+  reverse_index.clear();
+  reverse_index.resize(cell_for_element.size());
+  for (int element = 0; element < cell_for_element.size(); ++element) {
+    const long cell = cell_for_element.at(element);
+    if (cell < 0) {
+      continue;
+    }
+    const int row_bucket = cell % nrows;
+    const int column_bucket = cell / nrows;
+    ++row_counts[row_bucket];
+    ++col_counts[column_bucket];
+    reverse_index.insert(element, Cell(row_bucket, column_bucket));
+  }
+  cells.assign(cell_for_element);
+  reset_bucket_indexes();
+  read_values();
+  rebuild_measures();
+}
+
+void DatacubePrivate::remove(int row) {
+  Q_ASSERT(update_depth > 0); // the signals are sent from end_update()
+  const int index = element_map.id(row);
   Cell cell = reverse_index.value(index);
   if (cell.invalid()) {
     // Our datacube does not cover that container. Just ignore it.
     return;
   }
+  if (row_counts.at(cell.row()) == 1 || col_counts.at(cell.column()) == 1) {
+    // The last element of a row or column, whose removal the update ends in a reset for
+    announce_reset();
+  }
   Q_FOREACH(DatacubeSelection* selection, selection_models) {
     selection->d->datacube_removes_element_from_bucket(cell.row(), cell.column(), index);
   }
-  int row_to_remove = -1;
-  int column_to_remove = -1;
   if(--row_counts[cell.row()]==0) {
-    row_to_remove = bucket_to_row(cell.row());
-    emit q->rowsAboutToBeRemoved(row_to_remove,1);
+    set_bucket_non_empty(Qt::Vertical, cell.row(), false);
+  } else {
+    row_headers.addCount(row_order.toDisplay(cell.row()), -1);
   }
   if(--col_counts[cell.column()]==0) {
-    column_to_remove = bucket_to_column(cell.column());
-    emit q->columnsAboutToBeRemoved(column_to_remove,1);
+    set_bucket_non_empty(Qt::Horizontal, cell.column(), false);
+  } else {
+    col_headers.addCount(col_order.toDisplay(cell.column()), -1);
   }
   Q_ASSERT(hasCell(cell.row(),cell.column()));
   const bool check = cellRemoveOne(cell.row(), cell.column(),index);
   Q_UNUSED(check)
   Q_ASSERT(check);
-  reverse_index.remove(index);
-  if(column_to_remove>=0) {
-    emit q->columnsRemoved(column_to_remove,1);
-  }
-  if(row_to_remove>=0) {
-    emit q->rowsRemoved(row_to_remove,1);
-  }
-  if(row_to_remove==-1 && column_to_remove==-1) {
-    emit q->dataChanged(bucket_to_row(cell.row()),bucket_to_column(cell.column()));
+  const long cell_index = cell.row() + long(cell.column())*row_counts.size();
+  if (has_values()) {
+    remove_values(cell_index, cell.row(), cell.column(), index);
   }
+  reverse_index.remove(index);
+  changed_cells << cell_index;
 }
 
 void DatacubePrivate::update_data(QModelIndex topleft, QModelIndex bottomRight) {
   const int toprow = topleft.row();
   const int buttomrow = bottomRight.row();
+  const int nelements = buttomrow - toprow + 1;
+  if (nelements <= 0) {
+    return;
+  }
+  QVector<int> row_buckets(nelements);
+  QVector<int> column_buckets(nelements);
+  compute_buckets(Qt::Vertical, toprow, buttomrow+1, row_buckets.data());
+  compute_buckets(Qt::Horizontal, toprow, buttomrow+1, column_buckets.data());
+  bool values_changed = false;
+  for (int measure = 0; measure < measures.count(); ++measure) {
+    const int column = measures.column(measure);
+    values_changed |= topleft.column() <= column && column <= bottomRight.column();
+  }
+  for (int distinct = 0; distinct < distincts.count(); ++distinct) {
+    const int column = distincts.column(distinct);
+    values_changed |= topleft.column() <= column && column <= bottomRight.column();
+  }
+  for (int quantile = 0; quantile < quantiles.count(); ++quantile) {
+    const int column = quantiles.column(quantile);
+    values_changed |= topleft.column() <= column && column <= bottomRight.column();
+  }
+  // Elements dropped by a filter on a header may belong to other cells now
+  forget_dropped_cells();
+  begin_update();
   for (int element = toprow; element <= buttomrow; ++element) {
-    const bool filtered_out = !filtered_in(element);
-    int new_row_section = computeBucketForIndex(Qt::Vertical, element);
-    int new_column_section = computeBucketForIndex(Qt::Horizontal, element);
-    Cell old_cell = reverse_index.value(element);
+    const int id = element_map.id(element);
+    const bool filtered_out = !evaluate_filters(element, id);
+    int new_row_section = row_buckets.at(element - toprow);
+    int new_column_section = column_buckets.at(element - toprow);
+    Cell old_cell = reverse_index.value(id);
     const bool rowchanged = old_cell.row() != new_row_section;
     const bool colchanged = old_cell.column() != new_column_section;
     if (rowchanged || colchanged || filtered_out) {
       remove(element);
       if (!filtered_out) {
-        add(element);
+        add(element, new_row_section, new_column_section);
       }
+    } else {
+      // Same cell, but what the formatters show for it might have changed
+      const long cell = old_cell.row() + long(old_cell.column())*row_counts.size();
+      if (values_changed) {
+        remove_values(cell, old_cell.row(), old_cell.column(), id);
+        read_values(element, id);
+        add_values(cell, old_cell.row(), old_cell.column(), id);
+      }
+      changed_cells << cell;
     }
   }
+  end_update();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   q->check();
 #endif
@@ -485,15 +991,18 @@ void DatacubePrivate::update_data(QModelIndex topleft, QModelIndex bottomRight)
 void DatacubePrivate::insert_data(QModelIndex parent, int start, int end) {
   Q_ASSERT(!parent.isValid());
   Q_UNUSED(parent);
-  Q_FOREACH(DatacubeSelection* selection, selection_models) {
-    selection->d->datacube_inserts_elements(start, end);
-  }
-  renumber_cells(start, end-start+1);
+  element_map.insertRows(start, end-start+1);
+  QVector<int> row_buckets(end-start+1);
+  QVector<int> column_buckets(end-start+1);
+  compute_buckets(Qt::Vertical, start, end+1, row_buckets.data());
+  compute_buckets(Qt::Horizontal, start, end+1, column_buckets.data());
+  begin_update();
   for (int row = start; row <=end; ++row) {
-    if(filtered_in(row)) {
-      add(row);
+    if(evaluate_filters(row, element_map.id(row))) {
+      add(row, row_buckets.at(row-start), column_buckets.at(row-start));
     }
   }
+  end_update();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   q->check();
 #endif
@@ -506,54 +1015,41 @@ void DatacubePrivate::remove_data(QModelIndex parent, int start, int end) {
 #endif
   Q_ASSERT(!parent.isValid());
   Q_UNUSED(parent);
+  // The ids of the rows removed may be given to new rows
+  forget_dropped_cells();
+  begin_update();
   for (int row = end; row>=start; --row) {
     remove(row);
+    // The id may be given to a new row later
+    filter_cache.removeElement(element_map.id(row));
   }
   Q_FOREACH(DatacubeSelection* selection, selection_models) {
     selection->d->datacube_deletes_elements(start, end);
   }
-  // Now, all the remaining elements have to be renumbered
-  renumber_cells(end+1, start-end-1);
-
-}
-
-void DatacubePrivate::renumber_cells(int start, int adjustment) {
-  reverse_index_t new_index;
-  for (cells_t::iterator it = cells.begin(), iend = cells.end(); it != iend; ++it) {
-    for (QList<int>::iterator jit = it->begin(), jend = it->end(); jit != jend; ++jit) {
-      Cell cell = reverse_index.value(*jit);
-      if (*jit >= start) {
-        *jit += adjustment;
-      }
-      new_index.insert(*jit, cell);
-    }
-  }
-  reverse_index = new_index;
+  // The remaining elements keep their ids, only the mapping to rows changes
+  element_map.removeRows(start, end-start+1);
+  end_update();
 
 }
 
 void DatacubePrivate::slot_columns_changed(int column, int count) {
-  for (int col = column; col<=column+count;++col) {
-    const int rowcount = q->rowCount();
-    for (int row = 0; row < rowcount; ++row) {
-      emit q->dataChanged(row,col);
-    }
+  begin_update();
+  for (int col = column; col<column+count;++col) {
+    changed_column_buckets << bucket_for_column(col);
   }
-  emit q->headersChanged(Qt::Horizontal, column, column+count-1);
+  end_update();
 }
 
 void DatacubePrivate::slot_rows_changed(int row, int count) {
-  for (int r = row; r<=row+count;++r) {
-    const int columncount = q->columnCount();
-    for (int column = 0; column < columncount; ++column) {
-      emit q->dataChanged(r,column);
-    }
+  begin_update();
+  for (int r = row; r<row+count;++r) {
+    changed_row_buckets << bucket_for_row(r);
   }
-  emit q->headersChanged(Qt::Vertical, row, row+count-1);
+  end_update();
 }
 
 void Datacube::split(Qt::Orientation orientation, int headerno, AbstractAggregator::Ptr aggregator) {
-  emit aboutToBeReset();
+  d->begin_reset();
   if (orientation == Qt::Vertical) {
     d->split_row(headerno, aggregator);
   } else {
@@ -561,7 +1057,8 @@ void Datacube::split(Qt::Orientation orientation, int headerno, AbstractAggregat
   }
   connect(aggregator.data(), SIGNAL(categoryAdded(int)), d.data(), SLOT(slot_aggregator_category_added(int)));
   connect(aggregator.data(), SIGNAL(categoryRemoved(int)), d.data(), SLOT(slot_aggregator_category_removed(int)));;
-  emit reset();
+  d->connect_model();
+  d->end_reset();
 }
 
 void DatacubePrivate::split_row(int headerno, AbstractAggregator::Ptr aggregator)
@@ -577,7 +1074,7 @@ void DatacubePrivate::split_row(int headerno, AbstractAggregator::Ptr aggregator
     return;
   }
   const int target_row_count = target_row_countl;
-  emit q->aboutToBeReset();
+  begin_reset();
   DatacubePrivate::cells_t oldcells = cells;
   cells = DatacubePrivate::cells_t();
   int cat_stride = 1;
@@ -587,7 +1084,8 @@ void DatacubePrivate::split_row(int headerno, AbstractAggregator::Ptr aggregator
   int target_stride = cat_stride*ncats;
   QVector<unsigned> old_row_counts = row_counts;
   row_counts = QVector<unsigned>(old_row_counts.size()*ncats);
-  reverse_index = DatacubePrivate::reverse_index_t();
+  reverse_index.clear();
+  const QVector<int> categories = categorize_elements(aggregator.data());
   // Sort out elements in new categories. Note that the old d->col_counts are unchanged
   for(DatacubePrivate::cells_t::const_iterator it = oldcells.constBegin(), end = oldcells.constEnd(); it!= end; ++it) {
         const long index = it.key();
@@ -595,16 +1093,19 @@ void DatacubePrivate::split_row(int headerno, AbstractAggregator::Ptr aggregator
         const long r = index % source_row_count;
         const long major = r / cat_stride;
         const long minor = r % cat_stride;
-        Q_FOREACH(int element,it.value()) {
-            const long target_row = major*target_stride + minor + (*aggregator).operator()(element) * cat_stride;
+        for (const int* eit = it.begin(), *eend = it.end(); eit != eend; ++eit) {
+            const int element = *eit;
+            const long target_row = major*target_stride + minor + categories.at(element) * cat_stride;
             const long target_index = target_row + long(c)*target_row_count;
-            cells[target_index] << element;
+            cells.append(target_index, element);
             ++row_counts[target_row];
             reverse_index.insert(element, Cell(target_row, c));
         }
   }
   row_aggregators.insert(headerno, aggregator);
-  emit q->reset();
+  reset_bucket_index(Qt::Vertical);
+  rebuild_measures();
+  end_reset();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   q->check();
 #endif
@@ -622,7 +1123,7 @@ void DatacubePrivate::split_column(int headerno, AbstractAggregator::Ptr aggrega
     qWarning("We are overflowing! Avoiding it by not splitting column.");
     return;
   }
-  emit q->aboutToBeReset();
+  begin_reset();
   DatacubePrivate::cells_t oldcells = cells;
   cells = DatacubePrivate::cells_t();
   const int row_count = row_counts.size();
@@ -633,7 +1134,8 @@ void DatacubePrivate::split_column(int headerno, AbstractAggregator::Ptr aggrega
   int target_stride = cat_stride*ncats;
   QVector<unsigned> old_column_counts = col_counts;
   col_counts = QVector<unsigned>(int(new_column_countl));
-  reverse_index = DatacubePrivate::reverse_index_t();
+  reverse_index.clear();
+  const QVector<int> categories = categorize_elements(aggregator.data());
   // Sort out elements in new categories. Note that the old d->row_counts are unchanged
 
   for(DatacubePrivate::cells_t::const_iterator it = oldcells.constBegin(), end = oldcells.constEnd(); it!= end; ++it) {
@@ -642,16 +1144,19 @@ void DatacubePrivate::split_column(int headerno, AbstractAggregator::Ptr aggrega
         const long c = index/row_count;
         const long major = c/cat_stride;
         const long minor = c%cat_stride;
-        Q_FOREACH(int element,it.value()) {
-            const long target_column = major*target_stride + minor + (*aggregator).operator()(element) * cat_stride;
+        for (const int* eit = it.begin(), *eend = it.end(); eit != eend; ++eit) {
+            const int element = *eit;
+            const long target_column = major*target_stride + minor + categories.at(element) * cat_stride;
             const long target_index = r + long(target_column)*row_counts.size();
-            cells[target_index] << element;
+            cells.append(target_index, element);
             reverse_index.insert(element, Cell(r, target_column));
             ++col_counts[target_column];
         }
   }
   col_aggregators.insert(headerno, aggregator);
-  emit q->reset();
+  reset_bucket_index(Qt::Horizontal);
+  rebuild_measures();
+  end_reset();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   q->check();
 #endif
@@ -662,7 +1167,7 @@ void Datacube::collapse(Qt::Orientation orientation, int headerno) {
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   check();
 #endif
-  emit aboutToBeReset();
+  d->begin_reset();
   DatacubePrivate::cells_t oldcells = d->cells;
   const bool horizontal = (orientation == Qt::Horizontal);
   Datacube::Aggregators& parallel_aggregators = horizontal ? d->col_aggregators : d->row_aggregators;
@@ -681,7 +1186,7 @@ void Datacube::collapse(Qt::Orientation orientation, int headerno) {
   QVector<unsigned>& new_counts = horizontal ? d->col_counts : d->row_counts;
   QVector<unsigned> old_counts = new_counts;
   new_counts = QVector<unsigned>(old_counts.size()/ncats);
-  d->reverse_index = DatacubePrivate::reverse_index_t();
+  d->reverse_index.clear();
   for (int major=0; major<(new_counts.size()/cat_stride); ++major) {
     for (int minor=0; minor<cat_stride; ++minor) {
       const int p = major*cat_stride+minor;
@@ -690,7 +1195,7 @@ void Datacube::collapse(Qt::Orientation orientation, int headerno) {
         QList<int> cell;
         for (int i = 0; i<ncats; ++i) {
           const int old_parallel_index = major*source_stride+minor+i*cat_stride;
-          QList<int> oldcell = oldcells.value(horizontal ? (old_parallel_index)*normal_count+n : n*old_counts.size()+old_parallel_index);
+          QList<int> oldcell = oldcells.elements(horizontal ? (old_parallel_index)*normal_count+n : n*old_counts.size()+old_parallel_index);
           cell.append(oldcell);
           count += oldcell.size();
           Q_FOREACH(int element, oldcell) {
@@ -701,7 +1206,9 @@ void Datacube::collapse(Qt::Orientation orientation, int headerno) {
       }
     }
   }
-  emit reset();
+  d->reset_bucket_indexes();
+  d->rebuild_measures();
+  d->end_reset();
 #ifdef ANGE_QDATACUBE_CHECK_PRE_POST_CONDITIONS
   check();
 #endif
@@ -713,10 +1220,11 @@ int Datacube::sectionForElement(int element, Qt::Orientation orientation) const
 }
 
 int Datacube::internalSection(int element, Qt::Orientation orientation) const {
+  const Cell cell = d->reverse_index.value(d->element_map.id(element));
   if (orientation == Qt::Horizontal) {
-    return d->bucket_to_column(d->reverse_index.value(element).column());
+    return d->bucket_to_column(cell.column());
   } else  {
-    return d->bucket_to_row(d->reverse_index.value(element).row());
+    return d->bucket_to_row(cell.row());
   }
 
 }
@@ -725,10 +1233,226 @@ void DatacubePrivate::bucket_for_element(int element, Cell& result) const {
   result = reverse_index.value(element);
 }
 
+void DatacubePrivate::read_values(int row, int element) {
+  for (int measure = 0; measure < measures.count(); ++measure) {
+    measures.setValue(measure, element, model->index(row, measures.column(measure)).data().toDouble());
+  }
+  for (int distinct = 0; distinct < distincts.count(); ++distinct) {
+    distincts.setHash(distinct, element, HyperLogLog::hash(model->index(row, distincts.column(distinct)).data().toString()));
+  }
+  for (int quantile = 0; quantile < quantiles.count(); ++quantile) {
+    quantiles.setValue(quantile, element, model->index(row, quantiles.column(quantile)).data().toDouble());
+  }
+}
+
+void DatacubePrivate::read_values() {
+  if (!has_values()) {
+    return;
+  }
+  const QVector<int> ids = element_map.ids();
+  for (int row = 0; row < ids.size(); ++row) {
+    read_values(row, ids.at(row));
+  }
+}
+
+void DatacubePrivate::add_values(long cell, int bucket_row, int bucket_column, int element) {
+  distincts.add(cell, bucket_row, bucket_column, element);
+  quantiles.add(cell, bucket_row, bucket_column, element);
+  if (measures.isEmpty()) {
+    return;
+  }
+  measures.add(cell, element);
+  row_measures.add(bucket_row, measures, element);
+  col_measures.add(bucket_column, measures, element);
+  total_measures.add(0, measures, element);
+  row_headers.addValues(row_order.toDisplay(bucket_row), measures, element);
+  col_headers.addValues(col_order.toDisplay(bucket_column), measures, element);
+}
+
+void DatacubePrivate::remove_values(long cell, int bucket_row, int bucket_column, int element) {
+  distincts.remove(cell, bucket_row, bucket_column);
+  quantiles.remove(cell, bucket_row, bucket_column);
+  if (measures.isEmpty()) {
+    return;
+  }
+  measures.remove(cell, element, cells);
+  row_measures.remove(bucket_row, measures, element);
+  col_measures.remove(bucket_column, measures, element);
+  total_measures.remove(0, measures, element);
+  row_headers.removeValues(row_order.toDisplay(bucket_row), measures, element);
+  col_headers.removeValues(col_order.toDisplay(bucket_column), measures, element);
+}
+
+void DatacubePrivate::rebuild_measures() {
+  distincts.clear();
+  quantiles.clear();
+  measures.rebuild(cells);
+  const int nrows = row_counts.size();
+  row_measures.reset(nrows, measures.count());
+  col_measures.reset(col_counts.size(), measures.count());
+  total_measures.reset(1, measures.count());
+  row_headers.invalidate();
+  col_headers.invalidate();
+  if (measures.isEmpty()) {
+    return;
+  }
+  for (cells_t::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+    const Measure* cell_measures = measures.find(it.key());
+    row_measures.add(int(it.key() % nrows), cell_measures);
+    col_measures.add(int(it.key() / nrows), cell_measures);
+    total_measures.add(0, cell_measures);
+  }
+}
+
+void DatacubePrivate::refresh_measures(Qt::Orientation orientation) {
+  const bool horizontal = orientation == Qt::Horizontal;
+  MeasureTotals& bucket_measures = horizontal ? col_measures : row_measures;
+  if (!bucket_measures.hasStale()) {
+    return;
+  }
+  const long nrows = row_counts.size();
+  const int normal_count = horizontal ? row_counts.size() : col_counts.size();
+  const QVector<unsigned>& normal_counts = horizontal ? row_counts : col_counts;
+  Q_FOREACH(int bucket, bucket_measures.takeStale()) {
+    bucket_measures.clear(bucket);
+    for (int n = 0; n < normal_count; ++n) {
+      if (normal_counts.at(n) > 0) {
+        const Measure* cell_measures = measures.find(horizontal ? n + bucket*nrows : bucket + n*nrows);
+        if (cell_measures) {
+          bucket_measures.add(bucket, cell_measures);
+        }
+      }
+    }
+  }
+}
+
+const Measure* DatacubePrivate::totals() {
+  if (total_measures.hasStale()) {
+    // The row buckets are as good a way as any to sum up all the cells
+    refresh_measures(Qt::Vertical);
+    total_measures.takeStale();
+    total_measures.clear(0);
+    for (int bucket = 0; bucket < row_counts.size(); ++bucket) {
+      total_measures.add(0, row_measures.measures(bucket));
+    }
+  }
+  return total_measures.measures(0);
+}
+
+HyperLogLog DatacubePrivate::distinct_sketch(const ElementRangePrivate& range, int distinct) {
+  if (range.display_bucket_count < 0) {
+    return distincts.totalSketch(distinct, cells);
+  }
+  if (range.display_bucket_count == 0) {
+    return range.cell < 0 ? HyperLogLog() : distincts.cellSketch(distinct, range.cell, cells);
+  }
+  const bool horizontal = range.horizontal;
+  const QVector<unsigned>& counts = horizontal ? col_counts : row_counts;
+  const BucketOrder& order = horizontal ? col_order : row_order;
+  HyperLogLog rv;
+  for (int display_bucket = range.first_display_bucket; display_bucket < range.first_display_bucket + range.display_bucket_count; ++display_bucket) {
+    const int bucket = order.toBucket(display_bucket);
+    if (counts.at(bucket) > 0) {
+      rv.merge(horizontal ? distincts.columnSketch(distinct, bucket, cells, row_counts.size())
+                          : distincts.rowSketch(distinct, bucket, cells, row_counts.size(), col_counts.size()));
+    }
+  }
+  return rv;
+}
+
+TDigest DatacubePrivate::quantile_digest(const ElementRangePrivate& range, int quantile) {
+  if (range.display_bucket_count < 0) {
+    return quantiles.totalDigest(quantile, cells);
+  }
+  if (range.display_bucket_count == 0) {
+    return range.cell < 0 ? TDigest() : quantiles.cellDigest(quantile, range.cell, cells);
+  }
+  const bool horizontal = range.horizontal;
+  const QVector<unsigned>& counts = horizontal ? col_counts : row_counts;
+  const BucketOrder& order = horizontal ? col_order : row_order;
+  TDigest rv;
+  for (int display_bucket = range.first_display_bucket; display_bucket < range.first_display_bucket + range.display_bucket_count; ++display_bucket) {
+    const int bucket = order.toBucket(display_bucket);
+    if (counts.at(bucket) > 0) {
+      rv.merge(horizontal ? quantiles.columnDigest(quantile, bucket, cells, row_counts.size())
+                          : quantiles.rowDigest(quantile, bucket, cells, row_counts.size(), col_counts.size()));
+    }
+  }
+  rv.compress();
+  return rv;
+}
+
+ElementRange DatacubePrivate::element_range() {
+  ElementRange rv;
+  rv.d->datacube = this;
+  rv.d->map = element_map.isIdentity() ? 0 : &element_map;
+  rv.d->measures = &measures;
+  return rv;
+}
+
+void DatacubePrivate::fill_range(const ElementRangePrivate& range) const {
+  if (range.display_bucket_count < 0) {
+    for (cells_t::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+      range.append(it.begin(), it.end());
+    }
+    return;
+  }
+  const bool horizontal = range.horizontal;
+  const QVector<unsigned>& counts = horizontal ? col_counts : row_counts;
+  const BucketOrder& order = horizontal ? col_order : row_order;
+  const long nrows = row_counts.size();
+  const int normal_count = horizontal ? row_counts.size() : col_counts.size();
+  for (int display_bucket = range.first_display_bucket; display_bucket < range.first_display_bucket + range.display_bucket_count; ++display_bucket) {
+    const int bucket = order.toBucket(display_bucket);
+    if (counts.at(bucket)>0) {
+      for (int n=0; n<normal_count; ++n) {
+        const cells_t::const_iterator it = cells.constFind(horizontal ? n + bucket*nrows : bucket + n*nrows);
+        if (it != cells.constEnd()) {
+          range.append(it.begin(), it.end());
+        }
+      }
+    }
+  }
+}
+
+QList<int> DatacubePrivate::to_rows(const QList<int>& elements) const {
+  if (element_map.isIdentity()) {
+    return elements;
+  }
+  QList<int> rv;
+  rv.reserve(elements.size());
+  Q_FOREACH(int element, elements) {
+    rv << element_map.row(element);
+  }
+  return rv;
+}
+
+QVector<int> DatacubePrivate::categorize_elements(const AbstractAggregator* aggregator) const {
+  QVector<int> categories(model->rowCount());
+  aggregator->categorize(0, categories.size(), categories.data());
+  if (element_map.isIdentity()) {
+    return categories;
+  }
+  QVector<int> rv(element_map.idCount(), -1);
+  const QVector<int> ids = element_map.ids();
+  for (int row = 0; row < categories.size(); ++row) {
+    rv[ids.at(row)] = categories.at(row);
+  }
+  return rv;
+}
+
 Datacube::Filters Datacube::filters() const {
   return d->filters;
 }
 
+QList<FilterStatistics> Datacube::filterStatistics() const {
+  QList<FilterStatistics> rv;
+  for (int filter = 0; filter < d->filter_order.count(); ++filter) {
+    rv << d->filter_order.statistics(filter);
+  }
+  return rv;
+}
+
 const QAbstractItemModel* qdatacube::Datacube::underlyingModel() const {
   return d->model;
 }
@@ -743,12 +1467,12 @@ void qdatacube::Datacube::dump(bool cells, bool rowcounts, bool col_counts) cons
     qDebug() << "row_counts: " << d->row_counts;
   }
   if (cells) {
-    qDebug() << "Check: " << d->row_counts.size() << " * " << d->col_counts.size() << "=" << d->cells.size();
+    qDebug() << "Check: " << d->row_counts.size() << " * " << d->col_counts.size() << "=" << d->cells.count();
   }
   for (int r=0; r<d->row_counts.size(); ++r) {
     QList<int> row;
     for (int c=0; c<d->col_counts.size(); ++c) {
-      row << d->cells.value(r+d->row_counts.size()*c).size();
+      row << d->cells.size(r+d->row_counts.size()*c);
     }
     qDebug() << row;
   }
@@ -760,14 +1484,14 @@ void qdatacube::DatacubePrivate::slot_aggregator_category_added(int newCategoryI
     int headerno = 0;
     Q_FOREACH(AbstractAggregator::Ptr f, row_aggregators) {
       if (f == aggregator) {
-        aggregator_category_added(f, headerno, newCategoryIndex, Qt::Vertical);
+        relayout_category(Qt::Vertical, headerno, newCategoryIndex, 1);
       }
       ++headerno;
     }
     headerno = 0;
     Q_FOREACH(AbstractAggregator::Ptr f, col_aggregators) {
       if (f == aggregator) {
-        aggregator_category_added(f, headerno, newCategoryIndex, Qt::Horizontal);
+        relayout_category(Qt::Horizontal, headerno, newCategoryIndex, 1);
       }
       ++headerno;
     }
@@ -779,14 +1503,14 @@ void qdatacube::DatacubePrivate::slot_aggregator_category_removed(int categoryIn
     int headerno = 0;
     Q_FOREACH(AbstractAggregator::Ptr f, row_aggregators) {
       if (f == aggregator) {
-        aggregator_category_removed(f, headerno, categoryIndex, Qt::Vertical);
+        relayout_category(Qt::Vertical, headerno, categoryIndex, -1);
       }
       ++headerno;
     }
     headerno = 0;
     Q_FOREACH(AbstractAggregator::Ptr f, col_aggregators) {
       if (f == aggregator) {
-        aggregator_category_removed(f, headerno, categoryIndex, Qt::Horizontal);
+        relayout_category(Qt::Horizontal, headerno, categoryIndex, -1);
       }
       ++headerno;
     }
@@ -795,110 +1519,160 @@ void qdatacube::DatacubePrivate::slot_aggregator_category_removed(int categoryIn
 }
 
 
-void qdatacube::DatacubePrivate::aggregator_category_added(qdatacube::AbstractAggregator::Ptr aggregator, int headerno, int newCategoryIndex, Qt::Orientation orientation)
-{
+void qdatacube::DatacubePrivate::relayout_category(Qt::Orientation orientation, int headerno, int category, int adjustment) {
   const Datacube::Aggregators& parallel_aggregators = orientation == Qt::Horizontal ? col_aggregators : row_aggregators;
-  QVector<unsigned>& new_parallel_counts = orientation == Qt::Horizontal ? col_counts : row_counts;
-  const QVector<unsigned>& normal_counts = orientation == Qt::Horizontal ? row_counts : col_counts;
-  const int normal_count = normal_counts.size();
-  const QVector<unsigned> old_parallel_counts = new_parallel_counts;
-  DatacubePrivate::cells_t old_cells = cells;
   int nsuper_categories = 1;
   for (int h=0; h<headerno; ++h) {
-    nsuper_categories *= qMax(parallel_aggregators[h]->categoryCount(),1);
+    nsuper_categories *= parallel_aggregators[h]->categoryCount();
   }
-  const int new_ncats = aggregator->categoryCount();
-  int n_new_parallel_counts = nsuper_categories * new_ncats;
+  int stride = 1;
   for (int h = headerno+1; h<parallel_aggregators.size(); ++h) {
-    n_new_parallel_counts *= parallel_aggregators[h]->categoryCount();
-  }
-  new_parallel_counts = QVector<unsigned>(n_new_parallel_counts);
-  cells.clear();
-#if !QT_NO_DEBUG
-  int debug_reverseIndexSize = reverse_index.size();
-#endif
-  if (!reverse_index.empty()) { // If there is no elements in the recap, it is possible some of the aggregators have no categories.
-    const int old_ncats = new_ncats - 1;
-    const int stride = old_parallel_counts.size()/old_ncats/nsuper_categories;
-    reverse_index.clear(); // TODO This should not be needed as we rewrite the entire reverse index
-    for (int normal_index=0; normal_index<normal_count; ++normal_index) {
-        if (normal_counts[normal_index] == 0) {
-            continue;
-        }
-      for (int super_index=0; super_index<nsuper_categories; ++super_index) {
-        for (int category_index=0; category_index<old_ncats; ++category_index) {
-          for (int sub_index=0; sub_index<stride; ++sub_index) {
-            const int old_p = super_index*stride*old_ncats + category_index*stride + sub_index;
-            if(old_parallel_counts[old_p] == 0) {
-                continue;
-            }
-            const int new_category_index = newCategoryIndex <=category_index ? category_index+1 : category_index;
-            const int p = super_index*stride*new_ncats + new_category_index*stride + sub_index;
-            new_parallel_counts[p] = old_parallel_counts[old_p];
-            const QList<int>& values = orientation == Qt::Horizontal ? old_cells.value(normal_index+ old_p*normal_count) : old_cells.value(normal_index*old_parallel_counts.size()+old_p);
-            if(!values.isEmpty()) {
-                setCell(orientation == Qt::Horizontal ? CellPoint(normal_index, p) : CellPoint(p, normal_index),
-                    values);
-                Q_FOREACH(int element,  values) {
-                    reverse_index.insert(element, orientation == Qt::Horizontal ? Cell(normal_index,p) : Cell(p, normal_index));
-                }
-            }
-          }
-        }
-      }
+    stride *= parallel_aggregators[h]->categoryCount();
+  }
+  const int new_ncats = parallel_aggregators[headerno]->categoryCount();
+  const int old_ncats = new_ncats - adjustment;
+  const int nbuckets = number_of_buckets(orientation);
+  Q_ASSERT(nsuper_categories*old_ncats*stride == nbuckets);
+  QVector<int> bucket_map(nbuckets);
+  for (int bucket=0; bucket<nbuckets; ++bucket) {
+    const int super_index = bucket / (old_ncats*stride);
+    const int category_index = (bucket / stride) % old_ncats;
+    const int sub_index = bucket % stride;
+    int new_category_index = category_index;
+    if (adjustment > 0 && category_index >= category) {
+      new_category_index += adjustment;
+    } else if (adjustment < 0 && category_index == category) {
+      bucket_map[bucket] = -1;
+      continue;
+    } else if (adjustment < 0 && category_index > category) {
+      new_category_index += adjustment;
     }
+    bucket_map[bucket] = super_index*new_ncats*stride + new_category_index*stride + sub_index;
   }
-  Q_ASSERT(debug_reverseIndexSize == reverse_index.size());
-  emit q->reset(); // TODO: It is not impossible to emit the correct row/column changed instead
+  relayout_buckets(orientation, bucket_map, nsuper_categories*new_ncats*stride);
   // we can't do a check here because a element might be added to the model and about to be registered in the datacube
 }
 
-void qdatacube::DatacubePrivate::aggregator_category_removed(qdatacube::AbstractAggregator::Ptr aggregator, int headerno, int index, Qt::Orientation orientation)
-{
-  const Datacube::Aggregators& parallel_aggregators = orientation == Qt::Horizontal ? col_aggregators : row_aggregators;
-  QVector<unsigned>& new_parallel_counts = orientation == Qt::Horizontal ? col_counts : row_counts;
-  const int normal_count = orientation == Qt::Horizontal ? row_counts.size() : col_counts.size();
-  const QVector<unsigned>& normal_counts = orientation == Qt::Horizontal ? row_counts : col_counts;
-  const QVector<unsigned> old_parallel_counts = new_parallel_counts;
-  DatacubePrivate::cells_t old_cells = cells;
-  int nsuper_categories = 1;
-  for (int h=0; h<headerno; ++h) {
-    nsuper_categories *= qMax(parallel_aggregators[h]->categoryCount(),1);
+void qdatacube::DatacubePrivate::relayout_buckets(Qt::Orientation orientation, const QVector<int>& bucket_map, int new_nbuckets) {
+  const bool horizontal = orientation == Qt::Horizontal;
+  QVector<unsigned>& parallel_counts = horizontal ? col_counts : row_counts;
+  QVector<unsigned>& normal_counts = horizontal ? row_counts : col_counts;
+  BucketIndex& parallel_index = horizontal ? col_index : row_index;
+  BucketIndex& normal_index = horizontal ? row_index : col_index;
+  const BucketOrder& parallel_order = horizontal ? col_order : row_order;
+  const BucketOrder& normal_order = horizontal ? row_order : col_order;
+  const int nbuckets = parallel_counts.size();
+  const int normal_count = normal_counts.size();
+
+  if (update_depth > 0) {
+    // The buckets recorded by the open update are renumbered here, so the update ends in a reset instead
+    announce_reset();
   }
-  const int new_ncats = aggregator->categoryCount();
-  const int old_ncats = new_ncats + 1;
-  const int stride = old_parallel_counts.size()/old_ncats/nsuper_categories;
-  Q_ASSERT(stride*nsuper_categories*old_ncats == old_parallel_counts.size());
-  new_parallel_counts = QVector<unsigned>(new_ncats * nsuper_categories * stride);
-  cells = DatacubePrivate::cells_t();
-  reverse_index.clear();
-  for (int normal_index=0; normal_index<normal_count; ++normal_index) {
-    if(normal_counts[normal_index] == 0) {
-        continue;
-    }
-    for (int super_index=0; super_index<nsuper_categories; ++super_index) {
-      for (int category_index=0; category_index<new_ncats; ++category_index) {
-        for (int sub_index=0; sub_index<stride; ++sub_index) {
-          const int old_category_index = index<=category_index ? category_index+1 : category_index;
-          const int old_p = super_index*stride*old_ncats + old_category_index*stride + sub_index;
-          if (old_parallel_counts[old_p] == 0) {
-              continue;
-          }
-          const int p = super_index*stride*new_ncats + category_index*stride + sub_index;
-          const QList<int>& value = orientation == Qt::Horizontal ? old_cells.value(normal_index+ old_p*normal_count) : old_cells.value(normal_index*old_parallel_counts.size()+old_p);
-          new_parallel_counts[p] = old_parallel_counts[old_p];
-          if(!value.isEmpty()) {
-            setCell(orientation == Qt::Horizontal ? CellPoint(normal_index, p) : CellPoint(p, normal_index), value);
-            Q_FOREACH(int element, value) {
-                reverse_index.insert(element, orientation == Qt::Horizontal ? Cell(normal_index,p) : Cell(p, normal_index));
-            }
-          }
+
+  // An element that just changed to another category can still be in a bucket that goes away, as the
+  // aggregator sees the change before we do. Such elements are dropped here, and added back by update_data()
+  QList<int> removed_sections;
+  QVector<unsigned> dropped(normal_count);
+  for (int bucket=0; bucket<nbuckets; ++bucket) {
+    if (bucket_map.at(bucket) >= 0 || parallel_counts.at(bucket) == 0) {
+      continue;
+    }
+    removed_sections << parallel_index.rank(parallel_order.toDisplay(bucket));
+    for (int normal_bucket=0; normal_bucket<normal_count; ++normal_bucket) {
+      const QList<int> elements = horizontal ? cell(normal_bucket, bucket) : cell(bucket, normal_bucket);
+      dropped[normal_bucket] += elements.size();
+      Q_FOREACH(int element, elements) {
+        Q_FOREACH(DatacubeSelection* selection, selection_models) {
+          selection->d->datacube_removes_element_from_bucket(horizontal ? normal_bucket : bucket, horizontal ? bucket : normal_bucket, element);
         }
       }
     }
   }
-  emit q->reset(); // TODO: It is not impossible to emit the correct row/column changed instead
-  // we can't do a check here because a element might be added to the model and about to be registered in the datacube
+  QList<int> removed_normal_sections;
+  for (int normal_bucket=0; normal_bucket<normal_count; ++normal_bucket) {
+    if (dropped.at(normal_bucket) > 0 && dropped.at(normal_bucket) == normal_counts.at(normal_bucket)) {
+      removed_normal_sections << normal_index.rank(normal_order.toDisplay(normal_bucket));
+    }
+  }
+  // Last section first, so each section is still right when its removal is announced
+  std::sort(removed_sections.begin(), removed_sections.end(), std::greater<int>());
+  std::sort(removed_normal_sections.begin(), removed_normal_sections.end(), std::greater<int>());
+  if (update_depth > 0) {
+    // Covered by the reset announced above
+    removed_sections.clear();
+    removed_normal_sections.clear();
+  }
+  const QList<int>& removed_rows = horizontal ? removed_normal_sections : removed_sections;
+  const QList<int>& removed_columns = horizontal ? removed_sections : removed_normal_sections;
+  Q_FOREACH(int section, removed_rows) {
+    emit q->rowsAboutToBeRemoved(section, 1);
+  }
+  Q_FOREACH(int section, removed_columns) {
+    emit q->columnsAboutToBeRemoved(section, 1);
+  }
+
+  // Move the buckets. Only the bucket numbers change, never the sections of the elements that stay
+  QVector<unsigned> new_counts(new_nbuckets);
+  bool moved = false;
+  for (int bucket=0; bucket<nbuckets; ++bucket) {
+    const int new_bucket = bucket_map.at(bucket);
+    moved |= new_bucket != bucket;
+    if (new_bucket >= 0) {
+      new_counts[new_bucket] = parallel_counts.at(bucket);
+    }
+  }
+  for (int normal_bucket=0; normal_bucket<normal_count; ++normal_bucket) {
+    if (dropped.at(normal_bucket) > 0) {
+      (horizontal ? row_headers : col_headers).invalidate();
+      normal_counts[normal_bucket] -= dropped.at(normal_bucket);
+      if (normal_counts.at(normal_bucket) == 0) {
+        normal_index.remove(normal_order.toDisplay(normal_bucket));
+      }
+    }
+  }
+  parallel_counts = new_counts;
+  // Appending buckets moves nothing, though the cell indexes still change when the number of rows does
+  const QVector<int> no_map;
+  if (horizontal) {
+    if (moved) {
+      cells.remap(normal_count, no_map, bucket_map, normal_count);
+      reverse_index.remapColumns(bucket_map);
+    }
+  } else {
+    if (moved || new_nbuckets != nbuckets) {
+      cells.remap(nbuckets, moved ? bucket_map : no_map, no_map, new_nbuckets);
+    }
+    if (moved) {
+      reverse_index.remapRows(bucket_map);
+    }
+  }
+  if (std::count(dropped.constBegin(), dropped.constEnd(), 0u) != dropped.size()) {
+    // The dropped elements leave the measures of the other direction and of the total, so compute them again
+    rebuild_measures();
+  } else {
+    // The measures, sketches and digests move along with their cells, so nothing is computed again
+    if (moved || (!horizontal && new_nbuckets != nbuckets)) {
+      const QVector<int>& row_map = horizontal ? no_map : bucket_map;
+      const QVector<int>& column_map = horizontal ? bucket_map : no_map;
+      const int nrows = horizontal ? normal_count : nbuckets;
+      const int new_nrows = horizontal ? normal_count : new_nbuckets;
+      measures.remap(nrows, row_map, column_map, new_nrows);
+      distincts.remap(nrows, row_map, column_map, new_nrows);
+      quantiles.remap(nrows, row_map, column_map, new_nrows);
+    }
+    (horizontal ? col_measures : row_measures).remap(bucket_map, new_nbuckets);
+  }
+  Q_FOREACH(DatacubeSelection* selection, selection_models) {
+    selection->d->datacube_remaps_buckets(horizontal ? no_map : bucket_map, horizontal ? bucket_map : no_map);
+  }
+  reset_bucket_index(orientation);
+
+  Q_FOREACH(int section, removed_rows) {
+    emit q->rowsRemoved(section, 1);
+  }
+  Q_FOREACH(int section, removed_columns) {
+    emit q->columnsRemoved(section, 1);
+  }
 }
 
 QList<int> qdatacube::DatacubePrivate::elements_in_bucket(int row, int column) const {
@@ -938,15 +1712,336 @@ int qdatacube::Datacube::categoryIndex(Qt::Orientation orientation, int header_i
   return bucket % (naggregator_categories*sub_header_size)/sub_header_size;
 }
 
-bool qdatacube::DatacubePrivate::filtered_in(int element) const {
-  Q_FOREACH(Datacube::Filters::value_type filter, filters) {
-    if (!(*filter)(element)) {
-      return false;
+bool qdatacube::DatacubePrivate::filtered_in(int row) const {
+  return filters.isEmpty() || filter_cache.isIncluded(element_map.id(row));
+}
+
+bool qdatacube::DatacubePrivate::run_filter(int filter, int row, bool timed) {
+  if (!timed) {
+    const bool passed = (*filters.at(filter))(row);
+    filter_order.record(filter, passed, -1);
+    return passed;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  const bool passed = (*filters.at(filter))(row);
+  filter_order.record(filter, passed, timer.nsecsElapsed());
+  return passed;
+}
+
+bool qdatacube::DatacubePrivate::evaluate_filters(int row, int element, bool unknown_only) {
+  const bool timed = filter_order.beginEvaluation();
+  const QVector<int> order = filter_order.order();
+  bool included = true;
+  for (int position = 0; position < order.size(); ++position) {
+    const int filter = order.at(position);
+    if (!included) {
+      filter_cache.setUnknown(filter, element);
+    } else if (!unknown_only || filter_cache.isUnknown(filter, element)) {
+      included = run_filter(filter, row, timed);
+      filter_cache.setRejected(filter, element, !included);
+    }
+  }
+  return included;
+}
+
+QVector<quint64> qdatacube::DatacubePrivate::rejected_elements(int filter_index, const QVector<quint64>& excluded, QVector<quint64>& unknown) {
+  const AbstractFilter& filter = *filters.at(filter_index);
+  QVector<quint64> rv((element_map.idCount() + 63) >> 6);
+  unknown = QVector<quint64>(rv.size());
+  const int nrows = model->rowCount();
+  if (filter.hasIncludedRows() && element_map.isIdentity()) {
+    // Reject all rows, then let the included rows back in
+    rv.fill(~Q_UINT64_C(0));
+    if (nrows & 63) {
+      rv[nrows >> 6] = (Q_UINT64_C(1) << (nrows & 63)) - 1;
+    }
+    Q_FOREACH(int row, filter.includedRows()) {
+      rv[row >> 6] &= ~(Q_UINT64_C(1) << (row & 63));
+    }
+    return rv;
+  }
+  const QVector<int> ids = element_map.ids();
+  if (filter.hasIncludedRows()) {
+    for (int row = 0; row < nrows; ++row) {
+      rv[ids.at(row) >> 6] |= Q_UINT64_C(1) << (ids.at(row) & 63);
+    }
+    Q_FOREACH(int row, filter.includedRows()) {
+      rv[ids.at(row) >> 6] &= ~(Q_UINT64_C(1) << (ids.at(row) & 63));
+    }
+    return rv;
+  }
+  // Blocks mostly rejected by another filter are evaluated row by row right away, the others in one go below
+  QVector<FilterBlock> batches;
+  for (int block_begin = 0; block_begin < nrows; block_begin += categorize_block) {
+    const int block_end = qMin(block_begin + categorize_block, nrows);
+    int nexcluded = 0;
+    for (int row = block_begin; row < block_end; ++row) {
+      const int id = ids.at(row);
+      if ((id >> 6) < excluded.size() && (excluded.at(id >> 6) & (Q_UINT64_C(1) << (id & 63)))) {
+        ++nexcluded;
+      }
+    }
+    if (8 * (block_end - block_begin - nexcluded) >= block_end - block_begin) {
+      // Evaluate the whole block in one go, the rows rejected by another filter too
+      FilterBlock block;
+      block.begin = block_begin;
+      block.end = block_end;
+      block.nsecs = 0;
+      batches << block;
+      continue;
+    }
+    // Most of the block is rejected by another filter anyway, so only run the filter on the rest
+    for (int row = block_begin; row < block_end; ++row) {
+      const int id = ids.at(row);
+      const quint64 bit = Q_UINT64_C(1) << (id & 63);
+      if ((id >> 6) < excluded.size() && (excluded.at(id >> 6) & bit)) {
+        unknown[id >> 6] |= bit;
+      } else if (!run_filter(filter_index, row, filter_order.beginEvaluation())) {
+        rv[id >> 6] |= bit;
+      }
+    }
+  }
+  // The blocks fill disjoint words of included, so they can be evaluated in parallel if the filter allows it
+  QVector<quint64> included((nrows + 63) >> 6);
+  const EvaluateFilterBlock evaluate_block(&filter, included.data());
+  const int nthreads = QThreadPool::globalInstance()->maxThreadCount();
+  if (nthreads > 1 && batches.size()*categorize_block >= 2*min_parallel_chunk && filter.isThreadSafe()) {
+    QtConcurrent::blockingMap(batches, evaluate_block);
+  } else {
+    for (int i = 0; i < batches.size(); ++i) {
+      evaluate_block(batches[i]);
+    }
+  }
+  Q_FOREACH(const FilterBlock& block, batches) {
+    int passes = 0;
+    for (int row = block.begin; row < block.end; ++row) {
+      const int id = ids.at(row);
+      if (included.at(row >> 6) & (Q_UINT64_C(1) << (row & 63))) {
+        ++passes;
+      } else {
+        rv[id >> 6] |= Q_UINT64_C(1) << (id & 63);
+      }
+    }
+    filter_order.record(filter_index, block.end - block.begin, passes, block.nsecs);
+  }
+  return rv;
+}
+
+bool qdatacube::DatacubePrivate::find_filter_dimension(const AbstractFilter& filter, Qt::Orientation& orientation, int& headerno, QBitArray& kept) const {
+  const FilterByAggregate* by_aggregate = qobject_cast<const FilterByAggregate*>(&filter);
+  const FilterByCategories* by_categories = qobject_cast<const FilterByCategories*>(&filter);
+  if (!by_aggregate && !by_categories) {
+    return false;
+  }
+  const AbstractAggregator::Ptr aggregator = by_aggregate ? by_aggregate->aggregator() : by_categories->aggregator();
+  headerno = row_aggregators.indexOf(aggregator);
+  orientation = Qt::Vertical;
+  if (headerno < 0) {
+    headerno = col_aggregators.indexOf(aggregator);
+    orientation = Qt::Horizontal;
+  }
+  if (headerno < 0) {
+    return false;
+  }
+  kept = QBitArray(aggregator->categoryCount());
+  if (by_aggregate) {
+    if (by_aggregate->categoryIndex() >= 0) {
+      kept.setBit(by_aggregate->categoryIndex());
+    }
+  } else {
+    Q_FOREACH(int category, by_categories->categoryIndexes()) {
+      kept.setBit(category);
     }
   }
   return true;
 }
 
+int qdatacube::DatacubePrivate::category_stride(Qt::Orientation orientation, int headerno) const {
+  const Datacube::Aggregators& aggregators = orientation == Qt::Vertical ? row_aggregators : col_aggregators;
+  int stride = 1;
+  for (int i = headerno + 1; i < aggregators.size(); ++i) {
+    stride *= aggregators.at(i)->categoryCount();
+  }
+  return stride;
+}
+
+QVector<quint64> qdatacube::DatacubePrivate::rejected_elements(int filter, Qt::Orientation orientation, int headerno, const QBitArray& kept,
+                                                               const QVector<quint64>& excluded, QVector<quint64>& unknown) {
+  if (filters.at(filter)->hasIncludedRows()) {
+    return rejected_elements(filter, QVector<quint64>(), unknown);
+  }
+  QVector<quint64> rv((element_map.idCount() + 63) >> 6);
+  unknown = QVector<quint64>(rv.size());
+  const bool horizontal = orientation == Qt::Horizontal;
+  const int stride = category_stride(orientation, headerno);
+  const int ncats = (horizontal ? col_aggregators : row_aggregators).at(headerno)->categoryCount();
+  const QVector<int> ids = element_map.ids();
+  for (int row = 0; row < ids.size(); ++row) {
+    const int id = ids.at(row);
+    const Cell cell = reverse_index.value(id);
+    bool rejected;
+    if ((id >> 6) < excluded.size() && (excluded.at(id >> 6) & (Q_UINT64_C(1) << (id & 63)))) {
+      // Rejected by another filter anyway
+      unknown[id >> 6] |= Q_UINT64_C(1) << (id & 63);
+      continue;
+    } else if (cell.invalid()) {
+      // Not covered by the datacube
+      rejected = !run_filter(filter, row, filter_order.beginEvaluation());
+    } else {
+      rejected = !kept.testBit((horizontal ? cell.column() : cell.row()) / stride % ncats);
+    }
+    if (rejected) {
+      rv[id >> 6] |= Q_UINT64_C(1) << (id & 63);
+    }
+  }
+  return rv;
+}
+
+void qdatacube::DatacubePrivate::drop_other_categories(Qt::Orientation orientation, int headerno, const QBitArray& kept, cells_t& dropped) {
+  Q_ASSERT(update_depth > 0); // the signals are sent from end_update()
+  const bool horizontal = orientation == Qt::Horizontal;
+  const int stride = category_stride(orientation, headerno);
+  const int ncats = (horizontal ? col_aggregators : row_aggregators).at(headerno)->categoryCount();
+  const long nrows = row_counts.size();
+  // Find the cells first, as they cannot be emptied while iterating over them
+  QList<long> dropped_keys;
+  for (cells_t::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+    const int bucket = horizontal ? it.key() / nrows : it.key() % nrows;
+    if (!kept.testBit(bucket / stride % ncats)) {
+      dropped_keys << it.key();
+    }
+  }
+  if (dropped_keys.isEmpty()) {
+    return;
+  }
+  Q_FOREACH(long cell, dropped_keys) {
+    const int row_bucket = cell % nrows;
+    const int column_bucket = cell / nrows;
+    const QList<int> elements = cells.elements(cell);
+    if (row_counts.at(row_bucket) == unsigned(elements.size()) || col_counts.at(column_bucket) == unsigned(elements.size())) {
+      // The row or column goes with the cell
+      announce_reset();
+    }
+    dropped.set(cell, elements);
+    cells.set(cell, QList<int>());
+    reverse_index.remove(elements);
+    Q_FOREACH(DatacubeSelection* selection, selection_models) {
+      selection->d->datacube_empties_bucket(row_bucket, column_bucket);
+    }
+    if ((row_counts[row_bucket] -= elements.size()) == 0) {
+      set_bucket_non_empty(Qt::Vertical, row_bucket, false);
+    }
+    if ((col_counts[column_bucket] -= elements.size()) == 0) {
+      set_bucket_non_empty(Qt::Horizontal, column_bucket, false);
+    }
+    distincts.remove(cell, row_bucket, column_bucket);
+    quantiles.remove(cell, row_bucket, column_bucket);
+    if (!measures.isEmpty()) {
+      // The buckets are summed up again from the cells left when next asked for
+      measures.erase(cell);
+      row_measures.markStale(row_bucket);
+      col_measures.markStale(column_bucket);
+    }
+    changed_cells << cell;
+  }
+  if (!measures.isEmpty()) {
+    total_measures.markStale(0);
+  }
+  // The counts of the header sections left are not patched, so build them again
+  row_headers.invalidate();
+  col_headers.invalidate();
+}
+
+QList<int> qdatacube::DatacubePrivate::restore_cells(cells_t& dropped, const QList<int>& ids) {
+  Q_ASSERT(update_depth > 0); // the signals are sent from end_update()
+  if (dropped.count() == 0) {
+    return ids;
+  }
+  QBitArray back(element_map.idCount());
+  Q_FOREACH(int id, ids) {
+    back.setBit(id);
+  }
+  const long nrows = row_counts.size();
+  for (cells_t::const_iterator it = dropped.constBegin(), iend = dropped.constEnd(); it != iend; ++it) {
+    // Elements rejected by a filter added since stay out
+    QList<int> elements;
+    for (const int* element = it.begin(), *end = it.end(); element != end; ++element) {
+      if (back.testBit(*element)) {
+        back.clearBit(*element);
+        elements << *element;
+      }
+    }
+    if (elements.isEmpty()) {
+      continue;
+    }
+    const long cell = it.key();
+    const int row_bucket = cell % nrows;
+    const int column_bucket = cell / nrows;
+    Q_ASSERT(!cells.contains(cell));
+    cells.set(cell, elements);
+    reverse_index.insert(elements, Cell(row_bucket, column_bucket));
+    Q_FOREACH(DatacubeSelection* selection, selection_models) {
+      selection->d->datacube_adds_elements_to_bucket(row_bucket, column_bucket, elements);
+    }
+    if ((row_counts[row_bucket] += elements.size()) == unsigned(elements.size())) {
+      set_bucket_non_empty(Qt::Vertical, row_bucket, true);
+    }
+    if ((col_counts[column_bucket] += elements.size()) == unsigned(elements.size())) {
+      set_bucket_non_empty(Qt::Horizontal, column_bucket, true);
+    }
+    distincts.remove(cell, row_bucket, column_bucket);
+    quantiles.remove(cell, row_bucket, column_bucket);
+    if (!measures.isEmpty()) {
+      Q_FOREACH(int element, elements) {
+        measures.add(cell, element);
+      }
+      const Measure* cell_measures = measures.find(cell);
+      row_measures.add(row_bucket, cell_measures);
+      col_measures.add(column_bucket, cell_measures);
+      total_measures.add(0, cell_measures);
+    }
+    changed_cells << cell;
+  }
+  dropped.clear();
+  row_headers.invalidate();
+  col_headers.invalidate();
+  QList<int> rv;
+  Q_FOREACH(int id, ids) {
+    if (back.testBit(id)) {
+      rv << id;
+    }
+  }
+  return rv;
+}
+
+void qdatacube::DatacubePrivate::forget_dropped_cells() {
+  for (int filter = 0; filter < dropped_cells.size(); ++filter) {
+    if (dropped_cells.at(filter).count() > 0) {
+      dropped_cells[filter] = cells_t();
+    }
+  }
+}
+
+void qdatacube::DatacubePrivate::reset_filter_cache() {
+  filter_cache.reset(element_map.idCount());
+  // Cheapest and most decisive first, each filter skipping the elements those before it rejected
+  QVector<QVector<quint64> > rejected(filters.size());
+  QVector<QVector<quint64> > unknown(filters.size());
+  QVector<quint64> excluded((element_map.idCount() + 63) >> 6);
+  const QVector<int> order = filter_order.order();
+  for (int position = 0; position < order.size(); ++position) {
+    const int filter = order.at(position);
+    rejected[filter] = rejected_elements(filter, excluded, unknown[filter]);
+    for (int word = 0; word < excluded.size(); ++word) {
+      excluded[word] |= rejected.at(filter).at(word);
+    }
+  }
+  for (int filter = 0; filter < filters.size(); ++filter) {
+    filter_cache.appendFilter(rejected.at(filter), unknown.at(filter));
+  }
+}
+
 qdatacube::Datacube::Aggregators qdatacube::Datacube::columnAggregators() const
 {
   return d->col_aggregators;
@@ -959,139 +2054,159 @@ qdatacube::Datacube::Aggregators qdatacube::Datacube::rowAggregators() const
 
 int qdatacube::Datacube::elementCount(Qt::Orientation orientation, int headerno, int header_section) const
 {
-  Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
-  const QVector<unsigned>& counts = (orientation == Qt::Horizontal) ? d->col_counts : d->row_counts;
-  int count = 0;
-  int stride = 1;
-  for (int i=headerno+1; i<aggregators.size(); ++i) {
-    stride *= aggregators.at(i)->categoryCount();
+  const HeaderIndex& header_index = d->header_index(orientation, headerno);
+  Q_ASSERT_X(header_section < header_index.count(headerno), "QDatacube", QString("Section %1 at header %2 orientation %3 too big for qdatacube").arg(header_section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
+  return header_index.elementCount(headerno, header_section);
+}
+
+QList<int> qdatacube::Datacube::elements(Qt::Orientation orientation, int headerno, int header_section) const
+{
+  return elementRange(orientation, headerno, header_section).toList();
+
+}
+
+qdatacube::ElementRange qdatacube::Datacube::elementRange(Qt::Orientation orientation, int headerno, int header_section) const
+{
+  const HeaderIndex& header_index = d->header_index(orientation, headerno);
+  ElementRange rv = d->element_range();
+  rv.d->size = header_index.elementCount(headerno, header_section);
+  rv.d->totals = header_index.measures(headerno, header_section);
+  // The cells are looked up only if the elements are read
+  rv.d->source = d.data();
+  rv.d->horizontal = orientation == Qt::Horizontal;
+  rv.d->display_bucket_count = header_index.stride(headerno);
+  rv.d->first_display_bucket = header_index.group(headerno, header_section) * rv.d->display_bucket_count;
+  return rv;
+}
+
+int qdatacube::Datacube::toHeaderSection(const Qt::Orientation orientation, const int headerno, const int section) const
+{
+  const int header_section = d->header_index(orientation, headerno).headerSection(headerno, section);
+  Q_ASSERT_X(header_section >= 0, "QDatacube", QString("Section %1 in datacube orientation %3 too big for qdatacube").arg(section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
+  return header_section;
+}
+
+QPair< int, int > qdatacube::Datacube::toSection(Qt::Orientation orientation, const int headerno, const int header_section) const
+{
+  const HeaderIndex& header_index = d->header_index(orientation, headerno);
+  Q_ASSERT_X(header_section < header_index.count(headerno), "QDatacube", QString("Section %1 in header %2 orientation %3 too big for qdatacube").arg(header_section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
+  const int section = header_index.firstSection(headerno, header_section);
+  return QPair<int,int>(section,section+header_index.span(headerno, header_section)-1);
+}
+
+int qdatacube::Datacube::elementCount() const
+{
+  return d->reverse_index.size();
+}
+
+QList< int > qdatacube::Datacube::elements() const
+{
+  if (d->element_map.isIdentity()) {
+    return d->reverse_index.elements();
   }
-  int offset = 0;
-  for (int section_index = 0; section_index <= header_section; section_index += (count>0) ? 1 : 0) {
-    Q_ASSERT_X(offset < counts.size(), "QDatacube", QString("Section %1 at header %2 orientation %3 too big for qdatacube").arg(header_section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
-    count = 0;
-    for (int i=0; i<stride; ++i) {
-      count += counts.at(offset+i);
+  // Walk the rows rather than the ids, so the elements still come out in ascending order
+  QList<int> rv;
+  rv.reserve(d->reverse_index.size());
+  const QVector<int> ids = d->element_map.ids();
+  for (int row = 0; row < ids.size(); ++row) {
+    if (d->reverse_index.contains(ids.at(row))) {
+      rv << row;
     }
-    offset += stride;
   }
-  return count;
+  return rv;
 }
 
-QList<int> qdatacube::Datacube::elements(Qt::Orientation orientation, int headerno, int header_section) const
+void qdatacube::Datacube::addMeasure(int column)
 {
-  Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
-  const QVector<unsigned>& counts = (orientation == Qt::Horizontal) ? d->col_counts : d->row_counts;
-  int stride = 1;
-  for (int i=headerno+1; i<aggregators.size(); ++i) {
-    stride *= aggregators.at(i)->categoryCount();
+  Q_ASSERT(column >= 0 && column < d->model->columnCount());
+  if (d->measures.indexOf(column) >= 0) {
+    return;
   }
-  // Skip forward to section
-  int bucket = 0;
-  int section = 0;
-  for (int hs=0; bucket<counts.size() && hs < header_section; bucket+=stride) {
-    int old_section = section;
-    for (int i=0;i<stride; ++i) {
-      if (counts.at(bucket+i)>0) {
-        ++section;
-      }
-    }
-    if (section>old_section) {
-      ++hs;
-    }
+  d->measures.addColumn(column);
+  d->read_values();
+  d->rebuild_measures();
+}
+
+void qdatacube::Datacube::removeMeasure(int column)
+{
+  const int measure = d->measures.indexOf(column);
+  if (measure >= 0) {
+    d->measures.removeColumn(measure);
+    d->rebuild_measures();
   }
+}
 
-  // Accumulate answer
+QList< int > qdatacube::Datacube::measures() const
+{
   QList<int> rv;
-  const int normal_count = (orientation == Qt::Horizontal) ? d->row_counts.size() : d->col_counts.size();
-  for (; bucket<counts.size() && rv.isEmpty(); bucket+=stride) {
-    for (int i=0;i<stride && (bucket+i)<counts.size(); ++i) {
-      if (counts.at(bucket+i)>0) {
-        for (int n=0; n<normal_count; ++n) {
-          rv << ((orientation == Qt::Horizontal) ? d->cell(n,bucket+i) : d->cell(bucket+i,n));
-        }
-      }
-    }
+  for (int measure = 0; measure < d->measures.count(); ++measure) {
+    rv << d->measures.column(measure);
   }
   return rv;
-
 }
 
-int qdatacube::Datacube::toHeaderSection(const Qt::Orientation orientation, const int headerno, const int section) const
+void qdatacube::Datacube::addDistinctCount(int column)
 {
-//   qDebug() << __func__ << headerno << section << row_count() << column_count();
-  Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
-  const QVector<unsigned>& counts = (orientation == Qt::Horizontal) ? d->col_counts : d->row_counts;
-  int stride = 1;
-  for (int i=headerno+1; i<aggregators.size(); ++i) {
-    stride *= aggregators.at(i)->categoryCount();
+  Q_ASSERT(column >= 0 && column < d->model->columnCount());
+  if (d->distincts.indexOf(column) >= 0) {
+    return;
   }
-  // Skip forward to section
-  int bucket = 0;
-  int s = 0;
-  int header_section = 0;
-  for (; bucket<counts.size(); bucket+=stride) {
-    int old_section = s;
-    for (int i=0;i<stride; ++i) {
-//       qDebug() << __func__ << bucket << s << header_section << stride << counts.at(bucket+i) << counts.size();
-      if (counts.at(bucket+i)>0) {
-        if (s++==section) {
-          return header_section;
-        }
-      }
-    }
-    if (s>old_section) {
-      ++header_section;
-    }
+  d->distincts.addColumn(column);
+  d->read_values();
+}
+
+void qdatacube::Datacube::removeDistinctCount(int column)
+{
+  const int distinct = d->distincts.indexOf(column);
+  if (distinct >= 0) {
+    d->distincts.removeColumn(distinct);
   }
-  Q_ASSERT_X(bucket<counts.size(), "QDatacube", QString("Section %1 in datacube orientation %3 too big for qdatacube").arg(section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
-  return header_section;
 }
 
-QPair< int, int > qdatacube::Datacube::toSection(Qt::Orientation orientation, const int headerno, const int header_section) const
+QList< int > qdatacube::Datacube::distinctCounts() const
 {
-  Aggregators& aggregators = (orientation == Qt::Horizontal) ? d->col_aggregators : d->row_aggregators;
-  const QVector<unsigned>& counts = (orientation == Qt::Horizontal) ? d->col_counts : d->row_counts;
-  int stride = 1;
-  for (int i=headerno+1; i<aggregators.size(); ++i) {
-    stride *= aggregators.at(i)->categoryCount();
+  QList<int> rv;
+  for (int distinct = 0; distinct < d->distincts.count(); ++distinct) {
+    rv << d->distincts.column(distinct);
   }
-  // Skip forward to section
-  int bucket = 0;
-  int section = 0;
-  for (int hs=0; bucket<counts.size() && hs < header_section; bucket+=stride) {
-    int old_section = section;
-    for (int i=0;i<stride; ++i) {
-      if (counts.at(bucket+i)>0) {
-        ++section;
-      }
-    }
-    if (section>old_section) {
-      ++hs;
-    }
+  return rv;
+}
+
+void qdatacube::Datacube::addQuantiles(int column)
+{
+  Q_ASSERT(column >= 0 && column < d->model->columnCount());
+  if (d->quantiles.indexOf(column) >= 0) {
+    return;
   }
+  d->quantiles.addColumn(column);
+  d->read_values();
+}
 
-  // count number of (active) sections
-  int count = 0;
-  for (; bucket<counts.size() && count == 0; bucket+=stride) {
-    for (int i=0;i<stride && (bucket+i)<counts.size(); ++i) {
-      if (counts.at(bucket+i)>0) {
-        ++count;
-      }
-    }
+void qdatacube::Datacube::removeQuantiles(int column)
+{
+  const int quantile = d->quantiles.indexOf(column);
+  if (quantile >= 0) {
+    d->quantiles.removeColumn(quantile);
   }
-  Q_ASSERT_X(count > 0, "QDatacube", QString("Section %1 in header %2 orientation %3 too big for qdatacube").arg(header_section).arg(headerno).arg(orientation == Qt::Horizontal ? "Horizontal" : "Vertical").toLocal8Bit().data());
-  return QPair<int,int>(section,section+count-1);
 }
 
-int qdatacube::Datacube::elementCount() const
+QList< int > qdatacube::Datacube::quantiles() const
 {
-  return d->reverse_index.count();
+  QList<int> rv;
+  for (int quantile = 0; quantile < d->quantiles.count(); ++quantile) {
+    rv << d->quantiles.column(quantile);
+  }
+  return rv;
 }
 
-QList< int > qdatacube::Datacube::elements() const
+qdatacube::ElementRange qdatacube::Datacube::elementRange() const
 {
-  return d->reverse_index.keys();
+  ElementRange rv = d->element_range();
+  rv.d->size = elementCount();
+  rv.d->totals = d->totals();
+  rv.d->source = d.data();
+  rv.d->display_bucket_count = -1;
+  return rv;
 }
 
 #include "datacube.moc"
@@ -4,6 +4,8 @@
 #include "qdatacube_export.h"
 #include "abstractaggregator.h"
 #include "abstractfilter.h"
+#include "elementrange.h"
+#include "filterstatistics.h"
 
 #include <QObject>
 #include <QPair>
@@ -109,6 +111,11 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         QList<int> elements(int row, int column) const;
 
+        /**
+         * @returns The elements in the given row, column, read in place. The range is valid until the datacube changes
+         */
+        ElementRange elementRange(int row, int column) const;
+
         /**
          * @return number of elements corresponding to header section
          * equivalent (but much faster) to elements(direction, headerno, section).size()
@@ -126,6 +133,11 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         QList< int > elements(Qt::Orientation orientation, int headerno, int header_section) const;
 
+        /**
+         * @return elements corresponding to header section, read in place as elementRange(row, column)
+         */
+        ElementRange elementRange(Qt::Orientation orientation, int headerno, int header_section) const;
+
         /**
          * @return the total number of (non-filtered) elements
          */
@@ -136,6 +148,11 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         QList<int> elements() const;
 
+        /**
+         * @return all non-filtered elements, read in place as elementRange(row, column)
+         */
+        ElementRange elementRange() const;
+
         /**
          * @returns the category index
          */
@@ -147,7 +164,24 @@ class QDATACUBE_EXPORT Datacube : public QObject {
         void addFilter(AbstractFilter::Ptr filter);
 
         /**
-         * Remove all filters
+         * Start a batch of changes. Until the matching endUpdate(), the signals for rows, columns and cells
+         * inserted or changed are held back. At the end they are sent as ranges of inserted sections and each
+         * changed cell once. A change removing a row or a column, or changing the layout of the buckets (e.g., by
+         * split() or a new category in an aggregator), is preceded by aboutToBeReset(), sent while the datacube
+         * still has the sections and elements about to go, and the update then ends in a single reset().
+         *
+         * Calls nest, and only the outermost endUpdate() sends signals. Each change signalled by the underlying
+         * model is a batch by itself, so e.g. a block of inserted rows gives one set of signals.
+         */
+        void beginUpdate();
+
+        /**
+         * End a batch of changes started by beginUpdate()
+         */
+        void endUpdate();
+
+        /**
+         * Remove all filters. The datacube is rebuilt in one go, emitting aboutToBeReset() and reset()
          */
         void resetFilter();
 
@@ -157,6 +191,14 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         bool removeFilter(AbstractFilter::Ptr filter);
 
+        /**
+         * Replace old_filter by new_filter in one go, e.g. as a filter parameter changes in a user interface.
+         * Only the rows whose inclusion changes are removed from or added to the datacube, in a single update
+         * (see beginUpdate()), and filterChanged() is emitted once. new_filter may be old_filter, after it changed.
+         * \return true if old_filter was found and replaced, and false if not found
+         */
+        bool replaceFilter(AbstractFilter::Ptr old_filter, AbstractFilter::Ptr new_filter);
+
         /**
          * Split header with aggregator.
          * @param orientation split by column or row
@@ -188,6 +230,61 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         int internalSection(int element, Qt::Orientation orientation) const;
 
+        /**
+         * Keep the measure (count, sum, sum of squares, min and max) of column of the underlying model
+         * for each cell, updated as elements come and go. Element ranges then give the measure of a cell in
+         * O(1) and of a header section in O(cells) through ElementRange::measure(), which the column formatters use.
+         * The values must be convertible to double.
+         */
+        void addMeasure(int column);
+
+        /**
+         * Stop keeping the measure of column
+         */
+        void removeMeasure(int column);
+
+        /**
+         * @return the columns of the underlying model measured, see addMeasure()
+         */
+        QList<int> measures() const;
+
+        /**
+         * Keep HyperLogLog sketches of the values of column of the underlying model for each cell, compared as
+         * strings, so the number of distinct values in cells, header sections and all elements can be estimated
+         * without a set of the values. Sketches are made as needed and merged for header sections and totals,
+         * see ElementRange::distinctSketch() and DistinctCountFormatter. Small cells are counted exactly.
+         */
+        void addDistinctCount(int column);
+
+        /**
+         * Stop keeping sketches of column
+         */
+        void removeDistinctCount(int column);
+
+        /**
+         * @return the columns of the underlying model counted, see addDistinctCount()
+         */
+        QList<int> distinctCounts() const;
+
+        /**
+         * Keep t-digests of the values of column of the underlying model for each cell, so quantiles such as the
+         * median of cells, header sections and all elements can be estimated without sorting the values.
+         * Digests are made as needed and merged for header sections and totals, and take bounded memory
+         * however big the cells are, see ElementRange::quantileDigest() and QuantileFormatter.
+         * Small cells are kept exactly.
+         */
+        void addQuantiles(int column);
+
+        /**
+         * Stop keeping digests of column
+         */
+        void removeQuantiles(int column);
+
+        /**
+         * @return the columns of the underlying model with quantiles, see addQuantiles()
+         */
+        QList<int> quantiles() const;
+
         typedef QList< AbstractFilter::Ptr > Filters;
         typedef QList< AbstractAggregator::Ptr > Aggregators;
 
@@ -196,6 +293,12 @@ class QDATACUBE_EXPORT Datacube : public QObject {
          */
         Filters filters() const;
 
+        /**
+         * @return statistics of the filters, in the order of filters(). The filters are run cheapest and most
+         * decisive first as learned from these, skipping the rest for a row once one rejects it
+         */
+        QList<FilterStatistics> filterStatistics() const;
+
         /**
          * @return list of column aggregators, in order
          */
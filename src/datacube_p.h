@@ -1,15 +1,32 @@
 #ifndef QDATACUBE_DATACUBE_P_H
 #define QDATACUBE_DATACUBE_P_H
 
+#include <QBitArray>
+#include <QHash>
 #include <QObject>
+#include <QPair>
+#include <QSet>
 #include <QSharedPointer>
 
+#include "bucketindex.h"
+#include "bucketorder.h"
 #include "cell.h"
+#include "cellstore.h"
 #include "datacube.h"
+#include "distinctstore.h"
+#include "elementmap.h"
+#include "filtercache.h"
+#include "filterorder.h"
+#include "headerindex.h"
+#include "measurestore.h"
+#include "quantilestore.h"
+#include "measuretotals.h"
+#include "reverseindex.h"
 
 class QAbstractItemModel;
 namespace qdatacube {
 class DatacubeSelection;
+class ElementRangePrivate;
 }
 
 namespace qdatacube {
@@ -35,7 +52,13 @@ class DatacubePrivate : public QObject {
             return computeBucketForIndex(Qt::Horizontal, index);
         }
         int computeBucketForIndex(Qt::Orientation orientation, int index);
-        const QList<int>& cell(long int bucket_row, long int bucket_column) const;
+        /**
+         * Compute buckets for elements from begin to end (exclusive) into buckets, using the batch
+         * AbstractAggregator::categorize()
+         */
+        void compute_buckets(Qt::Orientation orientation, int begin, int end, int* buckets) const;
+        QList<int> cell(long int bucket_row, long int bucket_column) const;
+        int cellSize(long int bucket_row, long int bucket_column) const;
         int hasCell(long int bucket_row, long int bucket_column) const;
         void setCell(long int bucket_row, long int bucket_column, const QList< int >& cell_content);
         void setCell(qdatacube::CellPoint point, const QList< int >& cell_content);
@@ -43,10 +66,6 @@ class DatacubePrivate : public QObject {
         void cellAppend(CellPoint point, QList<int> listadd);
         int bucket_to_row(int bucket_row) const;
         int bucket_to_column(int bucket_column) const;
-        /**
-        * Renumber cells from start by adding adjustment
-        */
-        void renumber_cells(int start, int adjustment);
         bool cellRemoveOne(long int row, long int column, int index);
 
         const QAbstractItemModel* model;
@@ -55,18 +74,187 @@ class DatacubePrivate : public QObject {
         Datacube::Aggregators col_aggregators;
         QVector<unsigned> row_counts; // list counting number of items in each row indexed by bucket number
         QVector<unsigned> col_counts;
+        BucketOrder row_order; // maps between buckets and display buckets
+        BucketOrder col_order;
+        BucketIndex row_index; // non-empty display buckets, maps between display buckets and sections
+        BucketIndex col_index;
+        HeaderIndex row_headers; // header sections of each row header level, built on demand by header_index()
+        HeaderIndex col_headers;
         Datacube::Filters filters;
-        typedef QHash<long, QList<int> > cells_t;
-        cells_t cells; // maps from cell index (computed from bucket coordinates) to lists of indexes in underlying model
-        typedef QHash<int, Cell> reverse_index_t;
-        reverse_index_t reverse_index; // maps from underlying model index to coordinates in datacube (in buckets)
+        FilterCache filter_cache; // what each filter rejects, indexed by element id, in the order of filters
+        FilterOrder filter_order; // evaluation order and statistics of filters
+        typedef CellStore cells_t;
+        cells_t cells; // maps from cell index (computed from bucket coordinates) to element ids
+        // Per filter in the order of filters, the cells a filter on a header of the datacube dropped, to be put back as
+        // they were when it is removed. Empty for other filters, and once the buckets or the elements may have changed
+        QList<cells_t> dropped_cells;
+        typedef ReverseIndex reverse_index_t;
+        reverse_index_t reverse_index; // maps from element id to coordinates in datacube (in buckets)
+        ElementMap element_map; // maps between rows in the underlying model and element ids
+        MeasureStore measures; // values and per cell measures of the columns given to Datacube::addMeasure()
+        MeasureTotals row_measures; // measures of each row bucket
+        MeasureTotals col_measures;
+        MeasureTotals total_measures; // measures of all elements, as a single group
+        DistinctStore distincts; // hashes and sketches of the columns given to Datacube::addDistinctCount()
+        QuantileStore quantiles; // values and digests of the columns given to Datacube::addQuantiles()
+        int update_depth; // nesting of begin_update()
+        bool update_needs_reset; // aboutToBeReset() was sent in the open update, which has to end in a reset
+        QHash<int, bool> row_was_non_empty; // display bucket -> non-empty when the update began, for rows toggled since
+        QHash<int, bool> column_was_non_empty;
+        QSet<long> changed_cells; // cell indexes of the cells changed in the open update
+        QSet<int> changed_row_buckets; // buckets of rows changed as a whole (headers included) in the open update
+        QSet<int> changed_column_buckets;
+
+        /**
+         * Open an update, holding back the signals for changes until the outermost end_update().
+         * add() and remove() must be called inside one.
+         */
+        void begin_update();
+
+        /**
+         * Close an update. The outermost one sends the signals for what changed, see Datacube::beginUpdate()
+         */
+        void end_update();
+
+        /**
+         * Mark bucket in orientation as non-empty or empty, remembering its state for the open update
+         */
+        void set_bucket_non_empty(Qt::Orientation orientation, int bucket, bool non_empty);
+
+        /**
+         * @return the sections in orientation inserted in the open update, as ranges of (first, count) numbered
+         * as after the update
+         */
+        QList<QPair<int, int> > inserted_sections(Qt::Orientation orientation, const QHash<int, bool>& was_non_empty) const;
+
+        /**
+         * Emit aboutToBeReset(), or announce_reset() if in an update
+         */
+        void begin_reset();
+
+        /**
+         * In an update, emit aboutToBeReset() unless sent already, and make the update end in a reset(). Called
+         * before the first change removing a section or renumbering the buckets, while the old state is still in place
+         */
+        void announce_reset();
+
+        /**
+         * Emit reset(), or make the open update end in one
+         */
+        void end_reset();
+
+        void remove(int row);
+        void add(int row);
+        /**
+         * Add row with already computed buckets
+         */
+        void add(int row, int row_bucket, int column_bucket);
+
+        /**
+         * @return true if columns are measured, counted or have quantiles, so elements have values to read
+         */
+        bool has_values() const {
+            return !measures.isEmpty() || !distincts.isEmpty() || !quantiles.isEmpty();
+        }
+
+        /**
+         * Read the values of the measured, counted and quantile columns for row, with element id element
+         */
+        void read_values(int row, int element);
+
+        /**
+         * Read the values of the measured, counted and quantile columns for all rows
+         */
+        void read_values();
+
+        /**
+         * Add the values of element, already read, to the measures, sketches and digests of cell and of everything rolled up from it
+         */
+        void add_values(long cell, int bucket_row, int bucket_column, int element);
+
+        /**
+         * Remove the values of element from the measures, sketches and digests of cell and of everything rolled up from it
+         */
+        void remove_values(long cell, int bucket_row, int bucket_column, int element);
+
+        /**
+         * Recompute all measures from the cells, and forget the measures of the header sections and all sketches and digests
+         */
+        void rebuild_measures();
+
+        /**
+         * Recompute the bucket measures of orientation with stale min and max from the measures of their cells
+         */
+        void refresh_measures(Qt::Orientation orientation);
+
+        /**
+         * @return measures of all elements, or 0 if there are no measures
+         */
+        const Measure* totals();
+
+        /**
+         * @return sketch of the elements of range for distinct
+         */
+        HyperLogLog distinct_sketch(const ElementRangePrivate& range, int distinct);
+
+        /**
+         * @return digest of the elements of range for quantile
+         */
+        TDigest quantile_digest(const ElementRangePrivate& range, int quantile);
+
+        /**
+         * @return empty element range for this datacube
+         */
+        ElementRange element_range();
+
+        /**
+         * Add the segments of the elements range is for to it, see ElementRangePrivate::fill()
+         */
+        void fill_range(const ElementRangePrivate& range) const;
+
+        /**
+         * @return rows in the underlying model for element ids
+         */
+        QList<int> to_rows(const QList<int>& elements) const;
+
+        /**
+         * @return the category of each element id in aggregator, or -1 for ids not in use
+         */
+        QVector<int> categorize_elements(const AbstractAggregator* aggregator) const;
+
+        /**
+        * Recompute cells, counts and the reverse index for all elements in the model in one pass.
+        * No signals are emitted, so listeners must be told by a reset (if there are any)
+        */
+        void rebuild();
+
+        /**
+        * Compute the cell index (bucket_row + bucket_column*number_of_row_buckets) of rows from begin
+        * to end (exclusive) into cell_for_element, which is indexed by row. Filtered out rows get -1.
+        * Only reads the datacube, so it can run concurrently on disjoint ranges if
+        * parallel_build_possible() is true.
+        */
+        void compute_cells(int begin, int end, long* cell_for_element);
 
-        void remove(int index);
-        void add(int index);
+        /**
+        * @return true if all aggregators are thread safe, so the buckets can be computed in parallel.
+        * The filters are not run by compute_cells(), which reads filter_cache
+        */
+        bool parallel_build_possible() const;
         void split_row(int headerno, AbstractAggregator::Ptr aggregator);
         void split_column(int headerno, AbstractAggregator::Ptr aggregator);
-        void aggregator_category_added(AbstractAggregator::Ptr aggregator, int headerno, int index, Qt::Orientation orientation);
-        void aggregator_category_removed(AbstractAggregator::Ptr aggregator, int headerno, int index, Qt::Orientation orientation);
+        /**
+        * Lay out the buckets of orientation after the aggregator at headerno got a category inserted (adjustment 1)
+        * or removed (adjustment -1) at category
+        */
+        void relayout_category(Qt::Orientation orientation, int headerno, int category, int adjustment);
+
+        /**
+        * Move the buckets of orientation to new_nbuckets new buckets, bucket_map giving the new bucket for each
+        * old bucket or -1 if it goes away. Only bucket numbers and cell indexes are changed, not the sections,
+        * except for elements left in buckets that go away, which are dropped with the sections they leave empty.
+        */
+        void relayout_buckets(Qt::Orientation orientation, const QVector<int>& bucket_map, int new_nbuckets);
 
         /**
         * @returns the number of buckets (i.e. sections including empty sections) in datacube for
@@ -75,7 +263,7 @@ class DatacubePrivate : public QObject {
         int number_of_buckets(Qt::Orientation orientation) const;
 
         /**
-        * @return elements for bucket row, bucket column
+        * @return element ids for bucket row, bucket column
         */
         QList<int> elements_in_bucket(int row, int column) const;
 
@@ -101,7 +289,7 @@ class DatacubePrivate : public QObject {
 
         /**
         * find cell_t with bucket for element
-        * @param element element to look for
+        * @param element element id to look for
         * @param result the cell with the element, or an invalid cell
         * The strange interface is to avoid exporting cell_t
         */
@@ -113,9 +301,103 @@ class DatacubePrivate : public QObject {
         void add_selection_model(DatacubeSelection* selection);
 
         /**
+        * @returns true if included by the current set of filters, as cached in filter_cache
+        */
+        bool filtered_in(int row) const;
+
+        /**
+        * Run the filter with index filter on row, recording the result in filter_order, and its time if timed
+        * @returns true if the filter includes row
+        */
+        bool run_filter(int filter, int row, bool timed);
+
+        /**
+        * Run the filters on row, with element id element, in the order of filter_order, and cache the results.
+        * The filters after the first rejecting one are not run, and their results are cached as unknown.
+        * @param unknown_only only run the filters with unknown results, the others being known to pass
         * @returns true if included by the current set of filters
         */
-        bool filtered_in(int element) const;
+        bool evaluate_filters(int row, int element, bool unknown_only = false);
+
+        /**
+        * @return bitset of the element ids the filter with index filter rejects, in 64 bit words. Read from the
+        * included rows of filter if it has them, see AbstractFilter::hasIncludedRows(). Otherwise the filter is evaluated
+        * in batches, see AbstractFilter::evaluate(), except in batches mostly rejected already, where it is run for each
+        * row but those with the ids set in excluded, which are set in unknown instead
+        */
+        QVector<quint64> rejected_elements(int filter, const QVector<quint64>& excluded, QVector<quint64>& unknown);
+
+        /**
+        * Find the header filter splits the datacube by, which is the case for a FilterByAggregate or a
+        * FilterByCategories on one of the aggregators of the datacube.
+        * @return true if found, with its orientation, headerno and the categories filter keeps, indexed by category
+        */
+        bool find_filter_dimension(const AbstractFilter& filter, Qt::Orientation& orientation, int& headerno, QBitArray& kept) const;
+
+        /**
+        * @return number of buckets of orientation in a row with the same category of the aggregator at headerno,
+        * so the category of a bucket is bucket / stride % categoryCount()
+        */
+        int category_stride(Qt::Orientation orientation, int headerno) const;
+
+        /**
+        * As rejected_elements(int, const QVector<quint64>&, QVector<quint64>&) for a filter keeping only the kept categories
+        * of the aggregator at headerno of orientation. Elements in the datacube are decided by their bucket, so only those
+        * not covered by it are filtered
+        */
+        QVector<quint64> rejected_elements(int filter, Qt::Orientation orientation, int headerno, const QBitArray& kept,
+                                           const QVector<quint64>& excluded, QVector<quint64>& unknown);
+
+        /**
+        * Drop all elements in buckets of orientation with a category of the aggregator at headerno not in kept,
+        * a cell at a time instead of an element at a time, and add the cells dropped to dropped.
+        * Must be called inside an update.
+        */
+        void drop_other_categories(Qt::Orientation orientation, int headerno, const QBitArray& kept, cells_t& dropped);
+
+        /**
+        * Put the elements of ids back in the cells they were dropped from, see drop_other_categories(), a cell at a time,
+        * and clear dropped. Must be called inside an update.
+        * @return the elements of ids not in dropped, which are still to be added
+        */
+        QList<int> restore_cells(cells_t& dropped, const QList<int>& ids);
+
+        /**
+        * Forget the cells dropped by filters on headers, as the buckets or the elements in them may have changed
+        */
+        void forget_dropped_cells();
+
+        /**
+        * Add rows, categorizing them in one batch if they are dense enough in the model.
+        * Must be called inside an update.
+        */
+        void add_rows(QList<int> rows);
+
+        /**
+        * Run all filters on all rows in the order of filter_order, and cache the results
+        */
+        void reset_filter_cache();
+
+        /**
+        * @return the header index of orientation, with level built
+        */
+        const HeaderIndex& header_index(Qt::Orientation orientation, int level);
+
+        /**
+        * Rebuild the bucket orders and indexes after row_counts or col_counts have been replaced
+        */
+        void reset_bucket_indexes();
+
+        /**
+        * Rebuild the bucket order and index of orientation from the aggregators and counts, and reset the header index
+        */
+        void reset_bucket_index(Qt::Orientation orientation);
+
+        /**
+        * (Re)connect to the signals of the model. Aggregators update their state from the same signals,
+        * so this is redone whenever an aggregator or filter is added, to let their slots run first.
+        */
+        void connect_model();
     public Q_SLOTS:
         void update_data(QModelIndex topleft, QModelIndex bottomRight);
         void remove_data(QModelIndex parent, int start, int end);
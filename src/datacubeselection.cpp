@@ -111,7 +111,7 @@ void DatacubeSelectionPrivate::select_on_synchronized(QList<int> elements) {
   }
   if (synchronized_selection_model && !ignore_synchronized) {
     // Select on sync. model
-    QItemSelection selection(map_to_synchronized(selected_elements.toList()));
+    QItemSelection selection(map_to_synchronized(datacube->d->to_rows(selected_elements.toList())));
     ignore_synchronized = true;
     synchronized_selection_model->select(selection, QItemSelectionModel::ClearAndSelect);
     ignore_synchronized = false;
@@ -161,11 +161,12 @@ void DatacubeSelectionPrivate::dump() {
 void DatacubeSelection::addElements(QList< int > elements) {
   QList<int> actually_selected_elements;
   Cell cell;
-  Q_FOREACH(int element, elements) {
+  Q_FOREACH(int row, elements) {
+    const int element = d->datacube->d->element_map.id(row);
     if (!d->selected_elements.contains(element)) {
       d->datacube->d->bucket_for_element(element, cell);
       d->selected_elements << element;
-      actually_selected_elements << element;
+      actually_selected_elements << row;
       if (!cell.invalid()) {
         int newvalue = d->increaseCell(cell.row(), cell.column(),1);
         if (newvalue == 1 || newvalue == d->datacube->d->elements_in_bucket(cell.row(), cell.column()).size()) {
@@ -182,10 +183,11 @@ void DatacubeSelection::addElements(QList< int > elements) {
 void DatacubeSelection::removeElements(QList< int > elements) {
   QList<int> actually_deselected_elements;
   Cell cell;
-  Q_FOREACH(int element, elements) {
+  Q_FOREACH(int row, elements) {
+    const int element = d->datacube->d->element_map.id(row);
     if (d->selected_elements.remove(element)) {
       d->datacube->d->bucket_for_element(element, cell);
-      actually_deselected_elements << element;
+      actually_deselected_elements << row;
       if (!cell.invalid()) {
         int newvalue = d->decreaseCell(cell.row(), cell.column());
         Q_ASSERT(newvalue>=0);
@@ -214,7 +216,7 @@ DatacubeSelection::DatacubeSelection (qdatacube::Datacube* datacube, qdatacube::
 void DatacubeSelectionPrivate::reset() {
     nrows = datacube->d->number_of_buckets(Qt::Vertical);
     ncolumns = datacube->d->number_of_buckets(Qt::Horizontal);
-    QList<int> old_selected_elements = selected_elements.toList();
+    QList<int> old_selected_elements = datacube->d->to_rows(selected_elements.toList());
     cells.clear();
     selected_elements.clear();
     q->addElements(old_selected_elements);
@@ -254,6 +256,25 @@ void DatacubeSelectionPrivate::datacube_removes_element_from_bucket(int row, int
   }
 }
 
+void DatacubeSelectionPrivate::datacube_adds_elements_to_bucket(int row, int column, const QList<int>& elements) {
+  if (selected_elements.isEmpty()) {
+    return;
+  }
+  int nselected = 0;
+  Q_FOREACH(int element, elements) {
+    if (selected_elements.contains(element)) {
+      ++nselected;
+    }
+  }
+  if (nselected > 0) {
+    increaseCell(row, column, nselected);
+  }
+}
+
+void DatacubeSelectionPrivate::datacube_empties_bucket(int row, int column) {
+  cells.remove(row+column*nrows);
+}
+
 DatacubeSelection::SelectionStatus DatacubeSelection::selectionStatus(int row, int column) const {
   const int bucket_row = d->datacube->d->bucket_for_row(row);
   const int bucket_column = d->datacube->d->bucket_for_column(column);
@@ -305,24 +326,30 @@ void DatacubeSelection::synchronizeWith(QItemSelectionModel* synchronized_select
 
 void DatacubeSelectionPrivate::datacube_deletes_elements(int start, int end)
 {
-  const int adjust = (end-start)+1;
-  QSet<int> new_selected_elements;
-  Q_FOREACH(int e, selected_elements) {
-    Q_ASSERT(e<start || e>end);
-    new_selected_elements << (e>start? e-adjust:e);
+  // The ids of the removed rows are reused for new rows, which must not come up selected
+  if (selected_elements.isEmpty()) {
+    return;
+  }
+  for (int row = start; row <= end; ++row) {
+    selected_elements.remove(datacube->d->element_map.id(row));
   }
-  selected_elements = new_selected_elements;
 
 }
 
-void DatacubeSelectionPrivate::datacube_inserts_elements(int start, int end) {
-  const int adjust = (end-start)+1;
-  QSet<int> new_selected_elements;
-  Q_FOREACH(int e, selected_elements) {
-    new_selected_elements << (e>=start? e+adjust:e);
+void DatacubeSelectionPrivate::datacube_remaps_buckets(const QVector<int>& row_map, const QVector<int>& column_map) {
+  const QHash<long, int> old_cells = cells;
+  const int new_nrows = datacube->d->number_of_buckets(Qt::Vertical);
+  cells.clear();
+  for (QHash<long, int>::const_iterator it = old_cells.constBegin(), iend = old_cells.constEnd(); it != iend; ++it) {
+    const int row = row_map.isEmpty() ? it.key() % nrows : row_map.at(it.key() % nrows);
+    const int column = column_map.isEmpty() ? it.key() / nrows : column_map.at(it.key() / nrows);
+    Q_ASSERT(row >= 0 && column >= 0); // Elements in buckets that go away must have been removed already
+    if (row >= 0 && column >= 0) {
+      cells.insert(row + long(column)*new_nrows, it.value());
+    }
   }
-  selected_elements = new_selected_elements;
-
+  nrows = new_nrows;
+  ncolumns = datacube->d->number_of_buckets(Qt::Horizontal);
 }
 
 } // end of namespace
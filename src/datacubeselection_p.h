@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QHash>
+#include <QVector>
 #include <QItemSelectionModel>
 
 class QItemSelectionModel;
@@ -19,7 +20,7 @@ class DatacubeSelectionPrivate : public QObject {
         DatacubeSelection* q;
         Datacube* datacube;
         QHash<long, int> cells; // maps from bucket index to number of selected items
-        QSet<int> selected_elements; // set of the selected rows in the underlying model from the datacube
+        QSet<int> selected_elements; // set of the selected element ids in the datacube (not rows, see ElementMap)
         QItemSelectionModel* synchronized_selection_model;
         bool ignore_synchronized;
         int nrows; // bucket size of datacube
@@ -77,8 +78,23 @@ class DatacubeSelectionPrivate : public QObject {
         QList<int> elements_from_selection(QItemSelection selection);
         void datacube_adds_element_to_bucket(int row, int column, int element);
         void datacube_removes_element_from_bucket(int row, int column, int element);
+        /**
+         * Follow the datacube adding all of elements to the bucket (row, column) at once
+         */
+        void datacube_adds_elements_to_bucket(int row, int column, const QList<int>& elements);
+        /**
+         * Follow the datacube emptying the bucket (row, column) at once
+         */
+        void datacube_empties_bucket(int row, int column);
+        /**
+         * Forget the selection of rows start to end (inclusive) in the underlying model, which are about to be removed
+         */
         void datacube_deletes_elements(int start, int end);
-        void datacube_inserts_elements(int start, int end);
+        /**
+         * Follow the datacube moving its buckets, each map giving the new bucket of each old one.
+         * An empty map means the buckets in that direction did not move
+         */
+        void datacube_remaps_buckets(const QVector<int>& row_map, const QVector<int>& column_map);
     public Q_SLOTS:
         void reset();
 
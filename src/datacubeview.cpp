@@ -240,10 +240,10 @@ void DatacubeViewPrivate::paint_datacube(QPaintEvent* event) const {
         summary_rect.setSize(header_rect.size());
         painter.drawRect(summary_rect);
         QRect text_rect(summary_rect);
-        QList<int> elements = datacube->elements(Qt::Horizontal, hh, header_index);
+        const ElementRange elements = datacube->elementRange(Qt::Horizontal, hh, header_index);
         Q_FOREACH(AbstractFormatter* formatter, formatters) {
           text_rect.setHeight(formatter->cellSize().height());
-          const QString value = formatter->format(elements);
+          const QString value = formatter->formatRange(elements);
             painter.save();
             QVariant maybeforeground = aggregator->categoryHeaderData(header.categoryIndex, Qt::ForegroundRole);
             if(maybeforeground.canConvert<QColor>()) {
@@ -326,10 +326,10 @@ void DatacubeViewPrivate::paint_datacube(QPaintEvent* event) const {
         painter.drawRect(summary_rect);
         QRect text_rect(summary_rect);
         text_rect.translate(0, (summary_rect.height()-cell_size.height())/2); // Center vertically
-        QList<int> elements = datacube->elements(Qt::Vertical, vh, header_index);
+        const ElementRange elements = datacube->elementRange(Qt::Vertical, vh, header_index);
         Q_FOREACH(AbstractFormatter* formatter, formatters) {
           text_rect.setHeight(formatter->cellSize().height());
-          const QString value = formatter->format(elements);
+          const QString value = formatter->formatRange(elements);
             painter.save();
             QVariant maybeforeground = aggregator->categoryHeaderData(header.categoryIndex, Qt::ForegroundRole);
             if(maybeforeground.canConvert<QColor>()) {
@@ -370,10 +370,10 @@ void DatacubeViewPrivate::paint_datacube(QPaintEvent* event) const {
     painter.drawRect(summary_rect);
     QRect text_rect(summary_rect);
     text_rect.translate(0, (summary_rect.height()-cell_size.height())/2); // Center vertically
-    QList<int> elements = datacube->elements();
+    const ElementRange elements = datacube->elementRange();
     Q_FOREACH(AbstractFormatter* formatter, formatters) {
       text_rect.setHeight(formatter->cellSize().height());
-      const QString value = formatter->format(elements);
+      const QString value = formatter->formatRange(elements);
       painter.drawText(text_rect.adjusted(0,0,0,2), Qt::AlignCenter, value);
       text_rect.translate(0, text_rect.height());
     }
@@ -420,12 +420,12 @@ void DatacubeViewPrivate::paint_datacube(QPaintEvent* event) const {
           }
           break;
       }
-      QList<int> elements = datacube->elements(r,c);
-      if (elements.size() > 0) {
+      if (datacube->elementCount(r,c) > 0) {
+        const ElementRange elements = datacube->elementRange(r,c);
         QRect textrect(options.rect);
         Q_FOREACH(AbstractFormatter* formatter, formatters) {
           textrect.setHeight(formatter->cellSize().height());
-          const QString value = formatter->format(elements);
+          const QString value = formatter->formatRange(elements);
           q->style()->drawItemText(&painter, textrect.adjusted(0,0,0,2), Qt::AlignCenter, q->palette(), true, value, highlighted ? QPalette::HighlightedText : QPalette::Text);
           textrect.translate(0,textrect.height());
         }
@@ -0,0 +1,63 @@
+#include "distinctcountformatter.h"
+#include <QAbstractItemModel>
+#include <QEvent>
+#include <QSet>
+#include <stdexcept>
+#include <QWidget>
+#include "datacubeview.h"
+namespace qdatacube {
+
+class DistinctCountFormatterPrivate {
+    public:
+        DistinctCountFormatterPrivate(int column) : m_column(column) {
+        }
+        const int m_column;
+};
+
+DistinctCountFormatter::DistinctCountFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column)
+ : AbstractFormatter(underlying_model, view), d(new DistinctCountFormatterPrivate(column))
+{
+  if (column >= underlying_model->columnCount()|| column<0) {
+    throw std::runtime_error(QString("Column %1 must be in the underlying model, ie., be between 0 and %2").arg(column).arg(underlying_model->columnCount()).toStdString());
+  }
+  update(qdatacube::AbstractFormatter::CellSize);
+  setShortName("DST");
+  setName(QString("Distinct %1").arg(underlyingModel()->headerData(d->m_column, Qt::Horizontal).toString()));
+}
+
+QString DistinctCountFormatter::format(QList< int > rows) const
+{
+  QSet<QString> values;
+  Q_FOREACH(int element, rows) {
+    values << underlyingModel()->index(element, d->m_column).data().toString();
+  }
+  return QString::number(values.size());
+}
+
+QString DistinctCountFormatter::formatRange(const ElementRange& elements) const
+{
+  if (elements.hasDistinctCount(d->m_column)) {
+    return QString::number(qRound64(elements.distinctSketch(d->m_column).estimate()));
+  }
+  QSet<QString> values;
+  for (ElementRange::const_iterator it = elements.begin(), iend = elements.end(); it != iend; ++it) {
+    values << underlyingModel()->index(*it, d->m_column).data().toString();
+  }
+  return QString::number(values.size());
+}
+
+void DistinctCountFormatter::update(AbstractFormatter::UpdateType element) {
+    if(element == qdatacube::AbstractFormatter::CellSize) {
+        if(datacubeView()) {
+            // There are never more distinct values than rows
+            QString big_cell_contents = QString::number(underlyingModel()->rowCount());
+            setCellSize(QSize(datacubeView()->fontMetrics().width(big_cell_contents), datacubeView()->fontMetrics().lineSpacing()));
+        }
+    }
+}
+
+DistinctCountFormatter::~DistinctCountFormatter() {
+
+}
+
+} // end of namespace
@@ -0,0 +1,31 @@
+#ifndef QDATACUBE_DISTINCT_COUNT_FORMATTER_H
+#define QDATACUBE_DISTINCT_COUNT_FORMATTER_H
+
+#include "abstractformatter.h"
+#include "qdatacube_export.h"
+namespace qdatacube {
+
+/**
+  * Formatter that shows the number of distinct values of a column, e.g. the number of customers in a cell.
+  * If the datacube counts the column (see Datacube::addDistinctCount()), cells and totals are read from its
+  * sketches, exact for small cells and estimated within a few percent for big ones. Otherwise the values are
+  * counted exactly, which is slow for big cells and totals.
+  */
+class DistinctCountFormatterPrivate;
+class QDATACUBE_EXPORT DistinctCountFormatter : public AbstractFormatter {
+    public:
+        /**
+         * @param underlying_model the underlying_model
+         * @param column the column of the underlying model to count the distinct values of, compared as strings
+         */
+        DistinctCountFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column);
+        virtual QString format(QList< int > rows) const;
+        virtual QString formatRange(const ElementRange& elements) const;
+        virtual ~DistinctCountFormatter();
+    protected:
+        virtual void update(UpdateType element);
+    private:
+        QScopedPointer<DistinctCountFormatterPrivate> d;
+};
+} // end of namespace
+#endif // QDATACUBE_DISTINCT_COUNT_FORMATTER_H
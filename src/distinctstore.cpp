@@ -0,0 +1,177 @@
+#include "distinctstore.h"
+
+#include "cellstore.h"
+
+namespace qdatacube {
+
+namespace {
+
+/**
+ * Move the sketches of buckets to bucket_map, dropping those mapped to -1. An empty bucket_map leaves them
+ */
+void remap_buckets(QHash<int, HyperLogLog>& buckets, const QVector<int>& bucket_map) {
+  if (bucket_map.isEmpty()) {
+    return;
+  }
+  QHash<int, HyperLogLog> remapped;
+  for (QHash<int, HyperLogLog>::const_iterator it = buckets.constBegin(), iend = buckets.constEnd(); it != iend; ++it) {
+    if (bucket_map.at(it.key()) >= 0) {
+      remapped.insert(bucket_map.at(it.key()), it.value());
+    }
+  }
+  buckets = remapped;
+}
+
+}
+
+DistinctStore::DistinctStore()
+{
+}
+
+int DistinctStore::indexOf(int column) const {
+  for (int distinct = 0; distinct < m_columns.size(); ++distinct) {
+    if (m_columns.at(distinct).column == column) {
+      return distinct;
+    }
+  }
+  return -1;
+}
+
+int DistinctStore::addColumn(int column) {
+  Q_ASSERT(indexOf(column) < 0);
+  Column c;
+  c.column = column;
+  m_columns << c;
+  return m_columns.size() - 1;
+}
+
+void DistinctStore::removeColumn(int distinct) {
+  m_columns.remove(distinct);
+}
+
+void DistinctStore::setHash(int distinct, int element, quint64 hash) {
+  QVector<quint64>& hashes = m_columns[distinct].hashes;
+  if (element >= hashes.size()) {
+    hashes.resize(element + 1);
+  }
+  hashes[element] = hash;
+}
+
+void DistinctStore::add(long cell, int bucket_row, int bucket_column, int element) {
+  for (int distinct = 0; distinct < m_columns.size(); ++distinct) {
+    Column& c = m_columns[distinct];
+    const quint64 hash = c.hashes.at(element);
+    QHash<long, HyperLogLog>::iterator cit = c.cells.find(cell);
+    if (cit != c.cells.end()) {
+      cit->add(hash);
+    }
+    QHash<int, HyperLogLog>::iterator it = c.rows.find(bucket_row);
+    if (it != c.rows.end()) {
+      it->add(hash);
+    }
+    it = c.columns.find(bucket_column);
+    if (it != c.columns.end()) {
+      it->add(hash);
+    }
+    if (c.total_valid) {
+      c.total.add(hash);
+    }
+  }
+}
+
+void DistinctStore::remove(long cell, int bucket_row, int bucket_column) {
+  for (int distinct = 0; distinct < m_columns.size(); ++distinct) {
+    Column& c = m_columns[distinct];
+    c.cells.remove(cell);
+    c.rows.remove(bucket_row);
+    c.columns.remove(bucket_column);
+    c.total_valid = false;
+  }
+}
+
+void DistinctStore::clear() {
+  for (int distinct = 0; distinct < m_columns.size(); ++distinct) {
+    Column& c = m_columns[distinct];
+    c.cells.clear();
+    c.rows.clear();
+    c.columns.clear();
+    c.total_valid = false;
+  }
+}
+
+const HyperLogLog& DistinctStore::cellSketch(int distinct, long cell, const CellStore& cells) {
+  Column& c = m_columns[distinct];
+  QHash<long, HyperLogLog>::iterator it = c.cells.find(cell);
+  if (it == c.cells.end()) {
+    it = c.cells.insert(cell, HyperLogLog());
+    const CellStore::const_iterator elements = cells.constFind(cell);
+    if (elements != cells.constEnd()) {
+      for (const int* eit = elements.begin(), *eend = elements.end(); eit != eend; ++eit) {
+        it->add(c.hashes.at(*eit));
+      }
+    }
+  }
+  return *it;
+}
+
+const HyperLogLog& DistinctStore::rowSketch(int distinct, int bucket_row, const CellStore& cells, int nrows, int ncolumns) {
+  QHash<int, HyperLogLog>::iterator it = m_columns[distinct].rows.find(bucket_row);
+  if (it == m_columns[distinct].rows.end()) {
+    HyperLogLog sketch;
+    for (int bucket_column = 0; bucket_column < ncolumns; ++bucket_column) {
+      const long cell = bucket_row + long(bucket_column)*nrows;
+      if (cells.contains(cell)) {
+        sketch.merge(cellSketch(distinct, cell, cells));
+      }
+    }
+    it = m_columns[distinct].rows.insert(bucket_row, sketch);
+  }
+  return *it;
+}
+
+const HyperLogLog& DistinctStore::columnSketch(int distinct, int bucket_column, const CellStore& cells, int nrows) {
+  QHash<int, HyperLogLog>::iterator it = m_columns[distinct].columns.find(bucket_column);
+  if (it == m_columns[distinct].columns.end()) {
+    HyperLogLog sketch;
+    for (int bucket_row = 0; bucket_row < nrows; ++bucket_row) {
+      const long cell = bucket_row + long(bucket_column)*nrows;
+      if (cells.contains(cell)) {
+        sketch.merge(cellSketch(distinct, cell, cells));
+      }
+    }
+    it = m_columns[distinct].columns.insert(bucket_column, sketch);
+  }
+  return *it;
+}
+
+const HyperLogLog& DistinctStore::totalSketch(int distinct, const CellStore& cells) {
+  if (!m_columns.at(distinct).total_valid) {
+    HyperLogLog sketch;
+    for (CellStore::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+      sketch.merge(cellSketch(distinct, it.key(), cells));
+    }
+    Column& c = m_columns[distinct];
+    c.total = sketch;
+    c.total_valid = true;
+  }
+  return m_columns.at(distinct).total;
+}
+
+void DistinctStore::remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows) {
+  for (int i = 0; i < m_columns.size(); ++i) {
+    Column& c = m_columns[i];
+    QHash<long, HyperLogLog> cells;
+    for (QHash<long, HyperLogLog>::const_iterator it = c.cells.constBegin(), iend = c.cells.constEnd(); it != iend; ++it) {
+      const long row = row_map.isEmpty() ? it.key() % nrows : row_map.at(it.key() % nrows);
+      const long column = column_map.isEmpty() ? it.key() / nrows : column_map.at(it.key() / nrows);
+      if (row >= 0 && column >= 0) {
+        cells.insert(row + column*new_nrows, it.value());
+      }
+    }
+    c.cells = cells;
+    remap_buckets(c.rows, row_map);
+    remap_buckets(c.columns, column_map);
+  }
+}
+
+} // end of namespace
@@ -0,0 +1,125 @@
+#ifndef QDATACUBE_DISTINCTSTORE_H
+#define QDATACUBE_DISTINCTSTORE_H
+
+#include "hyperloglog.h"
+
+#include <QHash>
+#include <QVector>
+
+namespace qdatacube {
+
+class CellStore;
+
+/**
+ * The distinct counts a datacube keeps for some columns of the underlying model: the hash of the value of each
+ * element in each of those columns, and HyperLogLog sketches of cells, row and column buckets and of all elements.
+ *
+ * Sketches are made when first asked for, cells from their elements, buckets by merging their cells and the
+ * total by merging the row buckets. Adding an element adds it to the sketches made that hold it, while removing
+ * one drops them, as sketches cannot forget values, to be made again when next asked for.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class DistinctStore {
+    public:
+        DistinctStore();
+
+        /**
+         * @return true if no columns are counted
+         */
+        bool isEmpty() const {
+            return m_columns.isEmpty();
+        }
+
+        /**
+         * @return number of columns counted
+         */
+        int count() const {
+            return m_columns.size();
+        }
+
+        /**
+         * @return the column of the underlying model of distinct count
+         */
+        int column(int distinct) const {
+            return m_columns.at(distinct).column;
+        }
+
+        /**
+         * @return the distinct count of column, or -1 if it is not counted
+         */
+        int indexOf(int column) const;
+
+        /**
+         * Start counting the distinct values of column. The hashes of the elements must be set before use
+         * @return the new distinct count
+         */
+        int addColumn(int column);
+
+        /**
+         * Stop counting distinct
+         */
+        void removeColumn(int distinct);
+
+        /**
+         * Set the hash of the value of element for distinct. Sketches already holding element are not changed
+         */
+        void setHash(int distinct, int element, quint64 hash);
+
+        /**
+         * Add element, now in cell (bucket_row, bucket_column), to the sketches holding it
+         */
+        void add(long cell, int bucket_row, int bucket_column, int element);
+
+        /**
+         * Drop the sketches holding element, which is leaving cell (bucket_row, bucket_column)
+         */
+        void remove(long cell, int bucket_row, int bucket_column);
+
+        /**
+         * Drop all sketches, e.g. when the cells are laid out anew
+         */
+        void clear();
+
+        /**
+         * Move the sketches of the cells and buckets to new bucket coordinates, as CellStore::remap(). The sketches
+         * of dropped buckets are dropped, and the total must not change
+         */
+        void remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows);
+
+        /**
+         * @return sketch of cell
+         */
+        const HyperLogLog& cellSketch(int distinct, long cell, const CellStore& cells);
+
+        /**
+         * @return sketch of the elements in row bucket, for a datacube with nrows row buckets and ncolumns column buckets
+         */
+        const HyperLogLog& rowSketch(int distinct, int bucket_row, const CellStore& cells, int nrows, int ncolumns);
+
+        /**
+         * @return sketch of the elements in column bucket
+         */
+        const HyperLogLog& columnSketch(int distinct, int bucket_column, const CellStore& cells, int nrows);
+
+        /**
+         * @return sketch of all elements
+         */
+        const HyperLogLog& totalSketch(int distinct, const CellStore& cells);
+
+    private:
+        struct Column {
+            Column() : column(-1), total_valid(false) {}
+            int column;
+            QVector<quint64> hashes; // indexed by element
+            QHash<long, HyperLogLog> cells;
+            QHash<int, HyperLogLog> rows;
+            QHash<int, HyperLogLog> columns;
+            HyperLogLog total;
+            bool total_valid;
+        };
+        QVector<Column> m_columns;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_DISTINCTSTORE_H
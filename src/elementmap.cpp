@@ -0,0 +1,239 @@
+#include "elementmap.h"
+
+namespace qdatacube {
+
+ElementMap::ElementMap() : m_root(-1), m_nrows(0), m_identity(true), m_seed(2463534242u)
+{
+}
+
+void ElementMap::reset(int nrows) {
+  m_nodes.clear();
+  m_free.clear();
+  m_root = -1;
+  m_nrows = nrows;
+  m_identity = true;
+}
+
+void ElementMap::insertRows(int start, int count) {
+  Q_ASSERT(start >= 0 && start <= m_nrows && count >= 0);
+  if (m_identity && start == m_nrows) {
+    m_nrows += count;
+    return;
+  }
+  materialize();
+  QVector<int> new_ids(count);
+  for (int i = 0; i < count; ++i) {
+    if (m_free.isEmpty()) {
+      new_ids[i] = m_nodes.size();
+      m_nodes.append(Node());
+    } else {
+      new_ids[i] = m_free.takeLast();
+    }
+  }
+  const int inserted = build(new_ids);
+  int left, right;
+  split(m_root, start, left, right);
+  m_root = merge(merge(left, inserted), right);
+  m_nodes[m_root].parent = -1;
+  m_nrows += count;
+}
+
+void ElementMap::removeRows(int start, int count) {
+  Q_ASSERT(start >= 0 && count >= 0 && start + count <= m_nrows);
+  if (count == 0) {
+    return;
+  }
+  if (m_identity && start + count == m_nrows) {
+    m_nrows -= count;
+    return;
+  }
+  if (start == 0 && count == m_nrows) {
+    // Nothing left to keep apart, so start over with ids equal to rows
+    reset(0);
+    return;
+  }
+  materialize();
+  int left, rest, removed, right;
+  split(m_root, start, left, rest);
+  split(rest, count, removed, right);
+  QVector<int> stack;
+  stack << removed;
+  while (!stack.isEmpty()) {
+    const int node = stack.takeLast();
+    if (node >= 0) {
+      stack << m_nodes.at(node).left << m_nodes.at(node).right;
+      m_free << node;
+    }
+  }
+  m_root = merge(left, right);
+  m_nodes[m_root].parent = -1;
+  m_nrows -= count;
+}
+
+QVector< int > ElementMap::ids() const {
+  QVector<int> rv(m_nrows);
+  if (m_identity) {
+    for (int row = 0; row < m_nrows; ++row) {
+      rv[row] = row;
+    }
+    return rv;
+  }
+  // In order traversal
+  QVector<int> stack;
+  int row = 0;
+  int node = m_root;
+  while (node >= 0 || !stack.isEmpty()) {
+    if (node >= 0) {
+      stack << node;
+      node = m_nodes.at(node).left;
+    } else {
+      node = stack.takeLast();
+      rv[row++] = node;
+      node = m_nodes.at(node).right;
+    }
+  }
+  Q_ASSERT(row == m_nrows);
+  return rv;
+}
+
+QVector< int > ElementMap::rows() const {
+  QVector<int> rv(idCount(), -1);
+  const QVector<int> row_ids = ids();
+  for (int row = 0; row < row_ids.size(); ++row) {
+    rv[row_ids.at(row)] = row;
+  }
+  return rv;
+}
+
+int ElementMap::select(int row) const {
+  Q_ASSERT(row >= 0 && row < m_nrows);
+  int node = m_root;
+  for (;;) {
+    const Node& n = m_nodes.at(node);
+    const int left_size = size(n.left);
+    if (row < left_size) {
+      node = n.left;
+    } else if (row == left_size) {
+      return node;
+    } else {
+      row -= left_size + 1;
+      node = n.right;
+    }
+  }
+}
+
+int ElementMap::rank(int id) const {
+  Q_ASSERT(id >= 0 && id < m_nodes.size());
+  int rv = size(m_nodes.at(id).left);
+  for (int node = id, parent = m_nodes.at(id).parent; parent >= 0; node = parent, parent = m_nodes.at(parent).parent) {
+    if (m_nodes.at(parent).right == node) {
+      rv += size(m_nodes.at(parent).left) + 1;
+    }
+  }
+  return rv;
+}
+
+void ElementMap::materialize() {
+  if (!m_identity) {
+    return;
+  }
+  const QVector<int> row_ids = ids();
+  m_identity = false;
+  m_nodes.resize(m_nrows);
+  m_root = build(row_ids);
+  if (m_root >= 0) {
+    m_nodes[m_root].parent = -1;
+  }
+}
+
+int ElementMap::build(const QVector<int>& ids) {
+  // Cartesian tree over the ids in order with random priorities, keeping the right spine on a stack
+  QVector<int> spine;
+  for (int i = 0; i < ids.size(); ++i) {
+    const int id = ids.at(i);
+    Node& node = m_nodes[id];
+    node.left = -1;
+    node.right = -1;
+    node.parent = -1;
+    node.size = 1;
+    node.priority = next_priority();
+    int last = -1;
+    while (!spine.isEmpty() && m_nodes.at(spine.last()).priority < node.priority) {
+      last = spine.takeLast();
+      update(last);
+    }
+    node.left = last;
+    if (!spine.isEmpty()) {
+      m_nodes[spine.last()].right = id;
+    }
+    spine << id;
+  }
+  while (spine.size() > 1) {
+    update(spine.takeLast());
+  }
+  if (spine.isEmpty()) {
+    return -1;
+  }
+  update(spine.first());
+  return spine.first();
+}
+
+void ElementMap::update(int node) {
+  Node& n = m_nodes[node];
+  n.size = 1 + size(n.left) + size(n.right);
+  if (n.left >= 0) {
+    m_nodes[n.left].parent = node;
+  }
+  if (n.right >= 0) {
+    m_nodes[n.right].parent = node;
+  }
+}
+
+int ElementMap::merge(int left, int right) {
+  if (left < 0) {
+    return right;
+  }
+  if (right < 0) {
+    return left;
+  }
+  if (m_nodes.at(left).priority > m_nodes.at(right).priority) {
+    m_nodes[left].right = merge(m_nodes.at(left).right, right);
+    update(left);
+    return left;
+  } else {
+    m_nodes[right].left = merge(left, m_nodes.at(right).left);
+    update(right);
+    return right;
+  }
+}
+
+void ElementMap::split(int node, int count, int& left, int& right) {
+  if (node < 0) {
+    left = -1;
+    right = -1;
+    return;
+  }
+  const int left_size = size(m_nodes.at(node).left);
+  if (left_size < count) {
+    int rest;
+    split(m_nodes.at(node).right, count - left_size - 1, rest, right);
+    m_nodes[node].right = rest;
+    left = node;
+  } else {
+    int rest;
+    split(m_nodes.at(node).left, count, left, rest);
+    m_nodes[node].left = rest;
+    right = node;
+  }
+  update(node);
+}
+
+quint32 ElementMap::next_priority() {
+  // xorshift32
+  m_seed ^= m_seed << 13;
+  m_seed ^= m_seed >> 17;
+  m_seed ^= m_seed << 5;
+  return m_seed;
+}
+
+} // end of namespace
@@ -0,0 +1,112 @@
+#ifndef QDATACUBE_ELEMENTMAP_H
+#define QDATACUBE_ELEMENTMAP_H
+
+#include <QVector>
+
+namespace qdatacube {
+
+/**
+ * Maps between the rows of the underlying model and stable element ids, which is what a datacube keeps in
+ * its cells, so that rows inserted or removed in the middle of the model do not renumber the elements.
+ *
+ * While rows are only appended to or removed from the end of the model, ids equal rows and no tree is kept.
+ * After the first insert or remove anywhere else, the ids are kept in row order in an implicit treap
+ * (a randomized balanced binary tree keyed by position), where subtree sizes give the row of an id and the
+ * id of a row in O(log n). Inserting or removing a range of rows is O(log n) plus the size of the range.
+ * Ids of removed rows are reused for new rows.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class ElementMap {
+    public:
+        ElementMap();
+
+        /**
+         * Map nrows rows, each to the id equal to its row
+         */
+        void reset(int nrows);
+
+        /**
+         * @return true if every id equals its row
+         */
+        bool isIdentity() const {
+            return m_identity;
+        }
+
+        /**
+         * @return number of rows
+         */
+        int rowCount() const {
+            return m_nrows;
+        }
+
+        /**
+         * @return upper bound (exclusive) of the ids in use, for arrays indexed by id
+         */
+        int idCount() const {
+            return m_identity ? m_nrows : m_nodes.size();
+        }
+
+        /**
+         * @return id of row
+         */
+        int id(int row) const {
+            return m_identity ? row : select(row);
+        }
+
+        /**
+         * @return row of id, which must be in use
+         */
+        int row(int id) const {
+            return m_identity ? id : rank(id);
+        }
+
+        /**
+         * Insert count rows before start, each with a new id
+         */
+        void insertRows(int start, int count);
+
+        /**
+         * Remove count rows from start, freeing their ids
+         */
+        void removeRows(int start, int count);
+
+        /**
+         * @return the id of each row. O(n)
+         */
+        QVector<int> ids() const;
+
+        /**
+         * @return the row of each id, or -1 for ids not in use. O(n)
+         */
+        QVector<int> rows() const;
+
+    private:
+        struct Node {
+            int left;
+            int right;
+            int parent;
+            int size;
+            quint32 priority;
+        };
+        int size(int node) const {
+            return node < 0 ? 0 : m_nodes.at(node).size;
+        }
+        int select(int row) const;
+        int rank(int id) const;
+        void materialize();
+        int build(const QVector<int>& ids);
+        void update(int node);
+        int merge(int left, int right);
+        void split(int node, int count, int& left, int& right);
+        quint32 next_priority();
+        QVector<Node> m_nodes; // indexed by id, empty while ids equal rows
+        QVector<int> m_free; // ids not in use
+        int m_root;
+        int m_nrows;
+        bool m_identity;
+        quint32 m_seed;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_ELEMENTMAP_H
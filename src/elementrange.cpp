@@ -0,0 +1,123 @@
+#include "elementrange.h"
+#include "elementrange_p.h"
+
+#include "datacube_p.h"
+#include "elementmap.h"
+#include "measurestore.h"
+
+namespace qdatacube {
+
+void ElementRangePrivate::fill() const {
+  if (source) {
+    source->fill_range(*this);
+    source = 0;
+  }
+}
+
+ElementRange::ElementRange() : d(new ElementRangePrivate)
+{
+}
+
+ElementRange::ElementRange(const ElementRange& other) : d(other.d)
+{
+}
+
+ElementRange& ElementRange::operator=(const ElementRange& other) {
+  d = other.d;
+  return *this;
+}
+
+ElementRange::~ElementRange()
+{
+}
+
+ElementRange::const_iterator::const_iterator(const ElementRangePrivate* range, int segment) : m_range(range), m_segment(segment), m_element(0)
+{
+  next_segment(segment);
+}
+
+int ElementRange::const_iterator::operator*() const {
+  return m_range->map ? m_range->map->row(*m_element) : *m_element;
+}
+
+ElementRange::const_iterator& ElementRange::const_iterator::operator++() {
+  if (++m_element == m_range->segments.at(m_segment).end) {
+    next_segment(m_segment + 1);
+  }
+  return *this;
+}
+
+void ElementRange::const_iterator::next_segment(int segment) {
+  for (m_segment = segment; m_segment < m_range->segments.size(); ++m_segment) {
+    if (m_range->segments.at(m_segment).begin != m_range->segments.at(m_segment).end) {
+      m_element = m_range->segments.at(m_segment).begin;
+      return;
+    }
+  }
+  m_element = 0;
+}
+
+ElementRange::const_iterator ElementRange::begin() const {
+  d->fill();
+  return const_iterator(d.constData(), 0);
+}
+
+ElementRange::const_iterator ElementRange::end() const {
+  d->fill();
+  return const_iterator(d.constData(), d->segments.size());
+}
+
+int ElementRange::size() const {
+  return d->size;
+}
+
+bool ElementRange::isEmpty() const {
+  return d->size == 0;
+}
+
+QList< int > ElementRange::toList() const {
+  QList<int> rv;
+  rv.reserve(d->size);
+  for (const_iterator it = begin(), iend = end(); it != iend; ++it) {
+    rv << *it;
+  }
+  return rv;
+}
+
+bool ElementRange::hasMeasure(int column) const {
+  return d->measures && d->measures->indexOf(column) >= 0;
+}
+
+Measure ElementRange::measure(int column) const {
+  const int measure = d->measures ? d->measures->indexOf(column) : -1;
+  if (measure < 0 || !d->totals) {
+    return Measure();
+  }
+  return d->totals[measure];
+}
+
+bool ElementRange::hasDistinctCount(int column) const {
+  return d->datacube && d->datacube->distincts.indexOf(column) >= 0;
+}
+
+HyperLogLog ElementRange::distinctSketch(int column) const {
+  const int distinct = d->datacube ? d->datacube->distincts.indexOf(column) : -1;
+  if (distinct < 0) {
+    return HyperLogLog();
+  }
+  return d->datacube->distinct_sketch(*d, distinct);
+}
+
+bool ElementRange::hasQuantiles(int column) const {
+  return d->datacube && d->datacube->quantiles.indexOf(column) >= 0;
+}
+
+TDigest ElementRange::quantileDigest(int column) const {
+  const int quantile = d->datacube ? d->datacube->quantiles.indexOf(column) : -1;
+  if (quantile < 0) {
+    return TDigest();
+  }
+  return d->datacube->quantile_digest(*d, quantile);
+}
+
+} // end of namespace
@@ -0,0 +1,131 @@
+#ifndef QDATACUBE_ELEMENTRANGE_H
+#define QDATACUBE_ELEMENTRANGE_H
+
+#include "qdatacube_export.h"
+#include "hyperloglog.h"
+#include "measure.h"
+#include "tdigest.h"
+
+#include <QList>
+#include <QSharedDataPointer>
+#include <cstddef>
+#include <iterator>
+
+namespace qdatacube {
+
+class DatacubePrivate;
+class ElementRangePrivate;
+
+/**
+ * Non-owning view of the elements (rows in the underlying model) of a cell, a header section or
+ * the whole of a datacube, as given by Datacube::elementRange().
+ *
+ * The elements are read straight from the storage of the datacube, so nothing is copied, but the range
+ * is only valid until the datacube changes. Elements come in no particular order. The size and the measures
+ * of the range are kept by the datacube, so reading only those does not touch the elements at all.
+ */
+class QDATACUBE_EXPORT ElementRange {
+    public:
+        /**
+         * Empty range
+         */
+        ElementRange();
+        ElementRange(const ElementRange& other);
+        ElementRange& operator=(const ElementRange& other);
+        ~ElementRange();
+
+        /**
+         * Forward iterator over the elements
+         */
+        class QDATACUBE_EXPORT const_iterator {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef int value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const int* pointer;
+                typedef int reference;
+                const_iterator() : m_range(0), m_segment(0), m_element(0) {}
+                int operator*() const;
+                const_iterator& operator++();
+                const_iterator operator++(int) {
+                    const_iterator rv(*this);
+                    ++*this;
+                    return rv;
+                }
+                bool operator==(const const_iterator& rhs) const {
+                    return m_element == rhs.m_element;
+                }
+                bool operator!=(const const_iterator& rhs) const {
+                    return m_element != rhs.m_element;
+                }
+            private:
+                const_iterator(const ElementRangePrivate* range, int segment);
+                void next_segment(int segment);
+                const ElementRangePrivate* m_range;
+                int m_segment;
+                const int* m_element;
+                friend class ElementRange;
+        };
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator constBegin() const {
+            return begin();
+        }
+        const_iterator constEnd() const {
+            return end();
+        }
+
+        /**
+         * @return number of elements. O(1)
+         */
+        int size() const;
+
+        bool isEmpty() const;
+
+        /**
+         * @return the elements as a list, for code wanting one
+         */
+        QList<int> toList() const;
+
+        /**
+         * @return true if the datacube keeps the measure of column, see Datacube::addMeasure()
+         */
+        bool hasMeasure(int column) const;
+
+        /**
+         * @return measure of column over the elements, in O(1). Empty if the datacube does not keep the measure of column.
+         */
+        Measure measure(int column) const;
+
+        /**
+         * @return true if the datacube keeps the distinct count of column, see Datacube::addDistinctCount()
+         */
+        bool hasDistinctCount(int column) const;
+
+        /**
+         * @return sketch of the distinct values of column over the elements, merged from the sketches the
+         * datacube keeps. Empty if the datacube does not keep the distinct count of column.
+         */
+        HyperLogLog distinctSketch(int column) const;
+
+        /**
+         * @return true if the datacube keeps the quantiles of column, see Datacube::addQuantiles()
+         */
+        bool hasQuantiles(int column) const;
+
+        /**
+         * @return digest of the values of column over the elements, merged from the digests the datacube keeps.
+         * Empty if the datacube does not keep the quantiles of column.
+         */
+        TDigest quantileDigest(int column) const;
+
+    private:
+        QSharedDataPointer<ElementRangePrivate> d;
+        friend class Datacube;
+        friend class DatacubePrivate;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_ELEMENTRANGE_H
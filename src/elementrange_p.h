@@ -0,0 +1,50 @@
+#ifndef QDATACUBE_ELEMENTRANGE_P
+#define QDATACUBE_ELEMENTRANGE_P
+
+#include <QSharedData>
+#include <QVector>
+
+namespace qdatacube {
+
+class DatacubePrivate;
+class ElementMap;
+class Measure;
+class MeasureStore;
+
+class ElementRangePrivate : public QSharedData {
+    public:
+        struct Segment {
+            Segment() : begin(0), end(0) {}
+            Segment(const int* begin, const int* end) : begin(begin), end(end) {}
+            const int* begin;
+            const int* end;
+        };
+        ElementRangePrivate() : map(0), measures(0), totals(0), size(0), datacube(0), source(0), horizontal(false),
+                                first_display_bucket(0), display_bucket_count(0), cell(-1) {}
+        void append(const int* begin, const int* end) const {
+            if (begin != end) {
+                segments << Segment(begin, end);
+            }
+        }
+        /**
+         * Find the segments, which are looked up only when the elements are first needed
+         */
+        void fill() const;
+        mutable QVector<Segment> segments;
+        const ElementMap* map; // maps element ids to rows, or 0 if they are the same
+        const MeasureStore* measures;
+        const Measure* totals; // the measures of all the elements, in the order of measures, or 0
+        int size;
+        DatacubePrivate* datacube;
+        // Where the segments are, until fill() has found them
+        mutable const DatacubePrivate* source;
+        // What the range is for: display buckets in one direction, all cells (count -1) or the cell cell (count 0)
+        bool horizontal;
+        int first_display_bucket;
+        int display_bucket_count;
+        long cell;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_ELEMENTRANGE_P
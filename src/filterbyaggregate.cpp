@@ -4,6 +4,8 @@
 
 #include <QSharedPointer>
 
+#include <algorithm>
+
 namespace qdatacube {
 
 class FilterByAggregatePrivate {
@@ -61,6 +63,31 @@ bool FilterByAggregate::operator()(int row) const {
     return d->m_aggregator->operator()(row) == d->m_categoryIndex;
 }
 
+bool FilterByAggregate::isThreadSafe() const {
+    return d->m_aggregator->isThreadSafe();
+}
+
+bool FilterByAggregate::hasIncludedRows() const {
+    return d->m_aggregator->hasPostings();
+}
+
+QVector<int> FilterByAggregate::includedRows() const {
+    if (d->m_categoryIndex < 0) {
+        return QVector<int>();
+    }
+    return d->m_aggregator->postings(d->m_categoryIndex);
+}
+
+void FilterByAggregate::evaluate(int begin, int end, quint64* included) const {
+    // Categorize the whole batch, which aggregators over typed data do without a call per row
+    QVector<int> categories(end - begin);
+    d->m_aggregator->categorize(begin, end, categories.data());
+    std::fill(included, included + ((end - begin + 63) >> 6), quint64(0));
+    for (int i = 0; i < categories.size(); ++i) {
+        included[i >> 6] |= quint64(categories.at(i) == d->m_categoryIndex) << (i & 63);
+    }
+}
+
 void FilterByAggregate::slot_aggregator_category_inserted(int index) {
     if (d->m_categoryIndex == -1) {
         d->m_categoryIndex = categoryToIndex(d->m_aggregator, d->m_category);
@@ -35,6 +35,10 @@ public:
 
     // Inherited:
     virtual bool operator()(int row) const;
+    virtual bool isThreadSafe() const;
+    virtual bool hasIncludedRows() const;
+    virtual QVector<int> includedRows() const;
+    virtual void evaluate(int begin, int end, quint64* included) const;
 
     // Getters:
     AbstractAggregator::Ptr aggregator() const;
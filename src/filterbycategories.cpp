@@ -0,0 +1,143 @@
+#include "filterbycategories.h"
+
+#include "abstractaggregator.h"
+
+#include <QBitArray>
+#include <QSharedPointer>
+
+#include <algorithm>
+
+namespace qdatacube {
+
+class FilterByCategoriesPrivate {
+public:
+    FilterByCategoriesPrivate(FilterByCategories* q, AbstractAggregator::Ptr aggregator, const QStringList& categories);
+    AbstractAggregator::Ptr m_aggregator;
+    QStringList m_categories;
+    QBitArray m_included; // indexed by category index, sized to categoryCount()
+};
+
+FilterByCategoriesPrivate::FilterByCategoriesPrivate(FilterByCategories* q, AbstractAggregator::Ptr aggregator,
+                                                     const QStringList& categories)
+  : m_aggregator(aggregator), m_categories(categories), m_included(aggregator->categoryCount())
+{
+    Q_ASSERT(aggregator);
+    for (int i = 0; i < aggregator->categoryCount(); ++i) {
+        if (m_categories.contains(aggregator->categoryHeaderData(i, Qt::DisplayRole).toString())) {
+            m_included.setBit(i);
+        }
+    }
+    QObject::connect(aggregator.data(), &AbstractAggregator::categoryAdded, q, &FilterByCategories::slot_aggregator_category_inserted);
+    QObject::connect(aggregator.data(), &AbstractAggregator::categoryRemoved, q, &FilterByCategories::slot_aggregator_category_removed);
+    q->setShortName(m_categories.join(","));
+    q->setName(m_aggregator->name() + "=" + m_categories.join("|"));
+}
+
+// Utility function to find the display texts of categories
+static QStringList indexesToCategories(const AbstractAggregator::Ptr aggregator, const QList<int>& categoryIndexes) {
+    QStringList categories;
+    Q_FOREACH(int categoryIndex, categoryIndexes) {
+        Q_ASSERT(0 <= categoryIndex && categoryIndex < aggregator->categoryCount());
+        categories << aggregator->categoryHeaderData(categoryIndex, Qt::DisplayRole).toString();
+    }
+    return categories;
+}
+
+FilterByCategories::FilterByCategories(AbstractAggregator::Ptr aggregator, const QList<int>& categoryIndexes)
+  : AbstractFilter(aggregator->underlyingModel()),
+    d(new FilterByCategoriesPrivate(this, aggregator, indexesToCategories(aggregator, categoryIndexes)))
+{
+    // Empty
+}
+
+FilterByCategories::FilterByCategories(AbstractAggregator::Ptr aggregator, const QStringList& categoryLabels)
+  : AbstractFilter(aggregator->underlyingModel()),
+    d(new FilterByCategoriesPrivate(this, aggregator, categoryLabels))
+{
+    // Empty
+}
+
+FilterByCategories::~FilterByCategories() {
+    // Empty
+}
+
+bool FilterByCategories::operator()(int row) const {
+    const int category = d->m_aggregator->operator()(row);
+    return category >= 0 && category < d->m_included.size() && d->m_included.testBit(category);
+}
+
+bool FilterByCategories::isThreadSafe() const {
+    return d->m_aggregator->isThreadSafe();
+}
+
+bool FilterByCategories::hasIncludedRows() const {
+    return d->m_aggregator->hasPostings();
+}
+
+void FilterByCategories::evaluate(int begin, int end, quint64* included) const {
+    QVector<int> categories(end - begin);
+    d->m_aggregator->categorize(begin, end, categories.data());
+    std::fill(included, included + ((end - begin + 63) >> 6), quint64(0));
+    const int ncategories = d->m_included.size();
+    for (int i = 0; i < categories.size(); ++i) {
+        const int category = categories.at(i);
+        if (category >= 0 && category < ncategories && d->m_included.testBit(category)) {
+            included[i >> 6] |= quint64(1) << (i & 63);
+        }
+    }
+}
+
+QVector<int> FilterByCategories::includedRows() const {
+    QVector<int> rows;
+    Q_FOREACH(int category, categoryIndexes()) {
+        rows += d->m_aggregator->postings(category);
+    }
+    // Each row is in a single category, so sorting is all it takes to merge them
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+void FilterByCategories::slot_aggregator_category_inserted(int index) {
+    QBitArray included(d->m_included.size() + 1);
+    for (int category = 0; category < d->m_included.size(); ++category) {
+        if (d->m_included.testBit(category)) {
+            included.setBit(category < index ? category : category + 1);
+        }
+    }
+    if (d->m_categories.contains(d->m_aggregator->categoryHeaderData(index, Qt::DisplayRole).toString())) {
+        included.setBit(index);
+    }
+    d->m_included = included;
+}
+
+void FilterByCategories::slot_aggregator_category_removed(int index) {
+    QBitArray included(d->m_included.size() - 1);
+    for (int category = 0; category < d->m_included.size(); ++category) {
+        if (category != index && d->m_included.testBit(category)) {
+            included.setBit(category < index ? category : category - 1);
+        }
+    }
+    d->m_included = included;
+}
+
+AbstractAggregator::Ptr FilterByCategories::aggregator() const {
+    return d->m_aggregator;
+}
+
+bool FilterByCategories::includesCategory(int categoryIndex) const {
+    return categoryIndex >= 0 && categoryIndex < d->m_included.size() && d->m_included.testBit(categoryIndex);
+}
+
+QList<int> FilterByCategories::categoryIndexes() const {
+    QList<int> rv;
+    for (int category = 0; category < d->m_included.size(); ++category) {
+        if (d->m_included.testBit(category)) {
+            rv << category;
+        }
+    }
+    return rv;
+}
+
+} // namespace qdatacube
+
+#include "filterbycategories.moc"
@@ -0,0 +1,76 @@
+#ifndef FILTER_BY_CATEGORIES_H
+#define FILTER_BY_CATEGORIES_H
+
+#include "abstractaggregator.h"
+#include "abstractfilter.h"
+#include "qdatacube_export.h"
+
+#include <QStringList>
+
+namespace qdatacube {
+class FilterByCategoriesPrivate;
+}
+
+namespace qdatacube {
+
+/**
+ * Filter including the rows in any of a set of categories of an aggregator.
+ *
+ * Each row costs one call to the aggregator and one bit test, however many categories are in the set,
+ * unlike an OrFilter of FilterByAggregate's. The categories are remembered by their display text, so
+ * they follow the aggregator as categories are added and removed, and a category in the set that is
+ * removed is included again if it comes back.
+ */
+class QDATACUBE_EXPORT FilterByCategories : public AbstractFilter {
+
+    Q_OBJECT
+
+public:
+
+    /**
+     * Creates a filter to filter in the given categories in the aggregator.
+     */
+    FilterByCategories(AbstractAggregator::Ptr aggregator, const QList<int>& categoryIndexes);
+
+    /**
+     * Creates a filter to filter in the categories in the aggregator with the given display texts.
+     * Texts not found in the aggregator are kept, and included once the aggregator gets such a category.
+     */
+    FilterByCategories(AbstractAggregator::Ptr aggregator, const QStringList& categoryLabels);
+
+    virtual ~FilterByCategories();
+
+    // Inherited:
+    virtual bool operator()(int row) const;
+    virtual bool isThreadSafe() const;
+    virtual bool hasIncludedRows() const;
+    virtual QVector<int> includedRows() const;
+    virtual void evaluate(int begin, int end, quint64* included) const;
+
+    // Getters:
+    AbstractAggregator::Ptr aggregator() const;
+
+    /**
+     * @return true if the category with index categoryIndex is included
+     */
+    bool includesCategory(int categoryIndex) const;
+
+    /**
+     * @return the indexes of the included categories, in ascending order
+     */
+    QList<int> categoryIndexes() const;
+
+private Q_SLOTS:
+    void slot_aggregator_category_inserted(int index);
+    void slot_aggregator_category_removed(int index);
+
+private:
+    QScopedPointer<FilterByCategoriesPrivate> d;
+
+private:
+    friend FilterByCategoriesPrivate;
+};
+
+} // namespace qdatacube
+
+#endif // FILTER_BY_CATEGORIES_H
@@ -0,0 +1,196 @@
+#include "filtercache.h"
+
+namespace qdatacube {
+
+namespace {
+
+/**
+ * @return index of the lowest set bit of word, which must be non-zero
+ */
+int lowest_bit(quint64 word) {
+  return int(qPopulationCount((word & (~word + 1)) - 1));
+}
+
+}
+
+FilterCache::FilterCache()
+{
+}
+
+void FilterCache::reset(int nelements) {
+  m_rejects.clear();
+  m_reject_counts = QVector<int>(nelements);
+  m_unknown.clear();
+  m_unknown_counts = QVector<int>(nelements);
+}
+
+void FilterCache::resize(int nelements) {
+  if (nelements < m_reject_counts.size()) {
+    for (int element = nelements; element < m_reject_counts.size(); ++element) {
+      removeElement(element);
+    }
+  }
+  m_reject_counts.resize(nelements);
+  m_unknown_counts.resize(nelements);
+  const int nwords = (nelements + 63) >> 6;
+  for (int filter = 0; filter < m_rejects.size(); ++filter) {
+    m_rejects[filter].resize(nwords);
+    m_unknown[filter].resize(nwords);
+  }
+}
+
+int FilterCache::rejectedCount(int filter) const {
+  int rv = 0;
+  Q_FOREACH(quint64 word, m_rejects.at(filter)) {
+    rv += qPopulationCount(word);
+  }
+  return rv;
+}
+
+void FilterCache::set_bit(QVector<quint64>& words, QVector<int>& counts, int element, bool set) {
+  quint64& word = words[element >> 6];
+  const quint64 bit = Q_UINT64_C(1) << (element & 63);
+  if (bool(word & bit) == set) {
+    return;
+  }
+  word ^= bit;
+  counts[element] += set ? 1 : -1;
+}
+
+void FilterCache::setRejected(int filter, int element, bool rejected) {
+  if (element >= m_reject_counts.size()) {
+    resize(qMax(element + 1, m_reject_counts.size() * 2));
+  }
+  set_bit(m_unknown[filter], m_unknown_counts, element, false);
+  set_bit(m_rejects[filter], m_reject_counts, element, rejected);
+}
+
+void FilterCache::setUnknown(int filter, int element) {
+  if (element >= m_reject_counts.size()) {
+    resize(qMax(element + 1, m_reject_counts.size() * 2));
+  }
+  set_bit(m_rejects[filter], m_reject_counts, element, false);
+  set_bit(m_unknown[filter], m_unknown_counts, element, true);
+}
+
+QVector<quint64> FilterCache::excluded(int except) const {
+  QVector<quint64> rv((m_reject_counts.size() + 63) >> 6);
+  for (int filter = 0; filter < m_rejects.size(); ++filter) {
+    if (filter == except) {
+      continue;
+    }
+    const QVector<quint64>& words = m_rejects.at(filter);
+    for (int word_index = 0; word_index < words.size(); ++word_index) {
+      rv[word_index] |= words.at(word_index);
+    }
+  }
+  return rv;
+}
+
+void FilterCache::removeElement(int element) {
+  if (element >= m_reject_counts.size() || (m_reject_counts.at(element) == 0 && m_unknown_counts.at(element) == 0)) {
+    return;
+  }
+  const quint64 bit = Q_UINT64_C(1) << (element & 63);
+  for (int filter = 0; filter < m_rejects.size(); ++filter) {
+    m_rejects[filter][element >> 6] &= ~bit;
+    m_unknown[filter][element >> 6] &= ~bit;
+  }
+  m_reject_counts[element] = 0;
+  m_unknown_counts[element] = 0;
+}
+
+QList< int > FilterCache::appendFilter(const QVector< quint64 >& rejected, const QVector< quint64 >& unknown) {
+  if ((qMax(rejected.size(), unknown.size()) << 6) > m_reject_counts.size()) {
+    resize(qMax(rejected.size(), unknown.size()) << 6);
+  }
+  const int nwords = (m_reject_counts.size() + 63) >> 6;
+  QVector<quint64> words = rejected;
+  words.resize(nwords);
+  QList<int> rv;
+  for (int word_index = 0; word_index < words.size(); ++word_index) {
+    for (quint64 word = words.at(word_index); word; word &= word - 1) {
+      const int element = (word_index << 6) + lowest_bit(word);
+      if (m_reject_counts[element]++ == 0) {
+        rv << element;
+      }
+    }
+  }
+  QVector<quint64> unknown_words = unknown;
+  unknown_words.resize(nwords);
+  for (int word_index = 0; word_index < unknown_words.size(); ++word_index) {
+    Q_ASSERT(!(unknown_words.at(word_index) & words.at(word_index)));
+    for (quint64 word = unknown_words.at(word_index); word; word &= word - 1) {
+      const int element = (word_index << 6) + lowest_bit(word);
+      Q_ASSERT(m_reject_counts.at(element) > 0);
+      ++m_unknown_counts[element];
+    }
+  }
+  m_rejects << words;
+  m_unknown << unknown_words;
+  return rv;
+}
+
+QList< int > FilterCache::removeFilter(int filter) {
+  const QVector<quint64> words = m_rejects.at(filter);
+  const QVector<quint64> unknown_words = m_unknown.at(filter);
+  m_rejects.remove(filter);
+  m_unknown.remove(filter);
+  for (int word_index = 0; word_index < unknown_words.size(); ++word_index) {
+    for (quint64 word = unknown_words.at(word_index); word; word &= word - 1) {
+      --m_unknown_counts[(word_index << 6) + lowest_bit(word)];
+    }
+  }
+  QList<int> rv;
+  for (int word_index = 0; word_index < words.size(); ++word_index) {
+    for (quint64 word = words.at(word_index); word; word &= word - 1) {
+      const int element = (word_index << 6) + lowest_bit(word);
+      if (--m_reject_counts[element] == 0) {
+        rv << element;
+      }
+    }
+  }
+  return rv;
+}
+
+void FilterCache::replaceFilter(int filter, const QVector<quint64>& rejected, const QVector<quint64>& unknown,
+                                QList<int>& excluded, QList<int>& included) {
+  if ((qMax(rejected.size(), unknown.size()) << 6) > m_reject_counts.size()) {
+    resize(qMax(rejected.size(), unknown.size()) << 6);
+  }
+  const int nwords = (m_reject_counts.size() + 63) >> 6;
+  QVector<quint64> words = rejected;
+  words.resize(nwords);
+  QVector<quint64> unknown_words = unknown;
+  unknown_words.resize(nwords);
+  excluded.clear();
+  included.clear();
+  QVector<quint64>& old_words = m_rejects[filter];
+  QVector<quint64>& old_unknown_words = m_unknown[filter];
+  for (int word_index = 0; word_index < nwords; ++word_index) {
+    Q_ASSERT(!(unknown_words.at(word_index) & words.at(word_index)));
+    // Only the bits that changed are visited
+    for (quint64 word = old_words.at(word_index) & ~words.at(word_index); word; word &= word - 1) {
+      const int element = (word_index << 6) + lowest_bit(word);
+      if (--m_reject_counts[element] == 0) {
+        included << element;
+      }
+    }
+    for (quint64 word = words.at(word_index) & ~old_words.at(word_index); word; word &= word - 1) {
+      const int element = (word_index << 6) + lowest_bit(word);
+      if (m_reject_counts[element]++ == 0) {
+        excluded << element;
+      }
+    }
+    for (quint64 word = old_unknown_words.at(word_index) & ~unknown_words.at(word_index); word; word &= word - 1) {
+      --m_unknown_counts[(word_index << 6) + lowest_bit(word)];
+    }
+    for (quint64 word = unknown_words.at(word_index) & ~old_unknown_words.at(word_index); word; word &= word - 1) {
+      ++m_unknown_counts[(word_index << 6) + lowest_bit(word)];
+    }
+  }
+  old_words = words;
+  old_unknown_words = unknown_words;
+}
+
+} // end of namespace
@@ -0,0 +1,141 @@
+#ifndef QDATACUBE_FILTERCACHE_H
+#define QDATACUBE_FILTERCACHE_H
+
+#include <QList>
+#include <QVector>
+
+namespace qdatacube {
+
+/**
+ * The results of the filters of a datacube, indexed by element (element ids, see ElementMap).
+ *
+ * Each filter has a bitset of the elements it rejects, and each element a count of the filters rejecting it,
+ * so an element is included when its count is 0. Adding or removing a filter is then a pass over the words of
+ * its bitset, skipping the elements it does not reject, instead of calling the filters again.
+ *
+ * Filters need not be evaluated for elements another filter already rejects. Such results are unknown, with a
+ * bit per filter and a count per element like the rejects. An element with unknown results must be rejected
+ * by some filter, so when removing a filter leaves it with no rejects, the unknown filters must be evaluated.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class FilterCache {
+    public:
+        FilterCache();
+
+        /**
+         * Forget all filters, and make room for nelements elements
+         */
+        void reset(int nelements);
+
+        /**
+         * Set the number of elements the cache can hold. New elements are rejected by no filter
+         */
+        void resize(int nelements);
+
+        /**
+         * @return number of filters
+         */
+        int filterCount() const {
+            return m_rejects.size();
+        }
+
+        /**
+         * @return true if no filter rejects element
+         */
+        bool isIncluded(int element) const {
+            return element >= m_reject_counts.size() || m_reject_counts.at(element) == 0;
+        }
+
+        /**
+         * @return number of filters rejecting element
+         */
+        int rejectCount(int element) const {
+            return element < m_reject_counts.size() ? m_reject_counts.at(element) : 0;
+        }
+
+        /**
+         * @return true if filter rejects element
+         */
+        bool rejects(int filter, int element) const {
+            const QVector<quint64>& words = m_rejects.at(filter);
+            return (element >> 6) < words.size() && (words.at(element >> 6) & (Q_UINT64_C(1) << (element & 63)));
+        }
+
+        /**
+         * @return number of elements filter rejects
+         */
+        int rejectedCount(int filter) const;
+
+        /**
+         * @return true if it is unknown whether filter rejects element
+         */
+        bool isUnknown(int filter, int element) const {
+            const QVector<quint64>& words = m_unknown.at(filter);
+            return (element >> 6) < words.size() && (words.at(element >> 6) & (Q_UINT64_C(1) << (element & 63)));
+        }
+
+        /**
+         * @return true if it is unknown whether some filter rejects element
+         */
+        bool hasUnknown(int element) const {
+            return element < m_unknown_counts.size() && m_unknown_counts.at(element) > 0;
+        }
+
+        /**
+         * Set whether filter rejects element, which is then known
+         */
+        void setRejected(int filter, int element, bool rejected);
+
+        /**
+         * Forget whether filter rejects element, as it was not evaluated
+         */
+        void setUnknown(int filter, int element);
+
+        /**
+         * @return bitset of the elements some filter other than except rejects, in 64 bit words
+         */
+        QVector<quint64> excluded(int except = -1) const;
+
+        /**
+         * Forget element, e.g. as its row is removed, so it is rejected by no filter
+         */
+        void removeElement(int element);
+
+        /**
+         * Add a filter rejecting the elements set in rejected, a bitset in 64 bit words, growing the cache if needed.
+         * The elements set in unknown, which must be excluded already, were not evaluated.
+         * @return the elements the filter excludes, that is, the rejected elements no other filter rejects, ascending
+         */
+        QList<int> appendFilter(const QVector<quint64>& rejected, const QVector<quint64>& unknown = QVector<quint64>());
+
+        /**
+         * Remove filter
+         * @return the elements left with no rejects by removing it, that is, the elements only it rejected, ascending.
+         * Those with unknown filters (see hasUnknown()) must be evaluated before they are included
+         */
+        QList<int> removeFilter(int filter);
+
+        /**
+         * Replace the results of filter by rejected and unknown, as for appendFilter(). Only the elements whose
+         * results differ are touched.
+         * @param excluded set to the elements now rejected that were included before, ascending
+         * @param included set to the elements now left with no rejects that were rejected before, ascending.
+         * As for removeFilter(), those with unknown filters must be evaluated before they are included
+         */
+        void replaceFilter(int filter, const QVector<quint64>& rejected, const QVector<quint64>& unknown,
+                           QList<int>& excluded, QList<int>& included);
+
+    private:
+        /**
+         * Set bit of element in the words of filter, counting it in counts
+         */
+        static void set_bit(QVector<quint64>& words, QVector<int>& counts, int element, bool set);
+        QVector<QVector<quint64> > m_rejects; // for each filter, a bit per element it rejects
+        QVector<int> m_reject_counts; // for each element, the number of filters rejecting it
+        QVector<QVector<quint64> > m_unknown; // for each filter, a bit per element it was not evaluated for
+        QVector<int> m_unknown_counts; // for each element, the number of filters not evaluated for it
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_FILTERCACHE_H
@@ -0,0 +1,100 @@
+#include "filtercombination.h"
+
+#include "filterprogram.h"
+
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+namespace qdatacube {
+
+FilterCombination::FilterCombination(FilterOrder::Mode mode)
+  : m_order(mode), m_decisive(mode == FilterOrder::StopOnPass), m_adaptive(false)
+{
+}
+
+FilterCombination::~FilterCombination()
+{
+}
+
+void FilterCombination::append(AbstractFilter::Ptr filter) {
+  m_filters.append(filter);
+  m_order.append();
+  m_program.clear();
+}
+
+bool FilterCombination::operator()(int row) const {
+  if (m_adaptive) {
+    const bool timed = m_order.beginEvaluation();
+    const QVector<int>& order = m_order.order();
+    QElapsedTimer timer;
+    for (int position = 0; position < order.size(); ++position) {
+      const int index = order.at(position);
+      if (timed) {
+        timer.start();
+      }
+      const bool passed = (*m_filters.at(index))(row);
+      m_order.record(index, passed, timed ? timer.nsecsElapsed() : -1);
+      if (passed == m_decisive) {
+        return m_decisive;
+      }
+    }
+    return !m_decisive;
+  }
+  for (int index = 0, count = m_filters.size(); index < count; ++index) {
+    if ((*m_filters.at(index))(row) == m_decisive) {
+      return m_decisive;
+    }
+  }
+  return !m_decisive;
+}
+
+void FilterCombination::evaluate(const AbstractFilter& filter, int begin, int end, quint64* included) const {
+  QSharedPointer<const FilterProgram> program;
+  {
+    QMutexLocker lock(&m_program_lock);
+    if (m_program.isNull()) {
+      m_program = QSharedPointer<const FilterProgram>(new FilterProgram(filter));
+    }
+    // Adaptive filters may reorder now. They are never thread safe, so no other thread is using the program
+    m_program->beginEvaluations(end - begin);
+    if (!m_program->isCurrent()) {
+      m_program = QSharedPointer<const FilterProgram>(new FilterProgram(filter));
+    }
+    program = m_program;
+  }
+  program->evaluate(begin, end, included);
+}
+
+void FilterCombination::beginEvaluations(int count) const {
+  if (m_adaptive) {
+    m_order.beginEvaluations(count);
+  }
+}
+
+void FilterCombination::record(int index, int count, int passes, qint64 nsecs) const {
+  if (m_adaptive) {
+    m_order.record(index, count, passes, nsecs);
+  }
+}
+
+bool FilterCombination::isThreadSafe() const {
+  if (m_adaptive) {
+    return false;
+  }
+  Q_FOREACH(AbstractFilter::Ptr filter, m_filters) {
+    if (!filter->isThreadSafe()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+QList<FilterStatistics> FilterCombination::statistics() const {
+  QList<FilterStatistics> rv;
+  for (int index = 0; index < m_order.count(); ++index) {
+    rv << m_order.statistics(index);
+  }
+  return rv;
+}
+
+} // end of namespace
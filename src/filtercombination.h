@@ -0,0 +1,110 @@
+#ifndef QDATACUBE_FILTERCOMBINATION_H
+#define QDATACUBE_FILTERCOMBINATION_H
+
+#include "abstractfilter.h"
+#include "filterorder.h"
+
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+
+namespace qdatacube {
+
+class FilterProgram;
+
+/**
+ * The filters combined by an AndFilter or an OrFilter, evaluated with short circuiting: when stopping on reject,
+ * a row is rejected by the first filter rejecting it, and when stopping on pass, included by the first filter
+ * passing it.
+ *
+ * An adaptive combination evaluates its filters in the order kept by a FilterOrder, recording each evaluation
+ * there, so it changes as it is evaluated and is never thread safe. The order and the compiled program are
+ * only caches of how to evaluate the filters, so they are mutable and evaluation is const. Otherwise the filters are evaluated in
+ * the order they were added.
+ * Batches of rows are evaluated by a FilterProgram, compiled when first needed and kept until the filters or
+ * their order change.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class FilterCombination {
+    public:
+        explicit FilterCombination(FilterOrder::Mode mode);
+
+        ~FilterCombination();
+
+        /**
+         * Add filter last
+         */
+        void append(AbstractFilter::Ptr filter);
+
+        /**
+         * @return the filters, in the order they were added
+         */
+        const QList<AbstractFilter::Ptr>& filters() const {
+            return m_filters;
+        }
+
+        /**
+         * @return combined result of the filters for row
+         */
+        bool operator()(int row) const;
+
+        /**
+         * Evaluate the rows from begin up to (not including) end as AbstractFilter::evaluate(), with filter being
+         * the AndFilter or OrFilter combining the filters
+         */
+        void evaluate(const AbstractFilter& filter, int begin, int end, quint64* included) const;
+
+        /**
+         * @return indexes of the filters in evaluation order
+         */
+        const QVector<int>& order() const {
+            return m_order.order();
+        }
+
+        /**
+         * @return number that changes whenever filters() or order() do
+         */
+        int revision() const {
+            return m_order.revision();
+        }
+
+        /**
+         * If adaptive, start a batch of count evaluations, see FilterOrder::beginEvaluations()
+         */
+        void beginEvaluations(int count) const;
+
+        /**
+         * If adaptive, record a batch evaluation of filter index, see FilterOrder::record()
+         */
+        void record(int index, int count, int passes, qint64 nsecs) const;
+
+        /**
+         * @return true if all the filters are thread safe, and the combination is not adaptive
+         */
+        bool isThreadSafe() const;
+
+        /**
+         * @return statistics of the filters, in the order they were added
+         */
+        QList<FilterStatistics> statistics() const;
+
+        void setAdaptive(bool adaptive) {
+            m_adaptive = adaptive;
+        }
+
+        bool isAdaptive() const {
+            return m_adaptive;
+        }
+
+    private:
+        QList<AbstractFilter::Ptr> m_filters;
+        mutable FilterOrder m_order; // evaluation order of m_filters, learned while evaluating if adaptive
+        bool m_decisive; // the result of a filter that decides the combination
+        bool m_adaptive;
+        mutable QSharedPointer<const FilterProgram> m_program; // null until compiled
+        mutable QMutex m_program_lock; // as thread safe filters are evaluated in parallel
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_FILTERCOMBINATION_H
@@ -0,0 +1,146 @@
+#include "filterorder.h"
+
+#include <algorithm>
+
+namespace qdatacube {
+
+namespace {
+
+const int reorder_interval = 1024;
+const unsigned sample_interval = 16;
+// Counts are halved beyond this many evaluations of a filter
+const qint64 max_evaluations = Q_INT64_C(1) << 16;
+
+/**
+ * Orders filter indexes by their ranks, computed once up front
+ */
+struct RankLess {
+    RankLess(const QVector<double>& ranks) : m_ranks(ranks) {}
+    bool operator()(int lhs, int rhs) const {
+        return m_ranks.at(lhs) < m_ranks.at(rhs);
+    }
+    const QVector<double>& m_ranks;
+};
+
+}
+
+FilterOrder::FilterOrder(Mode mode) : m_mode(mode), m_evaluations(0), m_revision(0), m_sample(0)
+{
+}
+
+void FilterOrder::reset(int count) {
+  m_counts = QVector<Counts>(count);
+  m_order.resize(count);
+  for (int index = 0; index < count; ++index) {
+    m_order[index] = index;
+    m_counts[index].position = index;
+  }
+  m_evaluations = 0;
+  ++m_revision;
+}
+
+void FilterOrder::append() {
+  const int index = m_counts.size();
+  m_counts << Counts();
+  m_counts.last().position = index;
+  m_order << index;
+  ++m_revision;
+}
+
+void FilterOrder::remove(int index) {
+  m_order.remove(m_counts.at(index).position);
+  m_counts.remove(index);
+  for (int position = 0; position < m_order.size(); ++position) {
+    if (m_order.at(position) > index) {
+      --m_order[position];
+    }
+    m_counts[m_order.at(position)].position = position;
+  }
+  ++m_revision;
+}
+
+void FilterOrder::clear(int index) {
+  const int position = m_counts.at(index).position;
+  m_counts[index] = Counts();
+  m_counts[index].position = position;
+}
+
+bool FilterOrder::beginEvaluation() {
+  if (++m_evaluations >= reorder_interval) {
+    reorder();
+  }
+  return ++m_sample % sample_interval == 0;
+}
+
+void FilterOrder::beginEvaluations(int count) {
+  m_evaluations += count;
+  if (m_evaluations >= reorder_interval) {
+    reorder();
+  }
+}
+
+void FilterOrder::record(int index, bool passed, qint64 nsecs) {
+  Counts& counts = m_counts[index];
+  if (counts.evaluations >= max_evaluations) {
+    counts.evaluations /= 2;
+    counts.passes /= 2;
+    counts.timed_evaluations /= 2;
+    counts.nsecs /= 2;
+  }
+  ++counts.evaluations;
+  if (passed) {
+    ++counts.passes;
+  }
+  if (nsecs >= 0) {
+    ++counts.timed_evaluations;
+    // One nanosecond more, so a timed filter never looks free
+    counts.nsecs += nsecs + 1;
+  }
+}
+
+void FilterOrder::record(int index, int count, int passes, qint64 nsecs) {
+  Counts& counts = m_counts[index];
+  while (counts.evaluations >= max_evaluations) {
+    counts.evaluations /= 2;
+    counts.passes /= 2;
+    counts.timed_evaluations /= 2;
+    counts.nsecs /= 2;
+  }
+  counts.evaluations += count;
+  counts.passes += passes;
+  counts.timed_evaluations += count;
+  counts.nsecs += nsecs + count;
+}
+
+FilterStatistics FilterOrder::statistics(int index) const {
+  const Counts& counts = m_counts.at(index);
+  return FilterStatistics(counts.evaluations, counts.passes, counts.timed_evaluations, counts.nsecs,
+                          counts.position);
+}
+
+double FilterOrder::rank(int index) const {
+  const Counts& counts = m_counts.at(index);
+  const double pass_rate = (counts.passes + 1.0)/(counts.evaluations + 2.0);
+  const double cost = counts.timed_evaluations > 0 ? double(counts.nsecs)/counts.timed_evaluations : 0.0;
+  return cost/(m_mode == StopOnReject ? 1.0 - pass_rate : pass_rate);
+}
+
+void FilterOrder::reorder() {
+  m_evaluations = 0;
+  QVector<double> ranks(m_counts.size());
+  for (int index = 0; index < m_counts.size(); ++index) {
+    ranks[index] = rank(index);
+  }
+  const QVector<int> order = m_order;
+  // Stable, so filters that are alike stay as they are
+  std::stable_sort(m_order.begin(), m_order.end(), RankLess(ranks));
+  if (m_order == order) {
+    return;
+  }
+  for (int position = 0; position < m_order.size(); ++position) {
+    m_counts[m_order.at(position)].position = position;
+  }
+  ++m_revision;
+}
+
+} // end of namespace
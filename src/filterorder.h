@@ -0,0 +1,124 @@
+#ifndef QDATACUBE_FILTERORDER_H
+#define QDATACUBE_FILTERORDER_H
+
+#include "filterstatistics.h"
+
+#include <QVector>
+
+namespace qdatacube {
+
+/**
+ * Adaptive evaluation order of a list of filters that are combined with short circuiting, e.g. the children
+ * of an AndFilter, which stop at the first filter rejecting a row.
+ *
+ * The evaluations are recorded per filter, and every reorder_interval evaluations the filters are sorted by
+ * expected cost per decision: cost/(1-pass rate) when stopping on reject, cost/pass rate when stopping on pass,
+ * with the pass rate smoothed by one pass and one reject. Filters not timed yet count as free, so they are tried early.
+ * Only every sample_interval'th evaluation is timed, and the counts are halved once they get big, so the
+ * order follows changing data.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class FilterOrder {
+    public:
+        enum Mode {
+            StopOnReject, // the filters are and'ed
+            StopOnPass // the filters are or'ed
+        };
+
+        explicit FilterOrder(Mode mode = StopOnReject);
+
+        /**
+         * Forget all filters and statistics, and set up count filters in index order
+         */
+        void reset(int count);
+
+        /**
+         * Add a filter last, with the index count()
+         */
+        void append();
+
+        /**
+         * Remove the filter with index, renumbering those after it
+         */
+        void remove(int index);
+
+        /**
+         * Forget the statistics of filter index, e.g. as it was replaced by another filter. It keeps its position
+         * until the next reorder
+         */
+        void clear(int index);
+
+        /**
+         * @return number of filters
+         */
+        int count() const {
+            return m_counts.size();
+        }
+
+        /**
+         * @return filter indexes in evaluation order
+         */
+        const QVector<int>& order() const {
+            return m_order;
+        }
+
+        /**
+         * @return number that changes whenever order() does
+         */
+        int revision() const {
+            return m_revision;
+        }
+
+        /**
+         * Start an evaluation of the combined filters, reordering them first if it is time to
+         * @return true if the filters evaluated should be timed
+         */
+        bool beginEvaluation();
+
+        /**
+         * Start a batch of count evaluations of the combined filters, reordering them first if it is time to.
+         * The filters evaluated are recorded as batches, see record()
+         */
+        void beginEvaluations(int count);
+
+        /**
+         * Record an evaluation of filter index, with its result and its time in nanoseconds, or -1 if not timed
+         */
+        void record(int index, bool passed, qint64 nsecs);
+
+        /**
+         * Record a batch of count evaluations of filter index, passes of which passed, taking nsecs nanoseconds in all
+         */
+        void record(int index, int count, int passes, qint64 nsecs);
+
+        /**
+         * Sort the filters by expected cost now
+         */
+        void reorder();
+
+        /**
+         * @return statistics of filter index
+         */
+        FilterStatistics statistics(int index) const;
+
+    private:
+        struct Counts {
+            Counts() : evaluations(0), passes(0), timed_evaluations(0), nsecs(0), position(0) {}
+            qint64 evaluations;
+            qint64 passes;
+            qint64 timed_evaluations;
+            qint64 nsecs;
+            int position;
+        };
+        double rank(int index) const;
+        Mode m_mode;
+        QVector<Counts> m_counts; // by filter index
+        QVector<int> m_order;
+        int m_evaluations; // since the last reorder
+        int m_revision;
+        unsigned m_sample; // counts evaluations to time every sample_interval'th
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_FILTERORDER_H
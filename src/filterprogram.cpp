@@ -0,0 +1,191 @@
+#include "filterprogram.h"
+
+#include "andfilter.h"
+#include "filtercombination.h"
+#include "orfilter.h"
+
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <algorithm>
+
+namespace qdatacube {
+
+namespace {
+
+const quint64 all_rows = ~quint64(0);
+
+/**
+ * @return the bits of the last word of a batch of nrows rows that are rows
+ */
+quint64 last_word(int nrows) {
+  return nrows & 63 ? (quint64(1) << (nrows & 63)) - 1 : all_rows;
+}
+
+/**
+ * @return number of rows included in the nwords words of included
+ */
+int count_rows(const quint64* included, int nwords) {
+  int rv = 0;
+  for (int word = 0; word < nwords; ++word) {
+    rv += qPopulationCount(included[word]);
+  }
+  return rv;
+}
+
+}
+
+FilterProgram::FilterProgram(const AbstractFilter& filter) : m_depth(0)
+{
+  Node root;
+  root.kind = kind(&filter);
+  root.filter = &filter;
+  m_nodes << root;
+  compile();
+}
+
+FilterProgram::Kind FilterProgram::kind(const AbstractFilter* filter) {
+  if (qobject_cast<const AndFilter*>(filter)) {
+    return And;
+  }
+  if (qobject_cast<const OrFilter*>(filter)) {
+    return Or;
+  }
+  return Leaf;
+}
+
+const FilterCombination& FilterProgram::combination(const AbstractFilter* filter) {
+  if (const AndFilter* and_filter = qobject_cast<const AndFilter*>(filter)) {
+    return and_filter->combination();
+  }
+  return static_cast<const OrFilter*>(filter)->combination();
+}
+
+void FilterProgram::compile() {
+  QVector<int> depths(1, 0);
+  // Breadth first, so the children of each node are appended together
+  for (int node = 0; node < m_nodes.size(); ++node) {
+    if (m_nodes.at(node).kind == Leaf) {
+      continue;
+    }
+    QVector<Node> children;
+    collect_children(m_nodes.at(node).kind, combination(m_nodes.at(node).filter), children);
+    m_nodes[node].first = m_nodes.size();
+    m_nodes[node].count = children.size();
+    m_nodes << children;
+    depths << QVector<int>(children.size(), depths.at(node) + 1);
+    if (!children.isEmpty()) {
+      m_depth = qMax(m_depth, depths.at(node) + 1);
+    }
+  }
+}
+
+void FilterProgram::collect_children(Kind parent_kind, const FilterCombination& combination, QVector<Node>& children) {
+  const Revision revision = { &combination, combination.revision() };
+  m_revisions << revision;
+  const QVector<int>& order = combination.order();
+  for (int position = 0; position < order.size(); ++position) {
+    const int index = order.at(position);
+    const AbstractFilter* child = combination.filters().at(index).data();
+    const Kind child_kind = kind(child);
+    if (child_kind == parent_kind) {
+      // Merged into the parent
+      collect_children(parent_kind, FilterProgram::combination(child), children);
+    } else {
+      Node n;
+      n.kind = child_kind;
+      n.filter = child;
+      n.parent = &combination;
+      n.index = index;
+      children << n;
+    }
+  }
+}
+
+void FilterProgram::beginEvaluations(int count) const {
+  Q_FOREACH(const Revision& revision, m_revisions) {
+    revision.combination->beginEvaluations(count);
+  }
+}
+
+bool FilterProgram::isCurrent() const {
+  Q_FOREACH(const Revision& revision, m_revisions) {
+    if (revision.combination->revision() != revision.revision) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int FilterProgram::leafCount() const {
+  int rv = 0;
+  for (int node = 0; node < m_nodes.size(); ++node) {
+    if (m_nodes.at(node).kind == Leaf) {
+      ++rv;
+    }
+  }
+  return rv;
+}
+
+void FilterProgram::evaluate(int begin, int end, quint64* included) const {
+  if (begin < end) {
+    // The results of the children of the nodes being evaluated, a level at a time
+    QVector<quint64> scratch(m_depth * ((end - begin + 63) >> 6));
+    evaluate(0, begin, end, included, scratch.data());
+  }
+}
+
+void FilterProgram::evaluate(int node, int begin, int end, quint64* included, quint64* scratch) const {
+  const Node& n = m_nodes.at(node);
+  if (n.kind == Leaf) {
+    n.filter->evaluate(begin, end, included);
+    return;
+  }
+  const int nwords = (end - begin + 63) >> 6;
+  if (n.count == 0) {
+    // An empty and includes every row, an empty or none, just as their operator()
+    std::fill(included, included + nwords, n.kind == And ? all_rows : quint64(0));
+    if (n.kind == And) {
+      included[nwords - 1] = last_word(end - begin);
+    }
+    return;
+  }
+  for (int i = 0; i < n.count; ++i) {
+    if (i > 0 && decided(n.kind, included, end - begin)) {
+      return;
+    }
+    const Node& child = m_nodes.at(n.first + i);
+    quint64* result = i == 0 ? included : scratch;
+    const bool adaptive = child.parent->isAdaptive();
+    QElapsedTimer timer;
+    if (adaptive) {
+      timer.start();
+    }
+    evaluate(n.first + i, begin, end, result, scratch + nwords);
+    if (adaptive) {
+      child.parent->record(child.index, end - begin, count_rows(result, nwords), timer.nsecsElapsed());
+    }
+    if (i == 0) {
+      continue;
+    }
+    for (int word = 0; word < nwords; ++word) {
+      if (n.kind == And) {
+        included[word] &= scratch[word];
+      } else {
+        included[word] |= scratch[word];
+      }
+    }
+  }
+}
+
+bool FilterProgram::decided(Kind kind, const quint64* included, int nrows) {
+  const int nwords = (nrows + 63) >> 6;
+  if (kind == And) {
+    // Every row rejected
+    return std::count(included, included + nwords, quint64(0)) == nwords;
+  }
+  // Every row included
+  return std::count(included, included + nwords - 1, all_rows) == nwords - 1 && included[nwords - 1] == last_word(nrows);
+}
+
+} // end of namespace
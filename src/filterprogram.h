@@ -0,0 +1,96 @@
+#ifndef QDATACUBE_FILTERPROGRAM_H
+#define QDATACUBE_FILTERPROGRAM_H
+
+#include <QVector>
+
+namespace qdatacube {
+
+class AbstractFilter;
+class FilterCombination;
+
+/**
+ * A filter tree of AndFilter and OrFilter over leaf filters, compiled into a flat program that is evaluated
+ * over batches of rows.
+ *
+ * Nested filters of the same kind are merged, e.g. an AndFilter in an AndFilter, and the children of each node are
+ * stored next to each other, so evaluating a batch walks the program once per batch rather than the tree once per row.
+ * Leaves are evaluated with AbstractFilter::evaluate(), and their results are combined a word of 64 rows at a time.
+ * A node stops evaluating its children when the batch is decided, e.g. when all the rows are rejected by an and.
+ * The children are compiled in the evaluation order of the filter combining them, see AndFilter::setAdaptive(),
+ * and the batch evaluations of the children of adaptive filters are recorded there.
+ * The program does not own the filters, so it must not outlive the tree, nor be used once it is not isCurrent().
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class FilterProgram {
+    public:
+        /**
+         * Compile the tree with root filter
+         */
+        explicit FilterProgram(const AbstractFilter& filter);
+
+        /**
+         * Evaluate the rows from begin up to (not including) end, as AbstractFilter::evaluate()
+         */
+        void evaluate(int begin, int end, quint64* included) const;
+
+        /**
+         * Start a batch of count evaluations of the adaptive filters in the tree, which may reorder them
+         */
+        void beginEvaluations(int count) const;
+
+        /**
+         * @return true if no filter in the tree got more filters or a new order since it was compiled
+         */
+        bool isCurrent() const;
+
+        /**
+         * @return number of nodes, and and or nodes included
+         */
+        int size() const {
+            return m_nodes.size();
+        }
+
+        /**
+         * @return number of leaf filters
+         */
+        int leafCount() const;
+
+    private:
+        enum Kind {
+            Leaf,
+            And,
+            Or
+        };
+        struct Node {
+            Node() : kind(Leaf), filter(0), parent(0), index(0), first(0), count(0) {}
+            Kind kind;
+            const AbstractFilter* filter; // the leaf, or the filter an and or or node was compiled from
+            const FilterCombination* parent; // the filters this is one of, 0 for the root
+            int index; // index of filter in parent
+            int first; // first child node
+            int count; // number of children
+        };
+        struct Revision {
+            const FilterCombination* combination;
+            int revision; // of combination when compiled
+        };
+        static Kind kind(const AbstractFilter* filter);
+        static const FilterCombination& combination(const AbstractFilter* filter);
+        void compile();
+        void collect_children(Kind kind, const FilterCombination& combination, QVector<Node>& children);
+        /**
+         * Evaluate node, using nwords words from scratch per level below it
+         */
+        void evaluate(int node, int begin, int end, quint64* included, quint64* scratch) const;
+        /**
+         * @return true if the rows evaluated so far by a node of kind decide all nrows rows
+         */
+        static bool decided(Kind kind, const quint64* included, int nrows);
+        QVector<Node> m_nodes; // the root first
+        QVector<Revision> m_revisions; // of every and and or filter compiled, merged ones included
+        int m_depth; // levels of nodes below the root
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_FILTERPROGRAM_H
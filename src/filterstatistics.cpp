@@ -0,0 +1,62 @@
+#include "filterstatistics.h"
+
+namespace qdatacube {
+
+class FilterStatisticsPrivate : public QSharedData {
+  public:
+    FilterStatisticsPrivate(qint64 evaluations, qint64 passes, qint64 timed_evaluations, qint64 nsecs, int position)
+      : evaluations(evaluations), passes(passes), timed_evaluations(timed_evaluations), nsecs(nsecs), position(position) {}
+    qint64 evaluations;
+    qint64 passes;
+    qint64 timed_evaluations;
+    qint64 nsecs;
+    int position;
+};
+
+FilterStatistics::FilterStatistics() : d(new FilterStatisticsPrivate(0, 0, 0, 0, 0))
+{
+}
+
+FilterStatistics::FilterStatistics(qint64 evaluations, qint64 passes, qint64 timedEvaluations, qint64 nsecs, int position)
+  : d(new FilterStatisticsPrivate(evaluations, passes, timedEvaluations, nsecs, position))
+{
+}
+
+FilterStatistics::FilterStatistics(const FilterStatistics& other) : d(other.d)
+{
+}
+
+FilterStatistics& FilterStatistics::operator=(const FilterStatistics& other) {
+  d = other.d;
+  return *this;
+}
+
+FilterStatistics::~FilterStatistics()
+{
+}
+
+qint64 FilterStatistics::evaluations() const {
+  return d->evaluations;
+}
+
+qint64 FilterStatistics::passes() const {
+  return d->passes;
+}
+
+double FilterStatistics::passRate() const {
+  return d->evaluations > 0 ? double(d->passes)/d->evaluations : 1.0;
+}
+
+qint64 FilterStatistics::timedEvaluations() const {
+  return d->timed_evaluations;
+}
+
+double FilterStatistics::cost() const {
+  return d->timed_evaluations > 0 ? double(d->nsecs)/d->timed_evaluations : 0.0;
+}
+
+int FilterStatistics::position() const {
+  return d->position;
+}
+
+} // end of namespace
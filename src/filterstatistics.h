@@ -0,0 +1,73 @@
+#ifndef QDATACUBE_FILTERSTATISTICS_H
+#define QDATACUBE_FILTERSTATISTICS_H
+
+#include "qdatacube_export.h"
+
+#include <QSharedDataPointer>
+#include <QtGlobal>
+
+namespace qdatacube {
+
+class FilterStatisticsPrivate;
+
+/**
+ * What is known about a filter from evaluating it: how often it passed and how long it took, and where it
+ * currently is in the evaluation order of the filters it is combined with.
+ *
+ * The datacube (see Datacube::filterStatistics()) and the composite filters (see AndFilter::statistics())
+ * evaluate their filters cheapest and most decisive first, as estimated from these numbers. Only a sample
+ * of the evaluations is timed, and older evaluations are gradually forgotten, so the numbers follow the data.
+ */
+class QDATACUBE_EXPORT FilterStatistics {
+    public:
+        /**
+         * Statistics of a filter never evaluated, first in the order
+         */
+        FilterStatistics();
+
+        /**
+         * Statistics of evaluations evaluations, passes of which passed, timedEvaluations of which took
+         * nsecs nanoseconds in all, of a filter at position in the evaluation order
+         */
+        FilterStatistics(qint64 evaluations, qint64 passes, qint64 timedEvaluations, qint64 nsecs, int position);
+        FilterStatistics(const FilterStatistics& other);
+        FilterStatistics& operator=(const FilterStatistics& other);
+        ~FilterStatistics();
+
+        /**
+         * @return number of (recent) evaluations
+         */
+        qint64 evaluations() const;
+
+        /**
+         * @return number of (recent) evaluations that passed, i.e. returned true
+         */
+        qint64 passes() const;
+
+        /**
+         * @return fraction of the evaluations that passed, or 1 if there are none
+         */
+        double passRate() const;
+
+        /**
+         * @return number of (recent) evaluations that were timed
+         */
+        qint64 timedEvaluations() const;
+
+        /**
+         * @return average time of the timed evaluations in nanoseconds, or 0 if none were timed
+         */
+        double cost() const;
+
+        /**
+         * @return position in the evaluation order, 0 being evaluated first
+         */
+        int position() const;
+
+    private:
+        QSharedDataPointer<FilterStatisticsPrivate> d;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_FILTERSTATISTICS_H
@@ -0,0 +1,112 @@
+#include "headerindex.h"
+
+#include "bucketindex.h"
+#include "bucketorder.h"
+
+#include <algorithm>
+
+namespace qdatacube {
+
+HeaderIndex::HeaderIndex()
+{
+}
+
+void HeaderIndex::reset(const QVector<int>& strides) {
+  m_levels = QVector<Level>(strides.size());
+  for (int level = 0; level < strides.size(); ++level) {
+    m_levels[level].stride = strides.at(level);
+  }
+}
+
+void HeaderIndex::invalidate() {
+  for (int level = 0; level < m_levels.size(); ++level) {
+    Level& l = m_levels[level];
+    l.valid = false;
+    l.groups.clear();
+    l.first_sections.clear();
+    l.counts.clear();
+    l.measures.reset(0, 0);
+  }
+}
+
+void HeaderIndex::build(int level, const QVector<unsigned>& counts, const MeasureTotals& bucket_measures, const BucketIndex& index, const BucketOrder& order) {
+  Level& l = m_levels[level];
+  l.groups.clear();
+  l.first_sections.clear();
+  l.counts.clear();
+  l.measures.reset(0, bucket_measures.measureCount());
+  l.nsections = index.count();
+  for (int section = 0; section < l.nsections; ++section) {
+    const int display_bucket = index.select(section);
+    const int group = display_bucket / l.stride;
+    if (l.groups.isEmpty() || l.groups.last() != group) {
+      l.groups << group;
+      l.first_sections << section;
+      l.counts << 0;
+      l.measures.appendGroup();
+    }
+    const int bucket = order.toBucket(display_bucket);
+    l.counts.last() += counts.at(bucket);
+    if (bucket_measures.measureCount() > 0) {
+      l.measures.add(l.groups.size() - 1, bucket_measures.measures(bucket));
+    }
+  }
+  l.valid = true;
+}
+
+void HeaderIndex::refresh(int level, const MeasureTotals& bucket_measures, const BucketOrder& order) {
+  Level& l = m_levels[level];
+  Q_FOREACH(int header_section, l.measures.takeStale()) {
+    l.measures.clear(header_section);
+    const int first_display_bucket = l.groups.at(header_section) * l.stride;
+    for (int display_bucket = first_display_bucket; display_bucket < first_display_bucket + l.stride; ++display_bucket) {
+      // Empty buckets have empty measures, so they can be added too
+      l.measures.add(header_section, bucket_measures.measures(order.toBucket(display_bucket)));
+    }
+  }
+}
+
+int HeaderIndex::find(const Level& l, int display_bucket) {
+  const int group = display_bucket / l.stride;
+  const QVector<int>::const_iterator it = std::lower_bound(l.groups.constBegin(), l.groups.constEnd(), group);
+  Q_ASSERT(it != l.groups.constEnd() && *it == group);
+  return int(it - l.groups.constBegin());
+}
+
+void HeaderIndex::addCount(int display_bucket, int delta) {
+  for (int level = 0; level < m_levels.size(); ++level) {
+    Level& l = m_levels[level];
+    if (!l.valid) {
+      continue;
+    }
+    l.counts[find(l, display_bucket)] += delta;
+  }
+}
+
+void HeaderIndex::addValues(int display_bucket, const MeasureStore& store, int element) {
+  for (int level = 0; level < m_levels.size(); ++level) {
+    Level& l = m_levels[level];
+    if (l.valid && l.measures.measureCount() > 0) {
+      l.measures.add(find(l, display_bucket), store, element);
+    }
+  }
+}
+
+void HeaderIndex::removeValues(int display_bucket, const MeasureStore& store, int element) {
+  for (int level = 0; level < m_levels.size(); ++level) {
+    Level& l = m_levels[level];
+    if (l.valid && l.measures.measureCount() > 0) {
+      l.measures.remove(find(l, display_bucket), store, element);
+    }
+  }
+}
+
+int HeaderIndex::headerSection(int level, int section) const {
+  const Level& l = m_levels.at(level);
+  if (section < 0 || section >= l.nsections) {
+    return -1;
+  }
+  return int(std::upper_bound(l.first_sections.constBegin(), l.first_sections.constEnd(), section) - l.first_sections.constBegin()) - 1;
+}
+
+} // end of namespace
@@ -0,0 +1,158 @@
+#ifndef QDATACUBE_HEADERINDEX_H
+#define QDATACUBE_HEADERINDEX_H
+
+#include "measuretotals.h"
+
+#include <QVector>
+
+namespace qdatacube {
+
+class BucketIndex;
+class BucketOrder;
+class MeasureStore;
+
+/**
+ * The header sections of each header level in one direction of a datacube.
+ *
+ * A header section at a level covers stride consecutive display buckets, a group, and is shown if any of
+ * them is non-empty. For each shown header section, a level keeps its group, the first section it spans,
+ * the number of sections it spans, the number of elements in it and the rolled up measures of its elements,
+ * so the header queries and totals of the datacube are O(1), or O(log n) to find the header section of a section.
+ *
+ * Levels are built on demand. Element counts and measures are patched as elements come and go, while sections
+ * turning empty or non-empty invalidates all levels.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class HeaderIndex {
+    public:
+        HeaderIndex();
+
+        /**
+         * Forget all levels, and set up a level for each stride (the number of buckets in a group)
+         */
+        void reset(const QVector<int>& strides);
+
+        /**
+         * Forget the header sections of all levels, e.g. after a section was inserted or removed
+         */
+        void invalidate();
+
+        /**
+         * @return true if level is built
+         */
+        bool isValid(int level) const {
+            return m_levels.at(level).valid;
+        }
+
+        /**
+         * Build level from counts and measures (indexed by bucket) and the bucket index and order of the same direction.
+         * O(s log n) for s sections
+         */
+        void build(int level, const QVector<unsigned>& counts, const MeasureTotals& bucket_measures, const BucketIndex& index, const BucketOrder& order);
+
+        /**
+         * @return true if level has header sections with stale min and max, see MeasureTotals
+         */
+        bool hasStale(int level) const {
+            return m_levels.at(level).measures.hasStale();
+        }
+
+        /**
+         * Recompute the header sections of level with stale min and max from bucket_measures, which must be up to date
+         */
+        void refresh(int level, const MeasureTotals& bucket_measures, const BucketOrder& order);
+
+        /**
+         * Add delta to the element count of the header sections holding display_bucket, in the levels that are built.
+         * The display bucket must stay non-empty, or become non-empty and be followed by invalidate().
+         */
+        void addCount(int display_bucket, int delta);
+
+        /**
+         * Add the values of element to the measures of the header sections holding display_bucket, in the levels that
+         * are built. As for addCount(), display_bucket must have been non-empty
+         */
+        void addValues(int display_bucket, const MeasureStore& store, int element);
+
+        /**
+         * Remove the values of element from the header sections holding display_bucket, in the levels that are built
+         */
+        void removeValues(int display_bucket, const MeasureStore& store, int element);
+
+        /**
+         * @return number of display buckets in each group of level
+         */
+        int stride(int level) const {
+            return m_levels.at(level).stride;
+        }
+
+        /**
+         * @return number of shown header sections in level
+         */
+        int count(int level) const {
+            return m_levels.at(level).groups.size();
+        }
+
+        /**
+         * @return group (display buckets group*stride to (group+1)*stride-1) of header_section
+         */
+        int group(int level, int header_section) const {
+            return m_levels.at(level).groups.at(header_section);
+        }
+
+        /**
+         * @return first section spanned by header_section
+         */
+        int firstSection(int level, int header_section) const {
+            return m_levels.at(level).first_sections.at(header_section);
+        }
+
+        /**
+         * @return number of sections spanned by header_section
+         */
+        int span(int level, int header_section) const {
+            const Level& l = m_levels.at(level);
+            return (header_section + 1 < l.first_sections.size() ? l.first_sections.at(header_section + 1) : l.nsections)
+                   - l.first_sections.at(header_section);
+        }
+
+        /**
+         * @return number of elements in header_section
+         */
+        int elementCount(int level, int header_section) const {
+            return m_levels.at(level).counts.at(header_section);
+        }
+
+        /**
+         * @return the measures of the elements in header_section, or 0 if there are no measures
+         */
+        const Measure* measures(int level, int header_section) const {
+            return m_levels.at(level).measures.measures(header_section);
+        }
+
+        /**
+         * @return header section spanning section, or -1 if there is no such section
+         */
+        int headerSection(int level, int section) const;
+
+    private:
+        struct Level {
+            Level() : stride(1), nsections(0), valid(false) {}
+            int stride;
+            int nsections;
+            bool valid;
+            QVector<int> groups;
+            QVector<int> first_sections;
+            QVector<int> counts;
+            MeasureTotals measures;
+        };
+        /**
+         * @return index in l of the header section holding display_bucket
+         */
+        static int find(const Level& l, int display_bucket);
+        QVector<Level> m_levels;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_HEADERINDEX_H
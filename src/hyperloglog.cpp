@@ -0,0 +1,167 @@
+#include "hyperloglog.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QtMath>
+
+#include <algorithm>
+
+namespace qdatacube {
+
+class HyperLogLogPrivate : public QSharedData {
+  public:
+    HyperLogLogPrivate(int precision) : precision(precision) {}
+    bool is_exact() const {
+      return registers.isEmpty();
+    }
+    int exact_limit() const {
+      return (1 << precision) / int(sizeof(quint64));
+    }
+    void add_to_registers(quint64 hash);
+    void to_registers();
+    QVector<quint64> hashes; // sorted distinct hashes while exact
+    QByteArray registers; // 2^precision registers once not exact
+    int precision;
+};
+
+HyperLogLog::HyperLogLog(int precision) : d(new HyperLogLogPrivate(precision))
+{
+  Q_ASSERT(precision >= 4 && precision <= 16);
+}
+
+HyperLogLog::HyperLogLog(const HyperLogLog& other) : d(other.d)
+{
+}
+
+HyperLogLog& HyperLogLog::operator=(const HyperLogLog& other) {
+  d = other.d;
+  return *this;
+}
+
+HyperLogLog::~HyperLogLog()
+{
+}
+
+bool HyperLogLog::isExact() const {
+  return d->is_exact();
+}
+
+int HyperLogLog::precision() const {
+  return d->precision;
+}
+
+void HyperLogLog::add(quint64 hash) {
+  HyperLogLogPrivate* p = d.data();
+  if (!p->is_exact()) {
+    p->add_to_registers(hash);
+    return;
+  }
+  const QVector<quint64>::iterator it = std::lower_bound(p->hashes.begin(), p->hashes.end(), hash);
+  if (it != p->hashes.end() && *it == hash) {
+    return;
+  }
+  p->hashes.insert(it, hash);
+  if (p->hashes.size() > p->exact_limit()) {
+    p->to_registers();
+  }
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  Q_ASSERT(other.precision() == precision());
+  const HyperLogLogPrivate* o = other.d.constData();
+  HyperLogLogPrivate* p = d.data();
+  if (o->is_exact()) {
+    if (p->is_exact()) {
+      QVector<quint64> merged(p->hashes.size() + o->hashes.size());
+      merged.resize(int(std::set_union(p->hashes.constBegin(), p->hashes.constEnd(),
+                                       o->hashes.constBegin(), o->hashes.constEnd(), merged.begin()) - merged.begin()));
+      p->hashes = merged;
+      if (p->hashes.size() > p->exact_limit()) {
+        p->to_registers();
+      }
+    } else {
+      Q_FOREACH(quint64 hash, o->hashes) {
+        p->add_to_registers(hash);
+      }
+    }
+    return;
+  }
+  if (p->is_exact()) {
+    const QVector<quint64> hashes = p->hashes;
+    p->hashes.clear();
+    p->registers = o->registers;
+    Q_FOREACH(quint64 hash, hashes) {
+      p->add_to_registers(hash);
+    }
+    return;
+  }
+  char* registers = p->registers.data();
+  const char* other_registers = o->registers.constData();
+  for (int i = 0, n = p->registers.size(); i < n; ++i) {
+    registers[i] = qMax(registers[i], other_registers[i]);
+  }
+}
+
+double HyperLogLog::estimate() const {
+  if (d->is_exact()) {
+    return d->hashes.size();
+  }
+  const int m = d->registers.size();
+  double sum = 0.0;
+  int zeros = 0;
+  for (int i = 0; i < m; ++i) {
+    const int rank = d->registers.at(i);
+    sum += 1.0 / double(Q_UINT64_C(1) << rank);
+    if (rank == 0) {
+      ++zeros;
+    }
+  }
+  const double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+  const double estimate = alpha * m * m / sum;
+  if (estimate <= 2.5 * m && zeros > 0) {
+    // Linear counting is better for small cardinalities
+    return m * qLn(double(m) / zeros);
+  }
+  // With 64 bit hashes, no correction is needed at the high end
+  return estimate;
+}
+
+quint64 HyperLogLog::hash(const QString& value) {
+  // FNV-1a over the UTF-16 code units, then the 64 bit finalizer of MurmurHash3 to mix the bits
+  quint64 h = Q_UINT64_C(14695981039346656037);
+  for (int i = 0, n = value.size(); i < n; ++i) {
+    h ^= value.at(i).unicode();
+    h *= Q_UINT64_C(1099511628211);
+  }
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+void HyperLogLogPrivate::add_to_registers(quint64 hash) {
+  const int index = int(hash >> (64 - precision));
+  // Rank is the position of the first 1 bit in the rest of the hash, which is at most 64 - precision + 1
+  quint64 rest = hash << precision;
+  char rank = 1;
+  while (rank <= 64 - precision && !(rest & (Q_UINT64_C(1) << 63))) {
+    rest <<= 1;
+    ++rank;
+  }
+  if (registers.at(index) < rank) {
+    registers[index] = rank;
+  }
+}
+
+void HyperLogLogPrivate::to_registers() {
+  registers = QByteArray(1 << precision, 0);
+  Q_FOREACH(quint64 hash, hashes) {
+    add_to_registers(hash);
+  }
+  hashes = QVector<quint64>();
+}
+
+} // end of namespace
@@ -0,0 +1,67 @@
+#ifndef QDATACUBE_HYPERLOGLOG_H
+#define QDATACUBE_HYPERLOGLOG_H
+
+#include "qdatacube_export.h"
+
+#include <QSharedDataPointer>
+#include <QtGlobal>
+
+class QString;
+
+namespace qdatacube {
+
+class HyperLogLogPrivate;
+
+/**
+ * Sketch of a set of values for estimating the number of distinct values in it, in fixed memory.
+ *
+ * Small sets are kept exactly, as the sorted hashes of their values, until they would take as much memory as the
+ * 2^precision registers of a HyperLogLog sketch, which has a standard error of about 1.04/sqrt(2^precision).
+ * Sketches of overlapping sets can be merged to the sketch of their union, which is how the distinct counts
+ * a datacube keeps per cell (see Datacube::addDistinctCount()) add up to header sections and totals.
+ */
+class QDATACUBE_EXPORT HyperLogLog {
+    public:
+        /**
+         * Empty sketch
+         * @param precision number of index bits, from 4 to 16
+         */
+        explicit HyperLogLog(int precision = 12);
+        HyperLogLog(const HyperLogLog& other);
+        HyperLogLog& operator=(const HyperLogLog& other);
+        ~HyperLogLog();
+
+        /**
+         * Add a value by its hash, see hash()
+         */
+        void add(quint64 hash);
+
+        /**
+         * Add the values of other, which must have the same precision
+         */
+        void merge(const HyperLogLog& other);
+
+        /**
+         * @return estimated number of distinct values, exact as long as isExact()
+         */
+        double estimate() const;
+
+        /**
+         * @return true if the values are still kept exactly
+         */
+        bool isExact() const;
+
+        int precision() const;
+
+        /**
+         * @return well mixed 64 bit hash of value
+         */
+        static quint64 hash(const QString& value);
+
+    private:
+        QSharedDataPointer<HyperLogLogPrivate> d;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_HYPERLOGLOG_H
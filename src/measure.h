@@ -0,0 +1,142 @@
+#ifndef QDATACUBE_MEASURE_H
+#define QDATACUBE_MEASURE_H
+
+#include <limits>
+#include <QtMath>
+
+namespace qdatacube {
+
+/**
+ * Summary of the values of a column of the underlying model over a set of elements: count, sum, sum of
+ * squares, min and max, from which mean and standard deviation follow.
+ *
+ * Measures of disjoint sets are combined with add(), which is how the measures a datacube keeps per cell
+ * (see Datacube::addMeasure()) add up to header sections and totals.
+ *
+ * Measure is a small value class defined entirely in this header and not exported, so that the datacube can
+ * keep one per cell and measured column without indirection.
+ */
+class Measure {
+    public:
+        /**
+         * Measure of no elements
+         */
+        Measure() : m_count(0), m_sum(0.0), m_sum_of_squares(0.0),
+                    m_min(std::numeric_limits<double>::infinity()), m_max(-std::numeric_limits<double>::infinity()) {}
+
+        /**
+         * Add a value
+         */
+        void add(double value) {
+            ++m_count;
+            m_sum += value;
+            m_sum_of_squares += value*value;
+            if (value < m_min) {
+                m_min = value;
+            }
+            if (value > m_max) {
+                m_max = value;
+            }
+        }
+
+        /**
+         * Add the values of other
+         */
+        void add(const Measure& other) {
+            m_count += other.m_count;
+            m_sum += other.m_sum;
+            m_sum_of_squares += other.m_sum_of_squares;
+            if (other.m_min < m_min) {
+                m_min = other.m_min;
+            }
+            if (other.m_max > m_max) {
+                m_max = other.m_max;
+            }
+        }
+
+        /**
+         * Remove a value added before. The sums are adjusted, but min and max cannot be subtracted.
+         * @return false if value was at the min or the max, which are then left as they were and must be found again,
+         * see setRange(). Removing the last value gives the measure of no elements
+         */
+        bool remove(double value) {
+            if (m_count == 1) {
+                // Start afresh rather than keep the rounding errors of the sums
+                *this = Measure();
+                return true;
+            }
+            --m_count;
+            m_sum -= value;
+            m_sum_of_squares -= value*value;
+            return value > m_min && value < m_max;
+        }
+
+        /**
+         * Set min and max, found again after remove() returned false
+         */
+        void setRange(double min, double max) {
+            m_min = min;
+            m_max = max;
+        }
+
+        int count() const {
+            return m_count;
+        }
+        double sum() const {
+            return m_sum;
+        }
+        double sumOfSquares() const {
+            return m_sum_of_squares;
+        }
+
+        /**
+         * @return smallest value, or +infinity if there are none
+         */
+        double min() const {
+            return m_min;
+        }
+
+        /**
+         * @return largest value, or -infinity if there are none
+         */
+        double max() const {
+            return m_max;
+        }
+
+        /**
+         * @return mean value, or 0 if there are no values
+         */
+        double mean() const {
+            return m_count > 0 ? m_sum/m_count : 0.0;
+        }
+
+        /**
+         * @return sample variance, or 0 if there are less than 2 values
+         */
+        double variance() const {
+            if (m_count < 2) {
+                return 0.0;
+            }
+            // Rounding can make it slightly negative when all values are (nearly) equal
+            const double variance = (m_sum_of_squares - m_sum*m_sum/m_count)/(m_count-1);
+            return variance > 0.0 ? variance : 0.0;
+        }
+
+        /**
+         * @return sample standard deviation, or 0 if there are less than 2 values
+         */
+        double stddev() const {
+            return qSqrt(variance());
+        }
+
+    private:
+        int m_count;
+        double m_sum;
+        double m_sum_of_squares;
+        double m_min;
+        double m_max;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_MEASURE_H
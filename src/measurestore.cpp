@@ -0,0 +1,107 @@
+#include "measurestore.h"
+
+#include "cellstore.h"
+
+namespace qdatacube {
+
+MeasureStore::MeasureStore()
+{
+}
+
+int MeasureStore::addColumn(int column) {
+  Q_ASSERT(indexOf(column) < 0);
+  m_columns << column;
+  m_values << QVector<double>();
+  m_cells.clear();
+  return m_columns.size() - 1;
+}
+
+void MeasureStore::removeColumn(int measure) {
+  m_columns.remove(measure);
+  m_values.remove(measure);
+  for (QHash<long, QVector<Measure> >::iterator it = m_cells.begin(), iend = m_cells.end(); it != iend; ++it) {
+    it->remove(measure);
+  }
+}
+
+void MeasureStore::setValue(int measure, int element, double value) {
+  QVector<double>& values = m_values[measure];
+  if (element >= values.size()) {
+    values.resize(element + 1);
+  }
+  values[element] = value;
+}
+
+void MeasureStore::add(long cell, int element) {
+  QVector<Measure>& measures = m_cells[cell];
+  if (measures.isEmpty()) {
+    measures.resize(m_columns.size());
+  }
+  for (int measure = 0; measure < measures.size(); ++measure) {
+    measures[measure].add(m_values.at(measure).at(element));
+  }
+}
+
+void MeasureStore::remove(long cell, int element, const CellStore& cells) {
+  QHash<long, QVector<Measure> >::iterator it = m_cells.find(cell);
+  Q_ASSERT(it != m_cells.end());
+  QVector<Measure>& measures = *it;
+  if (measures.first().count() == 1) {
+    // Start afresh rather than keep the rounding errors of the sums
+    m_cells.erase(it);
+    return;
+  }
+  const CellStore::const_iterator elements = cells.constFind(cell);
+  for (int measure = 0; measure < measures.size(); ++measure) {
+    Measure& m = measures[measure];
+    if (!m.remove(m_values.at(measure).at(element))) {
+      // Min and max cannot be subtracted, so find them again
+      double min = Measure().min();
+      double max = Measure().max();
+      for (const int* eit = elements.begin(), *eend = elements.end(); eit != eend; ++eit) {
+        if (*eit != element) {
+          const double other = m_values.at(measure).at(*eit);
+          min = qMin(min, other);
+          max = qMax(max, other);
+        }
+      }
+      m.setRange(min, max);
+    }
+  }
+}
+
+void MeasureStore::rebuild(const CellStore& cells) {
+  m_cells.clear();
+  if (m_columns.isEmpty()) {
+    return;
+  }
+  for (CellStore::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+    if (it.begin() == it.end()) {
+      continue;
+    }
+    QVector<Measure>& measures = m_cells[it.key()];
+    measures.resize(m_columns.size());
+    for (int measure = 0; measure < measures.size(); ++measure) {
+      const QVector<double>& values = m_values.at(measure);
+      Measure& m = measures[measure];
+      for (const int* eit = it.begin(), *eend = it.end(); eit != eend; ++eit) {
+        m.add(values.at(*eit));
+      }
+    }
+  }
+}
+
+void MeasureStore::remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows) {
+  QHash<long, QVector<Measure> > cells;
+  cells.reserve(m_cells.size());
+  for (QHash<long, QVector<Measure> >::const_iterator it = m_cells.constBegin(), iend = m_cells.constEnd(); it != iend; ++it) {
+    const long row = row_map.isEmpty() ? it.key() % nrows : row_map.at(it.key() % nrows);
+    const long column = column_map.isEmpty() ? it.key() / nrows : column_map.at(it.key() / nrows);
+    if (row >= 0 && column >= 0) {
+      cells.insert(row + column*new_nrows, it.value());
+    }
+  }
+  m_cells = cells;
+}
+
+} // end of namespace
@@ -0,0 +1,121 @@
+#ifndef QDATACUBE_MEASURESTORE_H
+#define QDATACUBE_MEASURESTORE_H
+
+#include "measure.h"
+
+#include <QHash>
+#include <QVector>
+
+namespace qdatacube {
+
+class CellStore;
+
+/**
+ * The measures a datacube keeps for some columns of the underlying model: the value of each element
+ * in each of those columns, and a Measure per column for each non-empty cell.
+ *
+ * The measures of a cell are updated as elements are added and removed, in O(1) except when the smallest
+ * or largest value of a cell is removed, where min and max are found again from the remaining elements.
+ * Operations moving all elements around, like split and collapse, rebuild the measures from the cells.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class MeasureStore {
+    public:
+        MeasureStore();
+
+        /**
+         * @return true if no columns are measured
+         */
+        bool isEmpty() const {
+            return m_columns.isEmpty();
+        }
+
+        /**
+         * @return number of columns measured
+         */
+        int count() const {
+            return m_columns.size();
+        }
+
+        /**
+         * @return the column of the underlying model of measure
+         */
+        int column(int measure) const {
+            return m_columns.at(measure);
+        }
+
+        /**
+         * @return the measure of column, or -1 if it is not measured
+         */
+        int indexOf(int column) const {
+            return m_columns.indexOf(column);
+        }
+
+        /**
+         * Start measuring column. The values of the elements must be set, and the measures rebuilt, before use
+         * @return the new measure
+         */
+        int addColumn(int column);
+
+        /**
+         * Stop measuring measure
+         */
+        void removeColumn(int measure);
+
+        /**
+         * Set the value of element for measure. Should not be called while element is in a cell
+         */
+        void setValue(int measure, int element, double value);
+
+        /**
+         * @return the value of element for measure
+         */
+        double value(int measure, int element) const {
+            return m_values.at(measure).at(element);
+        }
+
+        /**
+         * Add the values of element to the measures of cell
+         */
+        void add(long cell, int element);
+
+        /**
+         * Remove the values of element from the measures of cell. The elements of cells are used to find min
+         * and max again if needed; element itself is skipped there, so it may or may not still be in the cell
+         */
+        void remove(long cell, int element, const CellStore& cells);
+
+        /**
+         * Forget the measures of cell, which is emptied at once
+         */
+        void erase(long cell) {
+            m_cells.remove(cell);
+        }
+
+        /**
+         * Recompute the measures of all cells from the values of their elements
+         */
+        void rebuild(const CellStore& cells);
+
+        /**
+         * Move the measures of the cells to new bucket coordinates, as CellStore::remap(), without recomputing them
+         */
+        void remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows);
+
+        /**
+         * @return the measures of cell, one per measured column, or 0 if cell is empty
+         */
+        const Measure* find(long cell) const {
+            QHash<long, QVector<Measure> >::const_iterator it = m_cells.constFind(cell);
+            return it == m_cells.constEnd() ? 0 : it->constData();
+        }
+
+    private:
+        QVector<int> m_columns;
+        QVector<QVector<double> > m_values; // per measure, indexed by element
+        QHash<long, QVector<Measure> > m_cells;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_MEASURESTORE_H
@@ -0,0 +1,97 @@
+#include "measuretotals.h"
+
+#include "measurestore.h"
+
+#include <algorithm>
+
+namespace qdatacube {
+
+MeasureTotals::MeasureTotals() : m_ngroups(0), m_nmeasures(0)
+{
+}
+
+void MeasureTotals::reset(int ngroups, int nmeasures) {
+  m_ngroups = ngroups;
+  m_nmeasures = nmeasures;
+  m_measures = QVector<Measure>(ngroups*nmeasures);
+  m_stale.clear();
+  m_is_stale = QBitArray(ngroups);
+}
+
+int MeasureTotals::appendGroup() {
+  m_measures.resize(m_measures.size() + m_nmeasures);
+  m_is_stale.resize(m_ngroups + 1);
+  return m_ngroups++;
+}
+
+void MeasureTotals::remap(const QVector<int>& group_map, int new_ngroups) {
+  QVector<Measure> measures(new_ngroups*m_nmeasures);
+  QBitArray is_stale(new_ngroups);
+  QVector<int> stale;
+  for (int group = 0; group < m_ngroups; ++group) {
+    const int new_group = group_map.isEmpty() ? group : group_map.at(group);
+    if (new_group < 0 || new_group >= new_ngroups) {
+      continue;
+    }
+    std::copy(m_measures.constBegin() + group*m_nmeasures, m_measures.constBegin() + (group+1)*m_nmeasures,
+              measures.begin() + new_group*m_nmeasures);
+    if (m_is_stale.testBit(group)) {
+      is_stale.setBit(new_group);
+      stale << new_group;
+    }
+  }
+  m_measures = measures;
+  m_is_stale = is_stale;
+  m_stale = stale;
+  m_ngroups = new_ngroups;
+}
+
+void MeasureTotals::add(int group, const MeasureStore& store, int element) {
+  Measure* measures = m_measures.data() + group*m_nmeasures;
+  for (int measure = 0; measure < m_nmeasures; ++measure) {
+    measures[measure].add(store.value(measure, element));
+  }
+}
+
+void MeasureTotals::remove(int group, const MeasureStore& store, int element) {
+  Measure* measures = m_measures.data() + group*m_nmeasures;
+  for (int measure = 0; measure < m_nmeasures; ++measure) {
+    Measure& m = measures[measure];
+    if (!m.remove(store.value(measure, element)) && !m_is_stale.testBit(group)) {
+      m_is_stale.setBit(group);
+      m_stale << group;
+    }
+  }
+}
+
+void MeasureTotals::add(int group, const Measure* measures) {
+  Measure* target = m_measures.data() + group*m_nmeasures;
+  for (int measure = 0; measure < m_nmeasures; ++measure) {
+    target[measure].add(measures[measure]);
+  }
+}
+
+void MeasureTotals::clear(int group) {
+  Measure* measures = m_measures.data() + group*m_nmeasures;
+  for (int measure = 0; measure < m_nmeasures; ++measure) {
+    measures[measure] = Measure();
+  }
+}
+
+void MeasureTotals::markStale(int group) {
+  if (!m_is_stale.testBit(group)) {
+    m_is_stale.setBit(group);
+    m_stale << group;
+  }
+}
+
+QVector<int> MeasureTotals::takeStale() {
+  const QVector<int> rv = m_stale;
+  m_stale.clear();
+  Q_FOREACH(int group, rv) {
+    m_is_stale.clearBit(group);
+  }
+  return rv;
+}
+
+} // end of namespace
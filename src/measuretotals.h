@@ -0,0 +1,111 @@
+#ifndef QDATACUBE_MEASURETOTALS_H
+#define QDATACUBE_MEASURETOTALS_H
+
+#include "measure.h"
+
+#include <QBitArray>
+#include <QVector>
+
+namespace qdatacube {
+
+class MeasureStore;
+
+/**
+ * Rolled up measures of groups of elements, e.g. the buckets of one direction of a datacube or the header
+ * sections of a header level, with a Measure per measured column for each group.
+ *
+ * Elements are added and removed one at a time. Removing the smallest or largest value of a group makes
+ * its min and max stale, as they cannot be subtracted. The owner finds stale groups with takeStale() and
+ * recomputes them from their parts with clear() and add().
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class MeasureTotals {
+    public:
+        MeasureTotals();
+
+        /**
+         * Set up ngroups empty groups of nmeasures measures each
+         */
+        void reset(int ngroups, int nmeasures);
+
+        /**
+         * Add an empty group
+         * @return the new group
+         */
+        int appendGroup();
+
+        /**
+         * Move group g to group_map[g], dropping it if -1, keeping the measures and whether they are stale.
+         * An empty group_map keeps the groups where they are. Afterwards there are new_ngroups groups
+         */
+        void remap(const QVector<int>& group_map, int new_ngroups);
+
+        /**
+         * @return number of groups
+         */
+        int groupCount() const {
+            return m_ngroups;
+        }
+
+        /**
+         * @return number of measures of each group
+         */
+        int measureCount() const {
+            return m_nmeasures;
+        }
+
+        /**
+         * @return the measures of group, or 0 if there are no measures
+         */
+        const Measure* measures(int group) const {
+            return m_nmeasures > 0 ? m_measures.constData() + group*m_nmeasures : 0;
+        }
+
+        /**
+         * Add the values of element in store to group
+         */
+        void add(int group, const MeasureStore& store, int element);
+
+        /**
+         * Remove the values of element in store from group
+         */
+        void remove(int group, const MeasureStore& store, int element);
+
+        /**
+         * Add measures (one per measure) to group
+         */
+        void add(int group, const Measure* measures);
+
+        /**
+         * Make group empty
+         */
+        void clear(int group);
+
+        /**
+         * Mark group as stale, e.g. when measures too many to remove one at a time have left it
+         */
+        void markStale(int group);
+
+        /**
+         * @return true if some groups have stale min and max
+         */
+        bool hasStale() const {
+            return !m_stale.isEmpty();
+        }
+
+        /**
+         * @return the groups with stale min and max, which are no longer marked as such
+         */
+        QVector<int> takeStale();
+
+    private:
+        QVector<Measure> m_measures; // m_nmeasures per group
+        QVector<int> m_stale;
+        QBitArray m_is_stale;
+        int m_ngroups;
+        int m_nmeasures;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_MEASURETOTALS_H
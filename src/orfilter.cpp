@@ -1,11 +1,12 @@
 #include "orfilter.h"
+#include "filtercombination.h"
 #include <QSharedPointer>
 
 namespace qdatacube {
 class OrFilterPrivate {
 public:
-    OrFilterPrivate() {};
-    QList<AbstractFilter::Ptr> m_filterComponents;
+    OrFilterPrivate() : m_filterComponents(FilterOrder::StopOnPass) {};
+    FilterCombination m_filterComponents;
 };
 
 OrFilter::OrFilter(QAbstractItemModel* underlyingModel): AbstractFilter(underlyingModel), d(new OrFilterPrivate()) {}
@@ -15,13 +16,36 @@ void OrFilter::addFilter(AbstractFilter::Ptr filter) {
     d->m_filterComponents.append(filter);
 }
 
+QList<AbstractFilter::Ptr> OrFilter::filters() const {
+    return d->m_filterComponents.filters();
+}
+
 bool OrFilter::operator()(int row) const {
-    Q_FOREACH(AbstractFilter::Ptr filter, d->m_filterComponents) {
-       if((*filter)(row))  {
-           return true;
-       }
-    }
-    return false;
+    return d->m_filterComponents(row);
+}
+
+void OrFilter::evaluate(int begin, int end, quint64* included) const {
+    d->m_filterComponents.evaluate(*this, begin, end, included);
+}
+
+const FilterCombination& OrFilter::combination() const {
+    return d->m_filterComponents;
+}
+
+bool OrFilter::isThreadSafe() const {
+    return d->m_filterComponents.isThreadSafe();
+}
+
+QList<FilterStatistics> OrFilter::statistics() const {
+    return d->m_filterComponents.statistics();
+}
+
+void OrFilter::setAdaptive(bool adaptive) {
+    d->m_filterComponents.setAdaptive(adaptive);
+}
+
+bool OrFilter::isAdaptive() const {
+    return d->m_filterComponents.isAdaptive();
 }
 
 OrFilter::~OrFilter() {}
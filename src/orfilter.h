@@ -2,12 +2,16 @@
 #define OR_FILTER_H
 
 #include "abstractfilter.h"
+#include "filterstatistics.h"
+
+#include <QList>
 
 class QAbstractItemModel;
 
 namespace qdatacube {
 
 class OrFilterPrivate;
+class FilterCombination;
 /**
  * A filter allowing multiple filters to be combined, by default by OR'ing the
  * result of their operator().
@@ -22,18 +26,55 @@ class QDATACUBE_EXPORT OrFilter : public AbstractFilter {
          */
         virtual bool operator()(int row) const;
 
+        /**
+         * Evaluate the rows in one go, by compiling the filter into a FilterProgram, see AbstractFilter::evaluate().
+         * The combined filters are evaluated in the current evaluation order, and when adaptive, the batch
+         * evaluations are recorded in statistics()
+         */
+        virtual void evaluate(int begin, int end, quint64* included) const;
+
+        /**
+         * @return true if all the combined filters are thread safe, and the filter is not adaptive
+         */
+        virtual bool isThreadSafe() const;
+
         /**
          * adds a filter
          * Note: all filters need to share the same underlyingModel
          */
         void addFilter(AbstractFilter::Ptr filter);
 
+        /**
+         * @return the combined filters, in the order they were added
+         */
+        QList<AbstractFilter::Ptr> filters() const;
+
+        /**
+         * @return statistics of the combined filters, in the order they were added. Only adaptive
+         * evaluations are recorded
+         */
+        QList<FilterStatistics> statistics() const;
+
+        /**
+         * Set whether the combined filters are evaluated cheapest and most decisive first, as learned from
+         * evaluating them, or in the order they were added (the default). An adaptive filter changes as it
+         * is evaluated, so it is never thread safe.
+         */
+        void setAdaptive(bool adaptive);
+
+        /**
+         * @return true if the order of evaluation adapts, see setAdaptive()
+         */
+        bool isAdaptive() const;
+
         /**
          * dtor
          */
         virtual ~OrFilter();
     private:
+        const FilterCombination& combination() const;
         QScopedPointer<OrFilterPrivate> d;
+        friend class FilterProgram;
 
 };
 }
@@ -0,0 +1,91 @@
+#include "quantileformatter.h"
+#include <QAbstractItemModel>
+#include <QEvent>
+#include <stdexcept>
+#include <QWidget>
+#include <algorithm>
+#include "datacubeview.h"
+#include "tdigest.h"
+namespace qdatacube {
+
+class QuantileFormatterPrivate {
+    public:
+        QuantileFormatterPrivate(int column, double quantile, int precision, QString suffix, double scale) : m_column(column), m_quantile(quantile), m_precision(precision), m_suffix(suffix), m_scale(scale) {
+        }
+        const int m_column;
+        const double m_quantile;
+        const int m_precision;
+        QString m_suffix;
+        const double m_scale;
+};
+
+QuantileFormatter::QuantileFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column, double quantile, int precision, QString suffix, double scale)
+ : AbstractFormatter(underlying_model, view), d(new QuantileFormatterPrivate(column, quantile, precision, suffix, scale))
+{
+  if (column >= underlying_model->columnCount()|| column<0) {
+    throw std::runtime_error(QString("Column %1 must be in the underlying model, ie., be between 0 and %2").arg(column).arg(underlying_model->columnCount()).toStdString());
+  }
+  if (quantile < 0.0 || quantile > 1.0) {
+    throw std::runtime_error(QString("Quantile %1 must be between 0 and 1").arg(quantile).toStdString());
+  }
+  update(qdatacube::AbstractFormatter::CellSize);
+  const QString column_name = underlyingModel()->headerData(d->m_column, Qt::Horizontal).toString();
+  if (quantile == 0.5) {
+    setShortName("MED");
+    setName(QString("Median of %1").arg(column_name));
+  } else {
+    const QString percentile = QString::number(quantile*100.0);
+    setShortName("P" + percentile);
+    setName(QString("%1th percentile of %2").arg(percentile).arg(column_name));
+  }
+}
+
+QString QuantileFormatter::format(QList< int > rows) const
+{
+  QVector<double> values;
+  values.reserve(rows.size());
+  Q_FOREACH(int element, rows) {
+    values << underlyingModel()->index(element, d->m_column).data().toDouble();
+  }
+  std::sort(values.begin(), values.end());
+  return formatValue(TDigest::quantile(values, d->m_quantile));
+}
+
+QString QuantileFormatter::formatRange(const ElementRange& elements) const
+{
+  if (elements.hasQuantiles(d->m_column)) {
+    return formatValue(elements.quantileDigest(d->m_column).quantile(d->m_quantile));
+  }
+  QVector<double> values;
+  values.reserve(elements.size());
+  for (ElementRange::const_iterator it = elements.begin(), iend = elements.end(); it != iend; ++it) {
+    values << underlyingModel()->index(*it, d->m_column).data().toDouble();
+  }
+  std::sort(values.begin(), values.end());
+  return formatValue(TDigest::quantile(values, d->m_quantile));
+}
+
+QString QuantileFormatter::formatValue(double value) const
+{
+  return QString::number(value*d->m_scale,'f',d->m_precision) + d->m_suffix;
+}
+
+void QuantileFormatter::update(AbstractFormatter::UpdateType element) {
+    if(element == qdatacube::AbstractFormatter::CellSize) {
+        if(datacubeView()) {
+            // A quantile is between the smallest and the largest value, so use the widest of those
+            double widest = 0.0;
+            for (int element = 0, nelements = underlyingModel()->rowCount(); element < nelements; ++element) {
+                widest = qMax(widest, qAbs(underlyingModel()->index(element, d->m_column).data().toDouble()));
+            }
+            QString big_cell_contents = QString::number(-widest*d->m_scale, 'f', d->m_precision) + d->m_suffix;
+            setCellSize(QSize(datacubeView()->fontMetrics().width(big_cell_contents), datacubeView()->fontMetrics().lineSpacing()));
+        }
+    }
+}
+
+QuantileFormatter::~QuantileFormatter() {
+
+}
+
+} // end of namespace
@@ -0,0 +1,36 @@
+#ifndef QDATACUBE_QUANTILE_FORMATTER_H
+#define QDATACUBE_QUANTILE_FORMATTER_H
+
+#include "abstractformatter.h"
+#include "qdatacube_export.h"
+namespace qdatacube {
+
+/**
+  * Formatter that takes a column and shows a quantile of it, e.g. the median or the 95th percentile.
+  * If the datacube keeps the quantiles of the column (see Datacube::addQuantiles()), cells and totals are read from
+  * its digests, exact for small cells and estimated for big ones. Otherwise the values are sorted for each cell,
+  * which is slow for big cells and totals.
+  */
+class QuantileFormatterPrivate;
+class QDATACUBE_EXPORT QuantileFormatter : public AbstractFormatter {
+    public:
+        /**
+         * @param underlying_model the underlying_model
+         * @param column the column of the underlying model. Should provide data convertible to double
+         * @param quantile the quantile to show, from 0 to 1, e.g. 0.5 for the median
+         * @param precision precision of the output
+         * @param suffix a (small) string that is appended to the format, e.g. "t" for tonnes.
+         * @param scale this is multiplied on the quantile before displaying (e.g. using .001 to convert kg to T)
+         */
+        QuantileFormatter(QAbstractItemModel* underlying_model, qdatacube::DatacubeView* view, int column, double quantile, int precision, QString suffix, double scale = 1.0);
+        virtual QString format(QList< int > rows) const;
+        virtual QString formatRange(const ElementRange& elements) const;
+        virtual ~QuantileFormatter();
+    protected:
+        virtual void update(UpdateType element);
+    private:
+        QString formatValue(double value) const;
+        QScopedPointer<QuantileFormatterPrivate> d;
+};
+} // end of namespace
+#endif // QDATACUBE_QUANTILE_FORMATTER_H
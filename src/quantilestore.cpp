@@ -0,0 +1,182 @@
+#include "quantilestore.h"
+
+#include "cellstore.h"
+
+namespace qdatacube {
+
+namespace {
+
+/**
+ * Move the digests of buckets to bucket_map, dropping those mapped to -1. An empty bucket_map leaves them
+ */
+void remap_buckets(QHash<int, TDigest>& buckets, const QVector<int>& bucket_map) {
+  if (bucket_map.isEmpty()) {
+    return;
+  }
+  QHash<int, TDigest> remapped;
+  for (QHash<int, TDigest>::const_iterator it = buckets.constBegin(), iend = buckets.constEnd(); it != iend; ++it) {
+    if (bucket_map.at(it.key()) >= 0) {
+      remapped.insert(bucket_map.at(it.key()), it.value());
+    }
+  }
+  buckets = remapped;
+}
+
+}
+
+QuantileStore::QuantileStore()
+{
+}
+
+int QuantileStore::indexOf(int column) const {
+  for (int quantile = 0; quantile < m_columns.size(); ++quantile) {
+    if (m_columns.at(quantile).column == column) {
+      return quantile;
+    }
+  }
+  return -1;
+}
+
+int QuantileStore::addColumn(int column) {
+  Q_ASSERT(indexOf(column) < 0);
+  Column c;
+  c.column = column;
+  m_columns << c;
+  return m_columns.size() - 1;
+}
+
+void QuantileStore::removeColumn(int quantile) {
+  m_columns.remove(quantile);
+}
+
+void QuantileStore::setValue(int quantile, int element, double value) {
+  QVector<double>& values = m_columns[quantile].values;
+  if (element >= values.size()) {
+    values.resize(element + 1);
+  }
+  values[element] = value;
+}
+
+void QuantileStore::add(long cell, int bucket_row, int bucket_column, int element) {
+  for (int quantile = 0; quantile < m_columns.size(); ++quantile) {
+    Column& c = m_columns[quantile];
+    const double value = c.values.at(element);
+    QHash<long, TDigest>::iterator cit = c.cells.find(cell);
+    if (cit != c.cells.end()) {
+      cit->add(value);
+    }
+    QHash<int, TDigest>::iterator it = c.rows.find(bucket_row);
+    if (it != c.rows.end()) {
+      it->add(value);
+    }
+    it = c.columns.find(bucket_column);
+    if (it != c.columns.end()) {
+      it->add(value);
+    }
+    if (c.total_valid) {
+      c.total.add(value);
+    }
+  }
+}
+
+void QuantileStore::remove(long cell, int bucket_row, int bucket_column) {
+  for (int quantile = 0; quantile < m_columns.size(); ++quantile) {
+    Column& c = m_columns[quantile];
+    c.cells.remove(cell);
+    c.rows.remove(bucket_row);
+    c.columns.remove(bucket_column);
+    c.total_valid = false;
+  }
+}
+
+void QuantileStore::clear() {
+  for (int quantile = 0; quantile < m_columns.size(); ++quantile) {
+    Column& c = m_columns[quantile];
+    c.cells.clear();
+    c.rows.clear();
+    c.columns.clear();
+    c.total_valid = false;
+  }
+}
+
+const TDigest& QuantileStore::cellDigest(int quantile, long cell, const CellStore& cells) {
+  Column& c = m_columns[quantile];
+  QHash<long, TDigest>::iterator it = c.cells.find(cell);
+  if (it == c.cells.end()) {
+    it = c.cells.insert(cell, TDigest());
+    const CellStore::const_iterator elements = cells.constFind(cell);
+    if (elements != cells.constEnd()) {
+      for (const int* eit = elements.begin(), *eend = elements.end(); eit != eend; ++eit) {
+        it->add(c.values.at(*eit));
+      }
+    }
+  }
+  // Added values are gathered on the way out, so the digest is ready for any number of quantiles
+  it->compress();
+  return *it;
+}
+
+const TDigest& QuantileStore::rowDigest(int quantile, int bucket_row, const CellStore& cells, int nrows, int ncolumns) {
+  QHash<int, TDigest>::iterator it = m_columns[quantile].rows.find(bucket_row);
+  if (it == m_columns[quantile].rows.end()) {
+    TDigest digest;
+    for (int bucket_column = 0; bucket_column < ncolumns; ++bucket_column) {
+      const long cell = bucket_row + long(bucket_column)*nrows;
+      if (cells.contains(cell)) {
+        digest.merge(cellDigest(quantile, cell, cells));
+      }
+    }
+    it = m_columns[quantile].rows.insert(bucket_row, digest);
+  }
+  it->compress();
+  return *it;
+}
+
+const TDigest& QuantileStore::columnDigest(int quantile, int bucket_column, const CellStore& cells, int nrows) {
+  QHash<int, TDigest>::iterator it = m_columns[quantile].columns.find(bucket_column);
+  if (it == m_columns[quantile].columns.end()) {
+    TDigest digest;
+    for (int bucket_row = 0; bucket_row < nrows; ++bucket_row) {
+      const long cell = bucket_row + long(bucket_column)*nrows;
+      if (cells.contains(cell)) {
+        digest.merge(cellDigest(quantile, cell, cells));
+      }
+    }
+    it = m_columns[quantile].columns.insert(bucket_column, digest);
+  }
+  it->compress();
+  return *it;
+}
+
+const TDigest& QuantileStore::totalDigest(int quantile, const CellStore& cells) {
+  if (!m_columns.at(quantile).total_valid) {
+    TDigest digest;
+    for (CellStore::const_iterator it = cells.constBegin(), iend = cells.constEnd(); it != iend; ++it) {
+      digest.merge(cellDigest(quantile, it.key(), cells));
+    }
+    Column& c = m_columns[quantile];
+    c.total = digest;
+    c.total_valid = true;
+  }
+  m_columns[quantile].total.compress();
+  return m_columns.at(quantile).total;
+}
+
+void QuantileStore::remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows) {
+  for (int i = 0; i < m_columns.size(); ++i) {
+    Column& c = m_columns[i];
+    QHash<long, TDigest> cells;
+    for (QHash<long, TDigest>::const_iterator it = c.cells.constBegin(), iend = c.cells.constEnd(); it != iend; ++it) {
+      const long row = row_map.isEmpty() ? it.key() % nrows : row_map.at(it.key() % nrows);
+      const long column = column_map.isEmpty() ? it.key() / nrows : column_map.at(it.key() / nrows);
+      if (row >= 0 && column >= 0) {
+        cells.insert(row + column*new_nrows, it.value());
+      }
+    }
+    c.cells = cells;
+    remap_buckets(c.rows, row_map);
+    remap_buckets(c.columns, column_map);
+  }
+}
+
+} // end of namespace
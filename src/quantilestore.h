@@ -0,0 +1,125 @@
+#ifndef QDATACUBE_QUANTILESTORE_H
+#define QDATACUBE_QUANTILESTORE_H
+
+#include "tdigest.h"
+
+#include <QHash>
+#include <QVector>
+
+namespace qdatacube {
+
+class CellStore;
+
+/**
+ * The quantiles a datacube keeps for some columns of the underlying model: the value of each element in each of
+ * those columns, and t-digests of cells, row and column buckets and of all elements.
+ *
+ * Digests are made when first asked for, cells from their elements, buckets and the total by merging their cells.
+ * Adding an element adds it to the digests made that hold it, while removing one drops them, as digests cannot
+ * forget values, to be made again when next asked for.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class QuantileStore {
+    public:
+        QuantileStore();
+
+        /**
+         * @return true if no columns are kept
+         */
+        bool isEmpty() const {
+            return m_columns.isEmpty();
+        }
+
+        /**
+         * @return number of columns kept
+         */
+        int count() const {
+            return m_columns.size();
+        }
+
+        /**
+         * @return the column of the underlying model of quantile
+         */
+        int column(int quantile) const {
+            return m_columns.at(quantile).column;
+        }
+
+        /**
+         * @return the quantile of column, or -1 if it is not kept
+         */
+        int indexOf(int column) const;
+
+        /**
+         * Start keeping the quantiles of column. The values of the elements must be set before use
+         * @return the new quantile
+         */
+        int addColumn(int column);
+
+        /**
+         * Stop keeping quantile
+         */
+        void removeColumn(int quantile);
+
+        /**
+         * Set the value of element for quantile. Digests already holding element are not changed
+         */
+        void setValue(int quantile, int element, double value);
+
+        /**
+         * Add element, now in cell (bucket_row, bucket_column), to the digests holding it
+         */
+        void add(long cell, int bucket_row, int bucket_column, int element);
+
+        /**
+         * Drop the digests holding element, which is leaving cell (bucket_row, bucket_column)
+         */
+        void remove(long cell, int bucket_row, int bucket_column);
+
+        /**
+         * Drop all digests, e.g. when the cells are laid out anew
+         */
+        void clear();
+
+        /**
+         * Move the digests of the cells and buckets to new bucket coordinates, as CellStore::remap(). The digests
+         * of dropped buckets are dropped, and the total must not change
+         */
+        void remap(int nrows, const QVector<int>& row_map, const QVector<int>& column_map, int new_nrows);
+
+        /**
+         * @return digest of cell
+         */
+        const TDigest& cellDigest(int quantile, long cell, const CellStore& cells);
+
+        /**
+         * @return digest of the elements in row bucket, for a datacube with nrows row buckets and ncolumns column buckets
+         */
+        const TDigest& rowDigest(int quantile, int bucket_row, const CellStore& cells, int nrows, int ncolumns);
+
+        /**
+         * @return digest of the elements in column bucket
+         */
+        const TDigest& columnDigest(int quantile, int bucket_column, const CellStore& cells, int nrows);
+
+        /**
+         * @return digest of all elements
+         */
+        const TDigest& totalDigest(int quantile, const CellStore& cells);
+
+    private:
+        struct Column {
+            Column() : column(-1), total_valid(false) {}
+            int column;
+            QVector<double> values; // indexed by element
+            QHash<long, TDigest> cells;
+            QHash<int, TDigest> rows;
+            QHash<int, TDigest> columns;
+            TDigest total;
+            bool total_valid;
+        };
+        QVector<Column> m_columns;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_QUANTILESTORE_H
@@ -0,0 +1,110 @@
+#include "reverseindex.h"
+
+namespace qdatacube {
+
+const int ReverseIndex::not_included;
+
+ReverseIndex::ReverseIndex() : m_count(0)
+{
+}
+
+void ReverseIndex::insert(int element, Cell cell) {
+  Q_ASSERT(element >= 0);
+  Q_ASSERT(!cell.invalid());
+  if (element >= m_rows.size()) {
+    resize(qMax(element + 1, m_rows.size() * 2));
+  }
+  if (m_rows.at(element) == not_included) {
+    m_included[element >> 6] |= Q_UINT64_C(1) << (element & 63);
+    ++m_count;
+  }
+  m_rows[element] = cell.row();
+  m_columns[element] = cell.column();
+}
+
+void ReverseIndex::remove(int element) {
+  if (!contains(element)) {
+    return;
+  }
+  m_rows[element] = not_included;
+  m_included[element >> 6] &= ~(Q_UINT64_C(1) << (element & 63));
+  --m_count;
+}
+
+void ReverseIndex::insert(const QList<int>& elements, Cell cell) {
+  Q_FOREACH(int element, elements) {
+    insert(element, cell);
+  }
+}
+
+void ReverseIndex::remove(const QList<int>& elements) {
+  Q_FOREACH(int element, elements) {
+    remove(element);
+  }
+}
+
+void ReverseIndex::clear() {
+  m_rows.fill(not_included);
+  m_included.fill(0);
+  m_count = 0;
+}
+
+void ReverseIndex::resize(int nelements) {
+  const int old_size = m_rows.size();
+  m_rows.resize(nelements);
+  m_columns.resize(nelements);
+  for (int element = old_size; element < nelements; ++element) {
+    m_rows[element] = not_included;
+  }
+  if (nelements < old_size) {
+    rebuild_included();
+  } else {
+    m_included.resize((nelements + 63) >> 6);
+  }
+}
+
+void ReverseIndex::remapRows(const QVector<int>& bucket_map) {
+  remap(m_rows, bucket_map);
+}
+
+void ReverseIndex::remapColumns(const QVector<int>& bucket_map) {
+  remap(m_columns, bucket_map);
+}
+
+void ReverseIndex::remap(QVector<int>& coordinates, const QVector<int>& bucket_map) {
+  for (int element = 0; element < m_rows.size(); ++element) {
+    if (m_rows.at(element) == not_included) {
+      continue;
+    }
+    const int bucket = bucket_map.at(coordinates.at(element));
+    if (bucket < 0) {
+      remove(element);
+    } else {
+      coordinates[element] = bucket;
+    }
+  }
+}
+
+void ReverseIndex::rebuild_included() {
+  m_included = QVector<quint64>((m_rows.size() + 63) >> 6);
+  m_count = 0;
+  for (int element = 0; element < m_rows.size(); ++element) {
+    if (m_rows.at(element) != not_included) {
+      m_included[element >> 6] |= Q_UINT64_C(1) << (element & 63);
+      ++m_count;
+    }
+  }
+}
+
+QList< int > ReverseIndex::elements() const {
+  QList<int> rv;
+  rv.reserve(m_count);
+  for (int word_index = 0; word_index < m_included.size(); ++word_index) {
+    for (quint64 word = m_included.at(word_index); word; word &= word - 1) {
+      rv << (word_index << 6) + int(qPopulationCount((word & (~word + 1)) - 1));
+    }
+  }
+  return rv;
+}
+
+} // end of namespace
@@ -0,0 +1,106 @@
+#ifndef QDATACUBE_REVERSEINDEX_H
+#define QDATACUBE_REVERSEINDEX_H
+
+#include <QList>
+#include <QVector>
+
+#include "cell.h"
+
+namespace qdatacube {
+
+/**
+ * Maps from elements (element ids, see ElementMap) to the bucket coordinates of their cell.
+ *
+ * As element ids are dense integers from 0, the coordinates are kept in two arrays indexed
+ * by element, with a sentinel for elements not in the datacube (e.g., filtered out). A bitset of included
+ * elements gives the element list without touching the coordinates.
+ * NOTE: If this class is exported, remember to move the datamembers to a private class
+ */
+class ReverseIndex {
+    public:
+        ReverseIndex();
+
+        /**
+         * @return true if element is in the datacube
+         */
+        bool contains(int element) const {
+            return element >= 0 && element < m_rows.size() && m_rows.at(element) != not_included;
+        }
+
+        /**
+         * @return the bucket coordinates of element, or an invalid cell
+         */
+        Cell value(int element) const {
+            return contains(element) ? Cell(m_rows.at(element), m_columns.at(element)) : Cell();
+        }
+
+        /**
+         * Set coordinates of element, growing the index if needed
+         */
+        void insert(int element, Cell cell);
+
+        /**
+         * Set the coordinates of all of elements to cell, as when a whole cell is added at once
+         */
+        void insert(const QList<int>& elements, Cell cell);
+
+        /**
+         * Mark element as not in the datacube
+         */
+        void remove(int element);
+
+        /**
+         * Mark all of elements as not in the datacube, as when a whole cell is dropped at once
+         */
+        void remove(const QList<int>& elements);
+
+        /**
+         * Remove all elements, keeping the size
+         */
+        void clear();
+
+        /**
+         * Set the number of elements the index can hold. New elements are not included
+         */
+        void resize(int nelements);
+
+        /**
+         * Move elements to new row buckets, bucket_map giving the new bucket of each old one, or -1 to
+         * drop the elements in it
+         */
+        void remapRows(const QVector<int>& bucket_map);
+
+        /**
+         * Move elements to new column buckets, as remapRows()
+         */
+        void remapColumns(const QVector<int>& bucket_map);
+
+        /**
+         * @return number of elements in the datacube
+         */
+        int size() const {
+            return m_count;
+        }
+
+        bool isEmpty() const {
+            return m_count == 0;
+        }
+
+        /**
+         * @return all elements in the datacube, in ascending order
+         */
+        QList<int> elements() const;
+
+    private:
+        static const int not_included = -1000;
+        void rebuild_included();
+        void remap(QVector<int>& coordinates, const QVector<int>& bucket_map);
+        QVector<int> m_rows;
+        QVector<int> m_columns;
+        QVector<quint64> m_included;
+        int m_count;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_REVERSEINDEX_H
@@ -0,0 +1,227 @@
+#include "tdigest.h"
+
+#include <QtMath>
+
+#include <algorithm>
+
+namespace qdatacube {
+
+namespace {
+
+/**
+ * The k1 scale function of Dunning and Ertl, which grows fast near q = 0 and q = 1, so centroids there stay small
+ */
+double k_of_q(double q, double compression) {
+  return compression / (2.0 * M_PI) * qAsin(2.0 * q - 1.0);
+}
+
+double q_of_k(double k, double compression) {
+  return k >= compression / 4.0 ? 1.0 : (qSin(k * 2.0 * M_PI / compression) + 1.0) / 2.0;
+}
+
+}
+
+class TDigestPrivate : public QSharedData {
+  public:
+    struct Centroid {
+      Centroid() : mean(0.0), weight(0.0) {}
+      Centroid(double mean, double weight) : mean(mean), weight(weight) {}
+      bool operator<(const Centroid& rhs) const {
+        return mean < rhs.mean;
+      }
+      double mean;
+      double weight;
+    };
+    TDigestPrivate(double compression) : compression(compression), count(0), min(0.0), max(0.0), exact(true) {}
+    bool is_exact() const {
+      return exact && count <= qint64(compression);
+    }
+    void add(double value);
+    void merge(const TDigestPrivate& other);
+    void compress();
+    double quantile(double q) const;
+    QVector<Centroid> centroids; // sorted by mean
+    QVector<Centroid> unmerged; // added since the last compress()
+    double compression;
+    qint64 count;
+    double min;
+    double max;
+    bool exact; // false once values have been gathered into centroids
+};
+
+void TDigestPrivate::add(double value) {
+  if (count == 0) {
+    min = value;
+    max = value;
+  } else {
+    min = qMin(min, value);
+    max = qMax(max, value);
+  }
+  ++count;
+  unmerged << Centroid(value, 1.0);
+  if (unmerged.size() > 4 * int(compression)) {
+    compress();
+  }
+}
+
+void TDigestPrivate::merge(const TDigestPrivate& other) {
+  if (other.count == 0) {
+    return;
+  }
+  if (count == 0) {
+    min = other.min;
+    max = other.max;
+  } else {
+    min = qMin(min, other.min);
+    max = qMax(max, other.max);
+  }
+  count += other.count;
+  exact = exact && other.exact;
+  unmerged << other.centroids << other.unmerged;
+  if (unmerged.size() > 4 * int(compression)) {
+    compress();
+  }
+}
+
+void TDigestPrivate::compress() {
+  if (unmerged.isEmpty()) {
+    return;
+  }
+  QVector<Centroid> all = centroids;
+  all << unmerged;
+  unmerged.clear();
+  std::sort(all.begin(), all.end());
+  if (is_exact()) {
+    centroids = all;
+    return;
+  }
+  exact = false;
+  // Merge neighbours as long as the merged centroid spans at most 1 in k
+  const double total = double(count);
+  centroids.clear();
+  double weight_before = 0.0;
+  double weight_limit = total * q_of_k(k_of_q(0.0, compression) + 1.0, compression);
+  Centroid current = all.first();
+  for (int i = 1; i < all.size(); ++i) {
+    const Centroid& next = all.at(i);
+    if (weight_before + current.weight + next.weight <= weight_limit) {
+      current.weight += next.weight;
+      current.mean += (next.mean - current.mean) * next.weight / current.weight;
+    } else {
+      centroids << current;
+      weight_before += current.weight;
+      weight_limit = total * q_of_k(k_of_q(weight_before / total, compression) + 1.0, compression);
+      current = next;
+    }
+  }
+  centroids << current;
+}
+
+double TDigestPrivate::quantile(double q) const {
+  Q_ASSERT(q >= 0.0 && q <= 1.0);
+  if (!unmerged.isEmpty()) {
+    TDigestPrivate compressed(*this);
+    compressed.compress();
+    return compressed.quantile(q);
+  }
+  if (count == 0) {
+    return 0.0;
+  }
+  if (is_exact()) {
+    QVector<double> values(centroids.size());
+    for (int i = 0; i < centroids.size(); ++i) {
+      values[i] = centroids.at(i).mean;
+    }
+    return TDigest::quantile(values, q);
+  }
+  // Each centroid is taken to be centred on its mean, with the minimum and maximum at the very ends
+  const double index = q * double(count);
+  const Centroid& first = centroids.first();
+  if (index <= first.weight / 2.0) {
+    return min + (first.mean - min) * index / (first.weight / 2.0);
+  }
+  const Centroid& last = centroids.last();
+  if (index >= double(count) - last.weight / 2.0) {
+    return last.mean + (max - last.mean) * (index - (double(count) - last.weight / 2.0)) / (last.weight / 2.0);
+  }
+  double weight_before = first.weight / 2.0;
+  for (int i = 0; i + 1 < centroids.size(); ++i) {
+    const Centroid& left = centroids.at(i);
+    const Centroid& right = centroids.at(i + 1);
+    const double between = (left.weight + right.weight) / 2.0;
+    if (weight_before + between >= index) {
+      return left.mean + (right.mean - left.mean) * (index - weight_before) / between;
+    }
+    weight_before += between;
+  }
+  return last.mean;
+}
+
+TDigest::TDigest(double compression) : d(new TDigestPrivate(compression))
+{
+  Q_ASSERT(compression >= 10.0);
+}
+
+TDigest::TDigest(const TDigest& other) : d(other.d)
+{
+}
+
+TDigest& TDigest::operator=(const TDigest& other) {
+  d = other.d;
+  return *this;
+}
+
+TDigest::~TDigest()
+{
+}
+
+void TDigest::add(double value) {
+  d->add(value);
+}
+
+void TDigest::merge(const TDigest& other) {
+  if (other.d->count > 0) {
+    d->merge(*other.d);
+  }
+}
+
+void TDigest::compress() {
+  if (!d->unmerged.isEmpty()) {
+    d->compress();
+  }
+}
+
+double TDigest::quantile(double q) const {
+  return d->quantile(q);
+}
+
+qint64 TDigest::count() const {
+  return d->count;
+}
+
+bool TDigest::isEmpty() const {
+  return d->count == 0;
+}
+
+bool TDigest::isExact() const {
+  return d->is_exact();
+}
+
+double TDigest::compression() const {
+  return d->compression;
+}
+
+double TDigest::quantile(const QVector< double >& sorted_values, double q) {
+  Q_ASSERT(q >= 0.0 && q <= 1.0);
+  if (sorted_values.isEmpty()) {
+    return 0.0;
+  }
+  const double position = q * (sorted_values.size() - 1);
+  const int below = qMin(int(position), sorted_values.size() - 1);
+  if (below + 1 == sorted_values.size()) {
+    return sorted_values.at(below);
+  }
+  return sorted_values.at(below) + (sorted_values.at(below + 1) - sorted_values.at(below)) * (position - below);
+}
+
+} // end of namespace
@@ -0,0 +1,80 @@
+#ifndef QDATACUBE_TDIGEST_H
+#define QDATACUBE_TDIGEST_H
+
+#include "qdatacube_export.h"
+
+#include <QSharedDataPointer>
+#include <QVector>
+
+namespace qdatacube {
+
+class TDigestPrivate;
+
+/**
+ * Sketch of a set of values for estimating quantiles, such as the median or the 95th percentile, in bounded memory.
+ *
+ * Values are gathered into centroids (a mean and a weight), kept small near the ends of the distribution, so extreme
+ * quantiles are estimated accurately, while the number of centroids stays around the compression. Small sets are kept
+ * exactly, as single values, until there are more than compression of them. Digests can be merged to the digest of
+ * the union, which is how the digests a datacube keeps per cell (see Datacube::addQuantiles()) add up to header
+ * sections and totals.
+ */
+class QDATACUBE_EXPORT TDigest {
+    public:
+        /**
+         * Empty digest
+         * @param compression bound on the number of centroids, higher is more accurate
+         */
+        explicit TDigest(double compression = 100.0);
+        TDigest(const TDigest& other);
+        TDigest& operator=(const TDigest& other);
+        ~TDigest();
+
+        /**
+         * Add value
+         */
+        void add(double value);
+
+        /**
+         * Add the values of other
+         */
+        void merge(const TDigest& other);
+
+        /**
+         * Gather values added since last into centroids. Done by quantile() on a copy if needed, so call this
+         * before asking a digest that is kept for many quantiles
+         */
+        void compress();
+
+        /**
+         * @return estimated q quantile, 0 <= q <= 1, exact as long as isExact(), or 0 for an empty digest
+         */
+        double quantile(double q) const;
+
+        /**
+         * @return number of values added
+         */
+        qint64 count() const;
+
+        bool isEmpty() const;
+
+        /**
+         * @return true if the values are still kept exactly
+         */
+        bool isExact() const;
+
+        double compression() const;
+
+        /**
+         * @return the q quantile of sorted_values, interpolating linearly between the values around position q*(n-1).
+         * This is what quantile() gives for an exact digest, and 0 for no values
+         */
+        static double quantile(const QVector<double>& sorted_values, double q);
+
+    private:
+        QSharedDataPointer<TDigestPrivate> d;
+};
+
+} // end of namespace
+
+#endif // QDATACUBE_TDIGEST_H
@@ -0,0 +1,96 @@
+#include "bucketindex.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestBucketIndex : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random inserts and removes, compared to a linear scan of the counts
+     */
+    void testAgainstScan();
+
+    /**
+     * Index with no buckets or only empty buckets
+     */
+    void testEmpty();
+};
+QTEST_GUILESS_MAIN(TestBucketIndex)
+
+namespace {
+
+void compare(const BucketIndex& index, const QVector<unsigned>& counts) {
+    int section = 0;
+    for (int bucket = 0; bucket < counts.size(); ++bucket) {
+        QCOMPARE(index.rank(bucket), section);
+        QCOMPARE(index.contains(bucket), counts.at(bucket) > 0);
+        if (counts.at(bucket) > 0) {
+            QCOMPARE(index.select(section), bucket);
+            ++section;
+        }
+    }
+    QCOMPARE(index.count(), section);
+    QCOMPARE(index.rank(counts.size()), section);
+    QCOMPARE(index.select(section), -1);
+}
+
+}
+
+void TestBucketIndex::testAgainstScan() {
+    // Sizes around the word boundaries
+    QList<int> sizes;
+    sizes << 1 << 63 << 64 << 65 << 1000 << 4097;
+    Q_FOREACH(int size, sizes) {
+        QVector<unsigned> counts(size);
+        quint32 seed = 4711 + size;
+        for (int bucket = 0; bucket < size; ++bucket) {
+            seed = seed * 1103515245u + 12345u;
+            counts[bucket] = (seed >> 16) % 3 == 0 ? 1 : 0;
+        }
+        BucketIndex index;
+        index.reset(counts);
+        compare(index, counts);
+        QVector<int> non_empty;
+        for (int bucket = size - 1; bucket >= 0; --bucket) {
+            if (counts.at(bucket) > 0) {
+                non_empty << bucket;
+            }
+        }
+        BucketIndex listed;
+        listed.reset(size, non_empty);
+        compare(listed, counts);
+        for (int i = 0; i < 2*size; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            const int bucket = (seed >> 8) % size;
+            if (counts.at(bucket) > 0) {
+                counts[bucket] = 0;
+                index.remove(bucket);
+            } else {
+                counts[bucket] = 1;
+                index.insert(bucket);
+            }
+        }
+        compare(index, counts);
+    }
+}
+
+void TestBucketIndex::testEmpty() {
+    BucketIndex index;
+    index.reset(QVector<unsigned>());
+    QCOMPARE(index.count(), 0);
+    QCOMPARE(index.select(0), -1);
+    index.reset(QVector<unsigned>(100));
+    QCOMPARE(index.count(), 0);
+    QCOMPARE(index.rank(99), 0);
+    QCOMPARE(index.select(0), -1);
+    index.insert(99);
+    QCOMPARE(index.select(0), 99);
+    QCOMPARE(index.rank(99), 0);
+    QCOMPARE(index.rank(100), 1);
+}
+
+#include "testbucketindex.moc"
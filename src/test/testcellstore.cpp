@@ -0,0 +1,275 @@
+#include "cellstore.h"
+#include "danishnamecube.h"
+
+#include <QHash>
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestCellStore : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random appends and removes, compared to a hash of lists
+     */
+    void testAgainstHash();
+
+    /**
+     * Replacing and clearing cells
+     */
+    void testSet();
+
+    /**
+     * Bulk assignment of elements to cells
+     */
+    void testAssign();
+
+    /**
+     * Moving cells to new bucket coordinates
+     */
+    void testRemap();
+
+    /**
+     * Compare memory use to a QHash<long, QList<int> > on the danish names, scaled up
+     */
+    void testMemoryUsage();
+
+    /**
+     * Time appending the danish names, scaled up, one element at a time, and check squeezing
+     */
+    void benchmarkAppend();
+};
+QTEST_GUILESS_MAIN(TestCellStore)
+
+namespace {
+
+void compare(const CellStore& store, const QHash<long, QList<int> >& reference) {
+    QCOMPARE(store.count(), reference.size());
+    int nelements = 0;
+    for (QHash<long, QList<int> >::const_iterator it = reference.constBegin(); it != reference.constEnd(); ++it) {
+        QCOMPARE(store.elements(it.key()), it.value());
+        nelements += it.value().size();
+    }
+    QCOMPARE(store.elementCount(), nelements);
+    int ncells = 0;
+    for (CellStore::const_iterator it = store.constBegin(); it != store.constEnd(); ++it) {
+        QCOMPARE(it.size(), reference.value(it.key()).size());
+        ++ncells;
+    }
+    QCOMPARE(ncells, reference.size());
+}
+
+/**
+ * Lower bound of the memory used by a QHash<long, QList<int> > on 64 bit Qt5:
+ * The bucket array, a hash node (next, hash, key and QList pointer) per cell, a QList header per cell and
+ * a pointer sized entry per element. The node and the list data are separate allocations, each costing at
+ * least 16 bytes more in malloc overhead.
+ */
+qint64 hash_memory_usage(int nbuckets, int ncells, int nelements) {
+    const qint64 malloc_overhead = 16;
+    const qint64 node = 8 + 4 + 8 + 8;
+    const qint64 list_header = 16;
+    return qint64(nbuckets) * 8 + qint64(ncells) * (node + malloc_overhead + list_header + malloc_overhead)
+           + qint64(nelements) * 8;
+}
+
+/**
+ * The cell and element of each element of the danish names, repeated scale times, with cells as in a datacube with
+ * first name and sex as rows and kommune and age as columns, and each copy in its own set of kommunes
+ */
+void scaled_danish_cells(int scale, QVector<long>& cells, QVector<int>& elements) {
+    danishnamecube_t danish;
+    danish.load_model_data(QFINDTESTDATA("data/plaincubedata.txt"));
+    const QAbstractItemModel* model = danish.m_underlying_model;
+    const int nrows = model->rowCount();
+    const int nsex = danish.sex_aggregator->categoryCount();
+    const int nkommune = danish.kommune_aggregator->categoryCount();
+    const int nage = danish.age_aggregator->categoryCount();
+    const long row_buckets = long(danish.first_name_aggregator->categoryCount()) * nsex;
+    const long column_buckets = long(nkommune) * nage;
+    cells.resize(scale * nrows);
+    elements.resize(scale * nrows);
+    for (int row = 0; row < nrows; ++row) {
+        const long bucket_row = (*danish.first_name_aggregator)(row) * nsex + (*danish.sex_aggregator)(row);
+        const long bucket_column = long((*danish.kommune_aggregator)(row)) * nage + (*danish.age_aggregator)(row);
+        for (int copy = 0; copy < scale; ++copy) {
+            const int element = copy * nrows + row;
+            cells[element] = bucket_row + (bucket_column + copy * column_buckets) * row_buckets;
+            elements[element] = element;
+        }
+    }
+}
+
+}
+
+void TestCellStore::testAgainstHash() {
+    CellStore store;
+    QHash<long, QList<int> > reference;
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const long cell = (seed >> 8) % 97;
+        seed = seed * 1103515245u + 12345u;
+        const int element = (seed >> 8) % 1000;
+        if ((seed >> 4) % 3 == 0) {
+            const bool removed = reference[cell].removeOne(element);
+            if (reference.value(cell).isEmpty()) {
+                reference.remove(cell);
+            }
+            QCOMPARE(store.removeOne(cell, element), removed);
+        } else {
+            reference[cell].append(element);
+            store.append(cell, element);
+        }
+        QCOMPARE(store.contains(cell), reference.contains(cell));
+        QCOMPARE(store.size(cell), reference.value(cell).size());
+    }
+    compare(store, reference);
+    store.squeeze();
+    compare(store, reference);
+    for (QHash<long, QList<int> >::const_iterator it = reference.constBegin(); it != reference.constEnd(); ++it) {
+        Q_FOREACH(int element, it.value()) {
+            QVERIFY(store.removeOne(it.key(), element));
+        }
+    }
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.elementCount(), 0);
+    QVERIFY(store.constBegin() == store.constEnd());
+}
+
+void TestCellStore::testSet() {
+    CellStore store;
+    QList<int> content;
+    content << 3 << 1 << 2;
+    store.set(10, content);
+    store.append(11, 7);
+    QCOMPARE(store.elements(10), content);
+    content << 5 << 8 << 13 << 21;
+    store.set(10, content);
+    QCOMPARE(store.elements(10), content);
+    QCOMPARE(store.elementCount(), 8);
+    store.set(10, QList<int>());
+    QVERIFY(!store.contains(10));
+    QCOMPARE(store.elements(11), QList<int>() << 7);
+    QCOMPARE(store.elementCount(), 1);
+    for (CellStore::iterator it = store.begin(); it != store.end(); ++it) {
+        for (int* element = it.begin(); element != it.end(); ++element) {
+            *element += 1;
+        }
+    }
+    QCOMPARE(store.elements(11), QList<int>() << 8);
+    store.clear();
+    QCOMPARE(store.count(), 0);
+    QVERIFY(!store.contains(11));
+}
+
+void TestCellStore::testAssign() {
+    QVector<long> cell_for_element;
+    QHash<long, QList<int> > reference;
+    for (int element = 0; element < 1000; ++element) {
+        const long cell = element % 7 == 0 ? -1 : (element * 31) % 101;
+        cell_for_element << cell;
+        if (cell >= 0) {
+            reference[cell].append(element);
+        }
+    }
+    CellStore store;
+    store.append(5000, 1);
+    store.assign(cell_for_element);
+    compare(store, reference);
+    // Assigned without slack, so squeezing has nothing to reclaim in the elements
+    const qint64 usage = store.memoryUsage();
+    store.squeeze();
+    QVERIFY(store.memoryUsage() <= usage);
+    compare(store, reference);
+    // The store stays usable after a bulk assignment
+    store.append(3, 2000);
+    reference[3].append(2000);
+    QVERIFY(store.removeOne(10, reference.value(10).first()));
+    reference[10].removeFirst();
+    compare(store, reference);
+}
+
+void TestCellStore::testRemap() {
+    // 5 rows and 4 columns. Row 2 goes away and the others spread out, column 3 moves to 0
+    const int nrows = 5;
+    QVector<int> row_map;
+    row_map << 0 << 2 << -1 << 6 << 8;
+    QVector<int> column_map;
+    column_map << 1 << 2 << 3 << 0;
+    const int new_nrows = 10;
+    CellStore store;
+    QHash<long, QList<int> > reference;
+    int element = 0;
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < nrows; ++row) {
+            for (int i = 0; i <= (row + column) % 3; ++i) {
+                store.append(row + column*nrows, element);
+                if (row_map.at(row) >= 0) {
+                    reference[row_map.at(row) + column_map.at(column)*new_nrows].append(element);
+                }
+                ++element;
+            }
+        }
+    }
+    store.remap(nrows, row_map, column_map, new_nrows);
+    compare(store, reference);
+
+    // Columns only, leaving the rows
+    QHash<long, QList<int> > moved;
+    for (QHash<long, QList<int> >::const_iterator it = reference.constBegin(); it != reference.constEnd(); ++it) {
+        moved.insert(it.key() % new_nrows + (3 - it.key() / new_nrows)*new_nrows, it.value());
+    }
+    QVector<int> reverse;
+    reverse << 3 << 2 << 1 << 0;
+    store.remap(new_nrows, QVector<int>(), reverse, new_nrows);
+    compare(store, moved);
+
+    // Dropping everything
+    store.remap(new_nrows, QVector<int>(new_nrows, -1), QVector<int>(), new_nrows);
+    QCOMPARE(store.count(), 0);
+    QCOMPARE(store.elementCount(), 0);
+}
+
+void TestCellStore::testMemoryUsage() {
+    QVector<long> cells;
+    QVector<int> elements;
+    scaled_danish_cells(1000, cells, elements);
+    CellStore store;
+    QHash<long, QList<int> > reference;
+    for (int i = 0; i < cells.size(); ++i) {
+        store.append(cells.at(i), elements.at(i));
+        reference[cells.at(i)].append(elements.at(i));
+    }
+    QCOMPARE(store.count(), reference.size());
+    QCOMPARE(store.elementCount(), elements.size());
+    const qint64 hash_usage = hash_memory_usage(reference.capacity(), reference.size(), elements.size());
+    // Well below even the lower bound for the hash, before and after squeezing
+    QVERIFY(2 * store.memoryUsage() < hash_usage);
+    store.squeeze();
+    QVERIFY(2 * store.memoryUsage() < hash_usage);
+    QVERIFY(store.memoryUsage() >= qint64(store.elementCount()) * qint64(sizeof(int)));
+}
+
+void TestCellStore::benchmarkAppend() {
+    QVector<long> cells;
+    QVector<int> elements;
+    scaled_danish_cells(1000, cells, elements);
+    CellStore store;
+    QBENCHMARK {
+        store.clear();
+        for (int i = 0; i < cells.size(); ++i) {
+            store.append(cells.at(i), elements.at(i));
+        }
+    }
+    QCOMPARE(store.elementCount(), elements.size());
+    const qint64 usage = store.memoryUsage();
+    store.squeeze();
+    QVERIFY(store.memoryUsage() <= usage);
+    QCOMPARE(store.elementCount(), elements.size());
+}
+
+#include "testcellstore.moc"
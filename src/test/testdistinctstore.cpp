@@ -0,0 +1,90 @@
+#include "distinctstore.h"
+#include "cellstore.h"
+
+#include <QObject>
+#include <QSet>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestDistinctStore : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random adds and removes with sketches asked for in between, compared to exact counts.
+     * The cells are small enough for the sketches to stay exact
+     */
+    void testAgainstScan();
+};
+QTEST_GUILESS_MAIN(TestDistinctStore)
+
+namespace {
+
+const int nrows = 4;
+const int ncolumns = 3;
+
+int distinct_values(const QVector<long>& cell_of, const QVector<int>& values, int row, int column) {
+    QSet<int> rv;
+    for (int element = 0; element < cell_of.size(); ++element) {
+        const long cell = cell_of.at(element);
+        if (cell >= 0 && (row < 0 || cell % nrows == row) && (column < 0 || cell / nrows == column)) {
+            rv << values.at(element);
+        }
+    }
+    return rv.size();
+}
+
+void compare(DistinctStore& store, const CellStore& cells, const QVector<long>& cell_of, const QVector<int>& values) {
+    for (int row = 0; row < nrows; ++row) {
+        for (int column = 0; column < ncolumns; ++column) {
+            QCOMPARE(int(store.cellSketch(0, row + column*nrows, cells).estimate()), distinct_values(cell_of, values, row, column));
+        }
+        QCOMPARE(int(store.rowSketch(0, row, cells, nrows, ncolumns).estimate()), distinct_values(cell_of, values, row, -1));
+    }
+    for (int column = 0; column < ncolumns; ++column) {
+        QCOMPARE(int(store.columnSketch(0, column, cells, nrows).estimate()), distinct_values(cell_of, values, -1, column));
+    }
+    QCOMPARE(int(store.totalSketch(0, cells).estimate()), distinct_values(cell_of, values, -1, -1));
+}
+
+}
+
+void TestDistinctStore::testAgainstScan() {
+    const int nelements = 200;
+    CellStore cells;
+    DistinctStore store;
+    QCOMPARE(store.addColumn(7), 0);
+    QCOMPARE(store.indexOf(7), 0);
+    QCOMPARE(store.indexOf(3), -1);
+    QVector<long> cell_of(nelements, -1);
+    QVector<int> values(nelements);
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int i = 0; i < 5000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int element = (seed >> 8) % nelements;
+        if (cell_of.at(element) >= 0) {
+            const long cell = cell_of.at(element);
+            cells.removeOne(cell, element);
+            store.remove(cell, cell % nrows, cell / nrows);
+            cell_of[element] = -1;
+        } else {
+            seed = seed * 1103515245u + 12345u;
+            const long cell = (seed >> 8) % (nrows*ncolumns);
+            values[element] = (seed >> 16) % 40;
+            store.setHash(0, element, HyperLogLog::hash(QString::number(values.at(element))));
+            cells.append(cell, element);
+            store.add(cell, cell % nrows, cell / nrows, element);
+            cell_of[element] = cell;
+        }
+        if (i % 250 == 0) {
+            compare(store, cells, cell_of, values);
+        }
+    }
+    compare(store, cells, cell_of, values);
+    store.clear();
+    compare(store, cells, cell_of, values);
+}
+
+#include "testdistinctstore.moc"
@@ -0,0 +1,97 @@
+#include "elementmap.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestElementMap : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random inserts and removes, compared to a plain list of ids
+     */
+    void testAgainstList();
+
+    /**
+     * Appending and removing from the end keeps ids equal to rows
+     */
+    void testIdentity();
+};
+QTEST_GUILESS_MAIN(TestElementMap)
+
+namespace {
+
+void compare(const ElementMap& map, const QVector<int>& ids) {
+    QCOMPARE(map.rowCount(), ids.size());
+    QCOMPARE(map.ids(), ids);
+    const QVector<int> rows = map.rows();
+    QCOMPARE(rows.size(), map.idCount());
+    for (int row = 0; row < ids.size(); ++row) {
+        QCOMPARE(map.id(row), ids.at(row));
+        QCOMPARE(map.row(ids.at(row)), row);
+        QCOMPARE(rows.at(ids.at(row)), row);
+    }
+}
+
+}
+
+void TestElementMap::testAgainstList() {
+    ElementMap map;
+    map.reset(1000);
+    QVector<int> ids;
+    for (int row = 0; row < 1000; ++row) {
+        ids << row;
+    }
+    quint32 seed = 4711;
+    for (int i = 0; i < 200; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int count = (seed >> 8) % 20;
+        seed = seed * 1103515245u + 12345u;
+        if ((seed >> 16) % 2 == 0) {
+            const int start = (seed >> 4) % (ids.size() + 1);
+            QVector<int> rows_before = map.rows();
+            map.insertRows(start, count);
+            for (int j = 0; j < count; ++j) {
+                const int id = map.id(start + j);
+                // New ids must not be in use already
+                QVERIFY(id >= rows_before.size() || rows_before.at(id) == -1);
+                ids.insert(start + j, id);
+            }
+        } else {
+            const int n = qMin(count, ids.size());
+            const int start = (seed >> 4) % (ids.size() - n + 1);
+            map.removeRows(start, n);
+            ids.remove(start, n);
+        }
+        if (i % 20 == 0) {
+            compare(map, ids);
+        }
+    }
+    compare(map, ids);
+    QVERIFY(!map.isIdentity());
+    map.removeRows(0, ids.size());
+    QVERIFY(map.isIdentity());
+    QCOMPARE(map.rowCount(), 0);
+}
+
+void TestElementMap::testIdentity() {
+    ElementMap map;
+    map.reset(10);
+    map.insertRows(10, 5);
+    map.removeRows(12, 3);
+    QVERIFY(map.isIdentity());
+    QCOMPARE(map.rowCount(), 12);
+    QCOMPARE(map.id(11), 11);
+    QCOMPARE(map.row(11), 11);
+
+    // An insert at the front has to give the new row a new id
+    map.insertRows(0, 1);
+    QVERIFY(!map.isIdentity());
+    QCOMPARE(map.id(0), 12);
+    QCOMPARE(map.row(0), 1);
+    QCOMPARE(map.row(11), 12);
+}
+
+#include "testelementmap.moc"
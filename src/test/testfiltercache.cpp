@@ -0,0 +1,184 @@
+#include "filtercache.h"
+
+#include <QBitArray>
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestFilterCache : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random filters added, removed, changed and replaced, compared to rejecting sets kept per filter
+     */
+    void testAgainstSets();
+
+    /**
+     * Filters not evaluated for elements already rejected leave those unknown, until evaluated
+     */
+    void testUnknown();
+};
+QTEST_GUILESS_MAIN(TestFilterCache)
+
+namespace {
+
+const int nelements = 300;
+
+/**
+ * Check the cache against rejects, a list per filter of whether each element is rejected
+ */
+void compare(const FilterCache& cache, const QList<QBitArray >& rejects) {
+    QCOMPARE(cache.filterCount(), rejects.size());
+    for (int element = 0; element < nelements; ++element) {
+        int count = 0;
+        for (int filter = 0; filter < rejects.size(); ++filter) {
+            QCOMPARE(cache.rejects(filter, element), rejects.at(filter).testBit(element));
+            count += rejects.at(filter).testBit(element) ? 1 : 0;
+        }
+        QCOMPARE(cache.rejectCount(element), count);
+        QCOMPARE(cache.isIncluded(element), count == 0);
+    }
+}
+
+QList<int> included(const QList<QBitArray >& rejects) {
+    QList<int> rv;
+    for (int element = 0; element < nelements; ++element) {
+        bool in = true;
+        Q_FOREACH(const QBitArray& filter, rejects) {
+            in = in && !filter.testBit(element);
+        }
+        if (in) {
+            rv << element;
+        }
+    }
+    return rv;
+}
+
+/**
+ * Make a filter rejecting one element in a random 1 to 8, as a bit array and as words
+ */
+QVector<quint64> random_filter(quint32& seed, QBitArray& filter) {
+    filter = QBitArray(nelements);
+    QVector<quint64> words((nelements + 63) >> 6);
+    seed = seed * 1103515245u + 12345u;
+    const int one_in = 1 + (seed >> 8) % 8;
+    for (int element = 0; element < nelements; ++element) {
+        seed = seed * 1103515245u + 12345u;
+        filter.setBit(element, (seed >> 8) % one_in == 0);
+        if (filter.testBit(element)) {
+            words[element >> 6] |= Q_UINT64_C(1) << (element & 63);
+        }
+    }
+    return words;
+}
+
+QList<int> difference(const QList<int>& lhs, const QList<int>& rhs) {
+    QList<int> rv;
+    Q_FOREACH(int element, lhs) {
+        if (!rhs.contains(element)) {
+            rv << element;
+        }
+    }
+    return rv;
+}
+
+}
+
+void TestFilterCache::testAgainstSets() {
+    FilterCache cache;
+    cache.reset(nelements);
+    QList<QBitArray > rejects;
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int i = 0; i < 200; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int action = (seed >> 8) % 5;
+        const QList<int> before = included(rejects);
+        if (action == 0 || rejects.isEmpty()) {
+            QBitArray filter;
+            const QVector<quint64> words = random_filter(seed, filter);
+            rejects << filter;
+            QCOMPARE(cache.appendFilter(words), difference(before, included(rejects)));
+        } else if (action == 1) {
+            const int filter = (seed >> 16) % rejects.size();
+            rejects.removeAt(filter);
+            QCOMPARE(cache.removeFilter(filter), difference(included(rejects), before));
+        } else if (action == 2) {
+            const int filter = (seed >> 16) % rejects.size();
+            seed = seed * 1103515245u + 12345u;
+            const int element = (seed >> 8) % nelements;
+            const bool rejected = (seed >> 20) % 2;
+            rejects[filter].setBit(element, rejected);
+            cache.setRejected(filter, element, rejected);
+        } else if (action == 3) {
+            seed = seed * 1103515245u + 12345u;
+            const int element = (seed >> 8) % nelements;
+            for (int filter = 0; filter < rejects.size(); ++filter) {
+                rejects[filter].clearBit(element);
+            }
+            cache.removeElement(element);
+        } else if (action == 4) {
+            const int index = (seed >> 16) % rejects.size();
+            QBitArray filter;
+            const QVector<quint64> words = random_filter(seed, filter);
+            rejects[index] = filter;
+            QList<int> excluded;
+            QList<int> now_included;
+            cache.replaceFilter(index, words, QVector<quint64>(), excluded, now_included);
+            QCOMPARE(excluded, difference(before, included(rejects)));
+            QCOMPARE(now_included, difference(included(rejects), before));
+        }
+        compare(cache, rejects);
+    }
+}
+
+void TestFilterCache::testUnknown() {
+    FilterCache cache;
+    cache.reset(nelements);
+    // The first filter rejects the even elements, so the second is only run for the odd ones
+    QVector<quint64> even((nelements + 63) >> 6);
+    QVector<quint64> odd_threes((nelements + 63) >> 6);
+    for (int element = 0; element < nelements; ++element) {
+        if (element % 2 == 0) {
+            even[element >> 6] |= Q_UINT64_C(1) << (element & 63);
+        } else if (element % 3 == 0) {
+            odd_threes[element >> 6] |= Q_UINT64_C(1) << (element & 63);
+        }
+    }
+    cache.appendFilter(even);
+    QCOMPARE(cache.appendFilter(odd_threes, even).size(), nelements/6);
+    for (int element = 0; element < nelements; ++element) {
+        QCOMPARE(cache.isUnknown(1, element), element % 2 == 0);
+        QCOMPARE(cache.hasUnknown(element), element % 2 == 0);
+        QCOMPARE(cache.isIncluded(element), element % 2 == 1 && element % 3 != 0);
+        const bool excluded = cache.excluded().at(element >> 6) & (Q_UINT64_C(1) << (element & 63));
+        QCOMPARE(excluded, !cache.isIncluded(element));
+    }
+
+    // Removing the first filter leaves the even elements with no rejects, but unknown
+    const QList<int> candidates = cache.removeFilter(0);
+    QCOMPARE(candidates.size(), (nelements + 1)/2);
+    Q_FOREACH(int element, candidates) {
+        QCOMPARE(element % 2, 0);
+        QVERIFY(cache.hasUnknown(element));
+        cache.setRejected(0, element, element % 3 == 0);
+        QVERIFY(!cache.hasUnknown(element));
+    }
+    for (int element = 0; element < nelements; ++element) {
+        QCOMPARE(cache.isIncluded(element), element % 3 != 0);
+    }
+
+    // An element known to be rejected can become unknown again, if another filter rejects it
+    cache.appendFilter(QVector<quint64>());
+    cache.setRejected(1, 3, true);
+    cache.setUnknown(0, 3);
+    QCOMPARE(cache.rejectCount(3), 1);
+    QVERIFY(cache.hasUnknown(3));
+    cache.removeElement(3);
+    QVERIFY(!cache.hasUnknown(3));
+    QCOMPARE(cache.rejectCount(3), 0);
+}
+
+#include "testfiltercache.moc"
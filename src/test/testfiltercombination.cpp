@@ -0,0 +1,126 @@
+#include "filtercombination.h"
+
+#include "andfilter.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QStandardItemModel>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestFilterCombination : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Stopping on reject ands the filters and stopping on pass ors them, evaluating no filter after the decisive one
+     */
+    void testShortCircuit();
+
+    /**
+     * An adaptive combination learns to evaluate the decisive filter first, and is not thread safe
+     */
+    void testAdaptive();
+
+    /**
+     * Batches are evaluated by a program kept until a filter is added
+     */
+    void testEvaluate();
+};
+QTEST_GUILESS_MAIN(TestFilterCombination)
+
+namespace {
+
+/**
+ * Includes the rows with row % modulo == remainder, counting its evaluations
+ */
+class ModuloFilter : public AbstractFilter {
+    public:
+        ModuloFilter(const QAbstractItemModel* model, int modulo, int remainder)
+          : AbstractFilter(model), m_modulo(modulo), m_remainder(remainder), m_evaluations(0) {}
+        virtual bool operator()(int row) const {
+            ++m_evaluations;
+            return row % m_modulo == m_remainder;
+        }
+        virtual bool isThreadSafe() const {
+            return true;
+        }
+        int evaluations() const {
+            return m_evaluations;
+        }
+    private:
+        int m_modulo;
+        int m_remainder;
+        mutable int m_evaluations;
+};
+
+}
+
+void TestFilterCombination::testShortCircuit() {
+    QStandardItemModel model(10, 1);
+    QSharedPointer<ModuloFilter> even(new ModuloFilter(&model, 2, 0));
+    QSharedPointer<ModuloFilter> third(new ModuloFilter(&model, 3, 0));
+    FilterCombination and_filters(FilterOrder::StopOnReject);
+    FilterCombination or_filters(FilterOrder::StopOnPass);
+    QVERIFY(and_filters(0));
+    QVERIFY(!or_filters(0));
+    and_filters.append(even);
+    and_filters.append(third);
+    or_filters.append(even);
+    or_filters.append(third);
+    QCOMPARE(and_filters.filters().size(), 2);
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QCOMPARE(and_filters(row), row % 6 == 0);
+    }
+    // The third filter is only evaluated for the even rows
+    QCOMPARE(third->evaluations(), 5);
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QCOMPARE(or_filters(row), row % 2 == 0 || row % 3 == 0);
+    }
+    // ... and now only for the odd rows
+    QCOMPARE(third->evaluations(), 10);
+    QCOMPARE(even->evaluations(), 20);
+    QVERIFY(and_filters.isThreadSafe());
+}
+
+void TestFilterCombination::testAdaptive() {
+    QStandardItemModel model(4000, 1);
+    QSharedPointer<ModuloFilter> always(new ModuloFilter(&model, 1, 0));
+    QSharedPointer<ModuloFilter> rare(new ModuloFilter(&model, 10, 3));
+    FilterCombination filters(FilterOrder::StopOnReject);
+    filters.append(always);
+    filters.append(rare);
+    QVERIFY(!filters.isAdaptive());
+    filters.setAdaptive(true);
+    QVERIFY(!filters.isThreadSafe());
+    for (int row = 0; row < model.rowCount(); ++row) {
+        QCOMPARE(filters(row), row % 10 == 3);
+    }
+    QCOMPARE(filters.statistics().size(), 2);
+    QCOMPARE(filters.statistics().at(1).position(), 0);
+    QCOMPARE(filters.statistics().at(0).passRate(), 1.0);
+    QVERIFY(filters.statistics().at(1).passRate() < 0.2);
+    // Once rare is first, always is only evaluated for the rows rare passes
+    const int evaluations = always->evaluations();
+    for (int row = 0; row < 1000; ++row) {
+        filters(row);
+    }
+    QCOMPARE(always->evaluations() - evaluations, 100);
+}
+
+void TestFilterCombination::testEvaluate() {
+    QStandardItemModel model(100, 1);
+    AndFilter and_filter(&model);
+    and_filter.addFilter(AbstractFilter::Ptr(new ModuloFilter(&model, 2, 0)));
+    QVector<quint64> included(2);
+    and_filter.evaluate(0, 100, included.data());
+    QCOMPARE(included.at(0), Q_UINT64_C(0x5555555555555555));
+    and_filter.addFilter(AbstractFilter::Ptr(new ModuloFilter(&model, 4, 0)));
+    and_filter.evaluate(0, 100, included.data());
+    QCOMPARE(included.at(0), Q_UINT64_C(0x1111111111111111));
+    and_filter.evaluate(0, 100, included.data());
+    QCOMPARE(included.at(1), Q_UINT64_C(0x111111111));
+}
+
+#include "testfiltercombination.moc"
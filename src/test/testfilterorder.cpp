@@ -0,0 +1,111 @@
+#include "filterorder.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestFilterOrder : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * When and'ing, the filter rejecting the most comes first, and when or'ing, the filter passing the most
+     */
+    void testPassRates();
+
+    /**
+     * Of filters rejecting equally often, the cheapest comes first
+     */
+    void testCost();
+
+    /**
+     * Removing a filter renumbers those after it, keeping their statistics and order, and clearing a filter
+     * keeps its position
+     */
+    void testRemove();
+};
+QTEST_GUILESS_MAIN(TestFilterOrder)
+
+namespace {
+
+/**
+ * Evaluate the filters with pass rates of 1 in passes_one_in[index] (0 meaning never), short circuiting as order does,
+ * each taking the same time
+ */
+void evaluate(FilterOrder& order, const QVector<int>& passes_one_in, int nevaluations, bool stop_on_reject) {
+    for (int evaluation = 0; evaluation < nevaluations; ++evaluation) {
+        const bool timed = order.beginEvaluation();
+        for (int position = 0; position < order.count(); ++position) {
+            const int index = order.order().at(position);
+            const bool passed = passes_one_in.at(index) > 0 && evaluation % passes_one_in.at(index) == 0;
+            order.record(index, passed, timed ? 100 : -1);
+            if (passed != stop_on_reject) {
+                break;
+            }
+        }
+    }
+}
+
+}
+
+void TestFilterOrder::testPassRates() {
+    QVector<int> passes_one_in;
+    passes_one_in << 1 << 2 << 10;
+    FilterOrder and_order(FilterOrder::StopOnReject);
+    and_order.reset(3);
+    evaluate(and_order, passes_one_in, 5000, true);
+    QCOMPARE(and_order.order(), QVector<int>() << 2 << 1 << 0);
+    QCOMPARE(and_order.statistics(2).position(), 0);
+    QVERIFY(and_order.statistics(2).evaluations() > 0);
+    QVERIFY(and_order.statistics(2).passRate() < and_order.statistics(1).passRate());
+    QCOMPARE(and_order.statistics(0).passRate(), 1.0);
+    QVERIFY(and_order.statistics(2).timedEvaluations() > 0);
+    QVERIFY(and_order.statistics(2).cost() > 100.0);
+
+    FilterOrder or_order(FilterOrder::StopOnPass);
+    or_order.reset(3);
+    evaluate(or_order, passes_one_in, 5000, false);
+    QCOMPARE(or_order.order().first(), 0);
+    QCOMPARE(or_order.statistics(0).position(), 0);
+}
+
+void TestFilterOrder::testCost() {
+    FilterOrder order(FilterOrder::StopOnReject);
+    order.reset(2);
+    for (int evaluation = 0; evaluation < 100; ++evaluation) {
+        order.record(0, evaluation % 2 == 0, 1000);
+        order.record(1, evaluation % 2 == 0, 10);
+    }
+    order.reorder();
+    QCOMPARE(order.order(), QVector<int>() << 1 << 0);
+    QCOMPARE(order.statistics(0).passRate(), 0.5);
+    QCOMPARE(order.statistics(1).position(), 0);
+}
+
+void TestFilterOrder::testRemove() {
+    FilterOrder order(FilterOrder::StopOnReject);
+    order.reset(3);
+    for (int evaluation = 0; evaluation < 100; ++evaluation) {
+        order.record(0, true, 10);
+        order.record(1, evaluation % 2 == 0, 10);
+        order.record(2, evaluation % 10 == 0, 10);
+    }
+    order.reorder();
+    QCOMPARE(order.order(), QVector<int>() << 2 << 1 << 0);
+    order.remove(1);
+    QCOMPARE(order.count(), 2);
+    QCOMPARE(order.order(), QVector<int>() << 1 << 0);
+    QCOMPARE(order.statistics(1).evaluations(), qint64(100));
+    QCOMPARE(order.statistics(1).position(), 0);
+    QCOMPARE(order.statistics(0).position(), 1);
+    order.append();
+    QCOMPARE(order.order(), QVector<int>() << 1 << 0 << 2);
+    QCOMPARE(order.statistics(2).evaluations(), qint64(0));
+    order.clear(1);
+    QCOMPARE(order.statistics(1).evaluations(), qint64(0));
+    QCOMPARE(order.statistics(1).position(), 0);
+    QCOMPARE(order.order(), QVector<int>() << 1 << 0 << 2);
+}
+
+#include "testfilterorder.moc"
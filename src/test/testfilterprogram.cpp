@@ -0,0 +1,194 @@
+#include "filterprogram.h"
+
+#include "andfilter.h"
+#include "orfilter.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QStandardItemModel>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestFilterProgram : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Nested ands and ors are merged into their parents when of the same kind
+     */
+    void testCompile();
+
+    /**
+     * Batches of any size and alignment agree with operator()
+     */
+    void testEvaluate();
+
+    /**
+     * Children are not evaluated once the batch is decided
+     */
+    void testShortCircuit();
+
+    /**
+     * Children are compiled in evaluation order, and the batches of adaptive filters are recorded
+     */
+    void testAdaptive();
+};
+QTEST_GUILESS_MAIN(TestFilterProgram)
+
+namespace {
+
+/**
+ * Includes the rows with row % modulo == remainder, counting the batches evaluated
+ */
+class ModuloFilter : public AbstractFilter {
+    public:
+        ModuloFilter(const QAbstractItemModel* model, int modulo, int remainder)
+          : AbstractFilter(model), m_modulo(modulo), m_remainder(remainder), m_batches(0) {}
+        virtual bool operator()(int row) const {
+            return row % m_modulo == m_remainder;
+        }
+        virtual void evaluate(int begin, int end, quint64* included) const {
+            ++m_batches;
+            AbstractFilter::evaluate(begin, end, included);
+        }
+        int batches() const {
+            return m_batches;
+        }
+    private:
+        int m_modulo;
+        int m_remainder;
+        mutable int m_batches;
+};
+
+AbstractFilter::Ptr modulo(const QAbstractItemModel* model, int modulo, int remainder) {
+    return AbstractFilter::Ptr(new ModuloFilter(model, modulo, remainder));
+}
+
+}
+
+void TestFilterProgram::testCompile() {
+    QStandardItemModel model(10, 1);
+    QSharedPointer<AndFilter> inner_and(new AndFilter(&model));
+    inner_and->addFilter(modulo(&model, 2, 0));
+    inner_and->addFilter(modulo(&model, 3, 0));
+    QSharedPointer<OrFilter> inner_or(new OrFilter(&model));
+    inner_or->addFilter(modulo(&model, 5, 0));
+    QSharedPointer<OrFilter> innermost_or(new OrFilter(&model));
+    innermost_or->addFilter(modulo(&model, 7, 0));
+    inner_or->addFilter(innermost_or);
+    AndFilter root(&model);
+    root.addFilter(modulo(&model, 11, 0));
+    root.addFilter(inner_and);
+    root.addFilter(inner_or);
+    const FilterProgram program(root);
+    // The root, its four children and the two leaves of the or
+    QCOMPARE(program.size(), 7);
+    QCOMPARE(program.leafCount(), 5);
+    const FilterProgram leaf(*inner_and->filters().first());
+    QCOMPARE(leaf.size(), 1);
+    QCOMPARE(leaf.leafCount(), 1);
+}
+
+void TestFilterProgram::testEvaluate() {
+    QStandardItemModel model(1000, 1);
+    QSharedPointer<OrFilter> or_filter(new OrFilter(&model));
+    or_filter->addFilter(modulo(&model, 3, 1));
+    or_filter->addFilter(modulo(&model, 5, 2));
+    QSharedPointer<AndFilter> and_filter(new AndFilter(&model));
+    and_filter->addFilter(or_filter);
+    and_filter->addFilter(modulo(&model, 2, 0));
+    and_filter->addFilter(AbstractFilter::Ptr(new AndFilter(&model)));
+    OrFilter root(&model);
+    root.addFilter(and_filter);
+    root.addFilter(modulo(&model, 7, 6));
+    root.addFilter(AbstractFilter::Ptr(new OrFilter(&model)));
+    QList<AbstractFilter*> filters;
+    filters << &root << and_filter.data() << or_filter.data();
+    QList<QPair<int, int> > ranges;
+    ranges << qMakePair(0, 1000) << qMakePair(0, 64) << qMakePair(3, 67) << qMakePair(100, 101) << qMakePair(999, 1000)
+           << qMakePair(17, 500);
+    Q_FOREACH(AbstractFilter* filter, filters) {
+        const FilterProgram program(*filter);
+        typedef QPair<int, int> range_t;
+        Q_FOREACH(range_t range, ranges) {
+            QVector<quint64> included((range.second - range.first + 63) >> 6, ~Q_UINT64_C(0));
+            program.evaluate(range.first, range.second, included.data());
+            QVector<quint64> via_filter(included.size(), ~Q_UINT64_C(0));
+            filter->evaluate(range.first, range.second, via_filter.data());
+            QCOMPARE(via_filter, included);
+            for (int row = range.first; row < range.second; ++row) {
+                const int i = row - range.first;
+                QCOMPARE(bool(included.at(i >> 6) & (Q_UINT64_C(1) << (i & 63))), (*filter)(row));
+            }
+            // Bits past the end are clear
+            const int nrows = range.second - range.first;
+            if (nrows & 63) {
+                QCOMPARE(included.last() >> (nrows & 63), Q_UINT64_C(0));
+            }
+        }
+    }
+}
+
+void TestFilterProgram::testShortCircuit() {
+    QStandardItemModel model(100, 1);
+    QSharedPointer<ModuloFilter> never(new ModuloFilter(&model, 1, 1));
+    QSharedPointer<ModuloFilter> always(new ModuloFilter(&model, 1, 0));
+    QSharedPointer<ModuloFilter> counted(new ModuloFilter(&model, 2, 0));
+    AndFilter and_filter(&model);
+    and_filter.addFilter(never);
+    and_filter.addFilter(counted);
+    OrFilter or_filter(&model);
+    or_filter.addFilter(always);
+    or_filter.addFilter(counted);
+    QVector<quint64> included(2);
+    FilterProgram(and_filter).evaluate(0, 100, included.data());
+    QCOMPARE(included, QVector<quint64>(2, 0));
+    FilterProgram(or_filter).evaluate(0, 100, included.data());
+    QCOMPARE(included.at(0), ~Q_UINT64_C(0));
+    QCOMPARE(included.at(1), (Q_UINT64_C(1) << 36) - 1);
+    QCOMPARE(counted->batches(), 0);
+    // Undecided rows do evaluate the next child
+    OrFilter undecided(&model);
+    undecided.addFilter(counted);
+    undecided.addFilter(never);
+    FilterProgram(undecided).evaluate(0, 100, included.data());
+    QCOMPARE(counted->batches(), 1);
+    QCOMPARE(never->batches(), 2);
+}
+
+void TestFilterProgram::testAdaptive() {
+    QStandardItemModel model(4096, 1);
+    QSharedPointer<ModuloFilter> always(new ModuloFilter(&model, 1, 0));
+    QSharedPointer<ModuloFilter> rare(new ModuloFilter(&model, 10, 3));
+    AndFilter and_filter(&model);
+    and_filter.addFilter(always);
+    and_filter.addFilter(rare);
+    QVector<quint64> included(64);
+    const FilterProgram in_added_order(and_filter);
+    in_added_order.evaluate(0, 4096, included.data());
+    // Not adaptive, so nothing recorded
+    QCOMPARE(and_filter.statistics().at(0).evaluations(), qint64(0));
+    and_filter.setAdaptive(true);
+    in_added_order.beginEvaluations(4096);
+    in_added_order.evaluate(0, 4096, included.data());
+    QCOMPARE(and_filter.statistics().at(0).evaluations(), qint64(4096));
+    QCOMPARE(and_filter.statistics().at(1).passes(), qint64(410));
+    QVERIFY(in_added_order.isCurrent());
+    // Enough evaluations to reorder, rare first
+    in_added_order.beginEvaluations(4096);
+    QVERIFY(!in_added_order.isCurrent());
+    QCOMPARE(and_filter.statistics().at(1).position(), 0);
+    const FilterProgram reordered(and_filter);
+    QVERIFY(reordered.isCurrent());
+    const int batches = always->batches();
+    reordered.evaluate(0, 64, included.data());
+    QCOMPARE(rare->batches(), 3);
+    QCOMPARE(always->batches(), batches + 1);
+    // Rows 3, 13, ..., 63
+    QCOMPARE(and_filter.statistics().at(1).passes(), qint64(410 + 7));
+    and_filter.addFilter(modulo(&model, 2, 1));
+    QVERIFY(!reordered.isCurrent());
+}
+
+#include "testfilterprogram.moc"
@@ -0,0 +1,102 @@
+#include "headerindex.h"
+#include "bucketindex.h"
+#include "bucketorder.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestHeaderIndex : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Header sections of each level compared to a walk over the counts, also after patching counts
+     */
+    void testAgainstScan();
+};
+QTEST_GUILESS_MAIN(TestHeaderIndex)
+
+namespace {
+
+void compare(HeaderIndex& headers, int level, const QVector<unsigned>& counts, const BucketIndex& index, const BucketOrder& order) {
+    if (!headers.isValid(level)) {
+        headers.build(level, counts, MeasureTotals(), index, order);
+    }
+    const int stride = headers.stride(level);
+    int header_section = 0;
+    int section = 0;
+    for (int group = 0; group*stride < counts.size(); ++group) {
+        int span = 0;
+        int count = 0;
+        for (int bucket = group*stride; bucket < (group+1)*stride; ++bucket) {
+            if (counts.at(bucket) > 0) {
+                ++span;
+                count += counts.at(bucket);
+            }
+        }
+        if (span == 0) {
+            continue;
+        }
+        QCOMPARE(headers.group(level, header_section), group);
+        QCOMPARE(headers.firstSection(level, header_section), section);
+        QCOMPARE(headers.span(level, header_section), span);
+        QCOMPARE(headers.elementCount(level, header_section), count);
+        for (int i = 0; i < span; ++i) {
+            QCOMPARE(headers.headerSection(level, section + i), header_section);
+        }
+        section += span;
+        ++header_section;
+    }
+    QCOMPARE(headers.count(level), header_section);
+    QCOMPARE(headers.headerSection(level, section), -1);
+}
+
+}
+
+void TestHeaderIndex::testAgainstScan() {
+    // Three levels of 3, 5 and 4 categories
+    QVector<int> strides;
+    strides << 20 << 4 << 1;
+    QVector<unsigned> counts(60);
+    quint32 seed = 4711;
+    for (int bucket = 0; bucket < counts.size(); ++bucket) {
+        seed = seed * 1103515245u + 12345u;
+        counts[bucket] = (seed >> 16) % 3 == 0 ? (seed >> 20) % 5 + 1 : 0;
+    }
+    BucketOrder order;
+    BucketIndex index;
+    index.reset(counts);
+    HeaderIndex headers;
+    headers.reset(strides);
+    for (int level = 0; level < strides.size(); ++level) {
+        compare(headers, level, counts, index, order);
+    }
+
+    // Counts staying above 0 are patched
+    for (int bucket = 0; bucket < counts.size(); ++bucket) {
+        if (counts.at(bucket) > 1) {
+            --counts[bucket];
+            headers.addCount(bucket, -1);
+        } else if (counts.at(bucket) == 1) {
+            ++counts[bucket];
+            headers.addCount(bucket, 1);
+        }
+    }
+    for (int level = 0; level < strides.size(); ++level) {
+        QVERIFY(headers.isValid(level));
+        compare(headers, level, counts, index, order);
+    }
+
+    // Buckets turning empty or non-empty call for a rebuild
+    counts[0] = counts.at(0) > 0 ? 0 : 1;
+    counts.at(0) > 0 ? index.insert(0) : index.remove(0);
+    headers.invalidate();
+    for (int level = 0; level < strides.size(); ++level) {
+        QVERIFY(!headers.isValid(level));
+        compare(headers, level, counts, index, order);
+    }
+}
+
+#include "testheaderindex.moc"
@@ -0,0 +1,95 @@
+#include "hyperloglog.h"
+
+#include <QObject>
+#include <QString>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestHyperLogLog : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Small sets are counted exactly, duplicates included
+     */
+    void testExact();
+
+    /**
+     * Big sets are estimated within a few standard errors
+     */
+    void testEstimate();
+
+    /**
+     * Merging gives the sketch of the union, whether the sketches are exact or not
+     */
+    void testMerge();
+};
+QTEST_GUILESS_MAIN(TestHyperLogLog)
+
+namespace {
+
+HyperLogLog sketch_of(int begin, int end, int precision = 12) {
+    HyperLogLog rv(precision);
+    for (int value = begin; value < end; ++value) {
+        rv.add(HyperLogLog::hash(QString::number(value)));
+    }
+    return rv;
+}
+
+}
+
+void TestHyperLogLog::testExact() {
+    HyperLogLog sketch;
+    QVERIFY(sketch.isExact());
+    QCOMPARE(sketch.estimate(), 0.0);
+    for (int i = 0; i < 3; ++i) {
+        sketch.add(HyperLogLog::hash("Odense"));
+        sketch.add(HyperLogLog::hash("Ballerup"));
+    }
+    QVERIFY(sketch.isExact());
+    QCOMPARE(sketch.estimate(), 2.0);
+    QVERIFY(HyperLogLog::hash("Odense") != HyperLogLog::hash("odense"));
+    const HyperLogLog small = sketch_of(0, 500);
+    QVERIFY(small.isExact());
+    QCOMPARE(small.estimate(), 500.0);
+}
+
+void TestHyperLogLog::testEstimate() {
+    const int counts[] = { 1000, 5000, 20000, 100000 };
+    for (unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); ++i) {
+        const HyperLogLog sketch = sketch_of(0, counts[i]);
+        QVERIFY(!sketch.isExact());
+        // The standard error is 1.04/sqrt(4096), about 1.6%
+        const double error = qAbs(sketch.estimate() - counts[i]) / counts[i];
+        QVERIFY2(error < 0.05, qPrintable(QString("%1 estimated as %2").arg(counts[i]).arg(sketch.estimate())));
+    }
+}
+
+void TestHyperLogLog::testMerge() {
+    // Exact with exact, staying exact
+    HyperLogLog sketch = sketch_of(0, 100);
+    sketch.merge(sketch_of(50, 150));
+    QVERIFY(sketch.isExact());
+    QCOMPARE(sketch.estimate(), 150.0);
+
+    // Exact with exact, overflowing
+    sketch.merge(sketch_of(100, 600));
+    QVERIFY(!sketch.isExact());
+    QCOMPARE(sketch.estimate(), sketch_of(0, 600).estimate());
+
+    // Registers with exact, and exact with registers
+    HyperLogLog big = sketch_of(0, 10000);
+    HyperLogLog small = sketch_of(9900, 10100);
+    small.merge(big);
+    big.merge(sketch_of(9900, 10100));
+    QCOMPARE(small.estimate(), sketch_of(0, 10100).estimate());
+    QCOMPARE(big.estimate(), sketch_of(0, 10100).estimate());
+
+    // Registers with registers
+    HyperLogLog left = sketch_of(0, 20000);
+    left.merge(sketch_of(10000, 30000));
+    QCOMPARE(left.estimate(), sketch_of(0, 30000).estimate());
+}
+
+#include "testhyperloglog.moc"
@@ -0,0 +1,127 @@
+#include "measurestore.h"
+#include "cellstore.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestMeasureStore : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random adds and removes, compared to measures computed from scratch
+     */
+    void testAgainstScan();
+
+    /**
+     * Adding and removing measured columns
+     */
+    void testColumns();
+};
+QTEST_GUILESS_MAIN(TestMeasureStore)
+
+namespace {
+
+void compare(const MeasureStore& store, const CellStore& cells, int ncells) {
+    for (long cell = 0; cell < ncells; ++cell) {
+        const Measure* measures = store.find(cell);
+        QCOMPARE(measures != 0, cells.contains(cell));
+        if (!measures) {
+            continue;
+        }
+        for (int measure = 0; measure < store.count(); ++measure) {
+            Measure expected;
+            Q_FOREACH(int element, cells.elements(cell)) {
+                expected.add(store.value(measure, element));
+            }
+            // The values are small integers, so the sums are exact
+            QCOMPARE(measures[measure].count(), expected.count());
+            QCOMPARE(measures[measure].sum(), expected.sum());
+            QCOMPARE(measures[measure].sumOfSquares(), expected.sumOfSquares());
+            QCOMPARE(measures[measure].min(), expected.min());
+            QCOMPARE(measures[measure].max(), expected.max());
+        }
+    }
+}
+
+}
+
+void TestMeasureStore::testAgainstScan() {
+    const int ncells = 17;
+    const int nelements = 300;
+    CellStore cells;
+    MeasureStore store;
+    store.addColumn(3);
+    store.addColumn(5);
+    QVector<long> cell_of(nelements, -1);
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int element = (seed >> 8) % nelements;
+        if (cell_of.at(element) >= 0) {
+            const long cell = cell_of.at(element);
+            QVERIFY(cells.removeOne(cell, element));
+            store.remove(cell, element, cells);
+            cell_of[element] = -1;
+        } else {
+            seed = seed * 1103515245u + 12345u;
+            const long cell = (seed >> 8) % ncells;
+            store.setValue(0, element, int((seed >> 4) % 50));
+            store.setValue(1, element, -int((seed >> 12) % 7));
+            cells.append(cell, element);
+            store.add(cell, element);
+            cell_of[element] = cell;
+        }
+        if (i % 1000 == 0) {
+            compare(store, cells, ncells);
+        }
+    }
+    compare(store, cells, ncells);
+
+    // Changing a value in place, with the element still in its cell
+    for (int element = 0; element < nelements; ++element) {
+        const long cell = cell_of.at(element);
+        if (cell >= 0) {
+            store.remove(cell, element, cells);
+            store.setValue(0, element, 100 - store.value(0, element));
+            store.add(cell, element);
+        }
+    }
+    compare(store, cells, ncells);
+
+    store.rebuild(cells);
+    compare(store, cells, ncells);
+}
+
+void TestMeasureStore::testColumns() {
+    CellStore cells;
+    MeasureStore store;
+    QVERIFY(store.isEmpty());
+    QCOMPARE(store.addColumn(2), 0);
+    QCOMPARE(store.addColumn(4), 1);
+    QCOMPARE(store.indexOf(4), 1);
+    QCOMPARE(store.indexOf(3), -1);
+    for (int element = 0; element < 10; ++element) {
+        store.setValue(0, element, element);
+        store.setValue(1, element, 2*element);
+        cells.append(element % 3, element);
+    }
+    store.rebuild(cells);
+    QCOMPARE(store.find(1)[1].sum(), 2.0*(1+4+7));
+    QCOMPARE(store.find(1)[1].min(), 2.0);
+    QCOMPARE(store.find(1)[1].max(), 14.0);
+    QCOMPARE(store.find(1)[1].mean(), 2.0*4);
+    QCOMPARE(store.find(1)[1].variance(), 36.0);
+    QCOMPARE(store.find(1)[1].stddev(), 6.0);
+    store.removeColumn(0);
+    QCOMPARE(store.count(), 1);
+    QCOMPARE(store.column(0), 4);
+    QCOMPARE(store.find(1)[0].sum(), 2.0*(1+4+7));
+    compare(store, cells, 3);
+    QVERIFY(store.find(3) == 0);
+}
+
+#include "testmeasurestore.moc"
@@ -0,0 +1,151 @@
+#include "measuretotals.h"
+#include "measurestore.h"
+
+#include <QObject>
+#include <QTest>
+
+using namespace qdatacube;
+
+class TestMeasureTotals : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random adds and removes, compared to measures computed from scratch. Min and max are right unless
+     * marked stale, and right again after recomputing the stale groups
+     */
+    void testAgainstScan();
+
+    /**
+     * Groups built by appending and adding measures
+     */
+    void testAppend();
+
+    /**
+     * Groups moved and dropped keep their measures and staleness
+     */
+    void testRemap();
+};
+QTEST_GUILESS_MAIN(TestMeasureTotals)
+
+namespace {
+
+Measure scan(const MeasureStore& store, const QVector<int>& group_of, int group, int measure) {
+    Measure rv;
+    for (int element = 0; element < group_of.size(); ++element) {
+        if (group_of.at(element) == group) {
+            rv.add(store.value(measure, element));
+        }
+    }
+    return rv;
+}
+
+void compare(const MeasureTotals& totals, const MeasureStore& store, const QVector<int>& group_of, const QVector<int>& stale) {
+    for (int group = 0; group < totals.groupCount(); ++group) {
+        for (int measure = 0; measure < totals.measureCount(); ++measure) {
+            const Measure expected = scan(store, group_of, group, measure);
+            const Measure& measured = totals.measures(group)[measure];
+            // The values are small integers, so the sums are exact
+            QCOMPARE(measured.count(), expected.count());
+            QCOMPARE(measured.sum(), expected.sum());
+            QCOMPARE(measured.sumOfSquares(), expected.sumOfSquares());
+            if (!stale.contains(group)) {
+                QCOMPARE(measured.min(), expected.min());
+                QCOMPARE(measured.max(), expected.max());
+            }
+        }
+    }
+}
+
+}
+
+void TestMeasureTotals::testAgainstScan() {
+    const int ngroups = 5;
+    const int nelements = 200;
+    MeasureStore store;
+    store.addColumn(0);
+    store.addColumn(1);
+    MeasureTotals totals;
+    totals.reset(ngroups, store.count());
+    QVector<int> group_of(nelements, -1);
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 500; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            const int element = (seed >> 8) % nelements;
+            if (group_of.at(element) >= 0) {
+                totals.remove(group_of.at(element), store, element);
+                group_of[element] = -1;
+            } else {
+                seed = seed * 1103515245u + 12345u;
+                group_of[element] = (seed >> 8) % ngroups;
+                store.setValue(0, element, int((seed >> 4) % 50));
+                store.setValue(1, element, -int((seed >> 12) % 7));
+                totals.add(group_of.at(element), store, element);
+            }
+        }
+        const QVector<int> stale = totals.takeStale();
+        QVERIFY(!totals.hasStale());
+        compare(totals, store, group_of, stale);
+        Q_FOREACH(int group, stale) {
+            totals.clear(group);
+            QVector<Measure> measures;
+            for (int measure = 0; measure < store.count(); ++measure) {
+                measures << scan(store, group_of, group, measure);
+            }
+            totals.add(group, measures.constData());
+        }
+        compare(totals, store, group_of, QVector<int>());
+    }
+}
+
+void TestMeasureTotals::testAppend() {
+    MeasureTotals totals;
+    totals.reset(0, 1);
+    QCOMPARE(totals.groupCount(), 0);
+    Measure measure;
+    measure.add(3);
+    measure.add(5);
+    QCOMPARE(totals.appendGroup(), 0);
+    QCOMPARE(totals.appendGroup(), 1);
+    totals.add(1, &measure);
+    totals.add(1, &measure);
+    QCOMPARE(totals.groupCount(), 2);
+    QCOMPARE(totals.measures(0)->count(), 0);
+    QCOMPARE(totals.measures(1)->count(), 4);
+    QCOMPARE(totals.measures(1)->sum(), 16.0);
+    QCOMPARE(totals.measures(1)->min(), 3.0);
+    QCOMPARE(totals.measures(1)->max(), 5.0);
+
+    MeasureTotals none;
+    none.reset(3, 0);
+    QCOMPARE(none.groupCount(), 3);
+    QVERIFY(none.measures(2) == 0);
+}
+
+void TestMeasureTotals::testRemap() {
+    MeasureTotals totals;
+    totals.reset(3, 1);
+    Measure measure;
+    measure.add(2);
+    totals.add(0, &measure);
+    measure.add(7);
+    totals.add(2, &measure);
+    MeasureStore store;
+    store.addColumn(0);
+    store.setValue(0, 0, 7);
+    totals.remove(2, store, 0);
+    QVERIFY(totals.hasStale());
+    QVector<int> group_map;
+    group_map << 1 << -1 << 0;
+    totals.remap(group_map, 2);
+    QCOMPARE(totals.groupCount(), 2);
+    QCOMPARE(totals.measures(1)->count(), 1);
+    QCOMPARE(totals.measures(1)->sum(), 2.0);
+    QCOMPARE(totals.measures(0)->count(), 1);
+    QCOMPARE(totals.measures(0)->sum(), 2.0);
+    QCOMPARE(totals.takeStale(), QVector<int>() << 0);
+}
+
+#include "testmeasuretotals.moc"
@@ -59,13 +59,28 @@ int findCategoryIndexForString(AbstractAggregator::Ptr aggregator, QString strin
     return cat;
 }
 
+/**
+ * @return the section of datacube showing category of the aggregator in headerno, or -1
+ */
+int findSectionForCategory(const Datacube& datacube, Qt::Orientation orientation, int headerno, int category) {
+    const int nsections = orientation == Qt::Horizontal ? datacube.columnCount() : datacube.rowCount();
+    for (int section = 0; section < nsections; ++section) {
+        if (datacube.categoryIndex(orientation, headerno, section) == category) {
+            return section;
+        }
+    }
+    return -1;
+}
+
 void testplaincube::test_basics() {
   Datacube datacube(m_underlying_model, first_name_aggregator, last_name_aggregator);
   int larsen_cat = findCategoryIndexForString(last_name_aggregator, "Larsen");
   Q_ASSERT(larsen_cat != -1);
   int kim_cat = findCategoryIndexForString(first_name_aggregator, "Kim");
   Q_ASSERT(kim_cat != -1);
-  QList<int> rows = datacube.elements(kim_cat, larsen_cat);
+  QList<int> rows = datacube.elements(findSectionForCategory(datacube, Qt::Vertical, 0, kim_cat),
+                                      findSectionForCategory(datacube, Qt::Horizontal, 0, larsen_cat));
+  QVERIFY(!rows.isEmpty());
   Q_FOREACH(int row, rows) {
     QCOMPARE(m_underlying_model->data(m_underlying_model->index(row, testplaincube::FIRST_NAME)).toString(), QString::fromLocal8Bit("Kim"));
     QCOMPARE(m_underlying_model->data(m_underlying_model->index(row, testplaincube::LAST_NAME)).toString(), QString::fromLocal8Bit("Larsen"));
@@ -89,17 +104,21 @@ void testplaincube::test_split() {
   datacube.split(Qt::Horizontal, 1, sex_aggregator);
   QCOMPARE(datacube.headerCount(Qt::Horizontal), 2);
   QCOMPARE(datacube.headerCount(Qt::Vertical), 1);
-  // Test headers
-  int i = 0;
+  // Test headers. Categories are numbered in order of appearance, but shown sorted
+  QStringList kommunes;
   Q_FOREACH(Datacube::HeaderDescription header, datacube.headers(Qt::Horizontal, 0)) {
     QCOMPARE(header.span,2);
-    QCOMPARE(header.categoryIndex, i++);
+    kommunes << kommune_aggregator->categoryHeaderData(header.categoryIndex).toString();
   }
+  QCOMPARE(kommunes.size(), kommune_aggregator->categoryCount());
+  QStringList sorted_kommunes = kommunes;
+  qSort(sorted_kommunes);
+  QCOMPARE(kommunes, sorted_kommunes);
 
-  i = 0;
+  int i = 0;
   Q_FOREACH(Datacube::HeaderDescription header, datacube.headers(Qt::Horizontal, 1)) {
     QCOMPARE(header.span,1);
-    QCOMPARE(header.categoryIndex, i++ % 2);
+    QCOMPARE(sex_aggregator->categoryHeaderData(header.categoryIndex).toString(), QString(i++ % 2 ? "male" : "female"));
   }
 
   //Test sum of data
@@ -114,8 +133,10 @@ void testplaincube::test_split() {
   int pedersencat = findCategoryIndexForString(last_name_aggregator, "Pedersen");
   int malecat = findCategoryIndexForString(sex_aggregator, "male");
   int odensecat = findCategoryIndexForString(kommune_aggregator, "Odense");
-  int col = malecat+ sex_aggregator->categoryCount()*odensecat;
-  QCOMPARE(datacube.elementCount(pedersencat, col), 2);
+  // Sexes are shown in sorted order within each kommune
+  int col = findSectionForCategory(datacube, Qt::Horizontal, 0, odensecat) + 1;
+  QCOMPARE(datacube.categoryIndex(Qt::Horizontal, 1, col), malecat);
+  QCOMPARE(datacube.elementCount(findSectionForCategory(datacube, Qt::Vertical, 0, pedersencat), col), 2);
 
 }
 
@@ -676,12 +697,9 @@ void testplaincube::test_remove_category()
 
   Q_FOREACH(int row, aged20) {
     tmp_model->removeRow(row);
+    // The category goes with its last row
+    QCOMPARE(findCategoryIndexForString(age_aggregator, "20") == -1, row == aged20.last());
   }
-  // At this point, we should not see the removal triggered
-  QVERIFY(findCategoryIndexForString(age_aggregator,"20") != -1);
-
-  // Manually trigger removal
-  age_aggregator->resetCategories();
 
   // age_filter should now not have an "20" aged category
   QVERIFY(findCategoryIndexForString(age_aggregator, "20") == -1);
@@ -0,0 +1,97 @@
+#include "quantilestore.h"
+#include "cellstore.h"
+
+#include <QObject>
+#include <QTest>
+
+#include <algorithm>
+
+using namespace qdatacube;
+
+class TestQuantileStore : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Random adds and removes with digests asked for in between, compared to quantiles of the sorted values.
+     * There are few enough elements for the digests to stay exact
+     */
+    void testAgainstScan();
+};
+QTEST_GUILESS_MAIN(TestQuantileStore)
+
+namespace {
+
+const int nrows = 4;
+const int ncolumns = 3;
+
+double scan_quantile(const QVector<long>& cell_of, const QVector<double>& values, int row, int column, double q) {
+    QVector<double> rv;
+    for (int element = 0; element < cell_of.size(); ++element) {
+        const long cell = cell_of.at(element);
+        if (cell >= 0 && (row < 0 || cell % nrows == row) && (column < 0 || cell / nrows == column)) {
+            rv << values.at(element);
+        }
+    }
+    std::sort(rv.begin(), rv.end());
+    return TDigest::quantile(rv, q);
+}
+
+void compare(QuantileStore& store, const CellStore& cells, const QVector<long>& cell_of, const QVector<double>& values) {
+    const double qs[] = { 0.0, 0.5, 0.95 };
+    for (int i = 0; i < 3; ++i) {
+        const double q = qs[i];
+        for (int row = 0; row < nrows; ++row) {
+            for (int column = 0; column < ncolumns; ++column) {
+                QCOMPARE(store.cellDigest(0, row + column*nrows, cells).quantile(q), scan_quantile(cell_of, values, row, column, q));
+            }
+            QCOMPARE(store.rowDigest(0, row, cells, nrows, ncolumns).quantile(q), scan_quantile(cell_of, values, row, -1, q));
+        }
+        for (int column = 0; column < ncolumns; ++column) {
+            QCOMPARE(store.columnDigest(0, column, cells, nrows).quantile(q), scan_quantile(cell_of, values, -1, column, q));
+        }
+        QVERIFY(store.totalDigest(0, cells).isExact());
+        QCOMPARE(store.totalDigest(0, cells).quantile(q), scan_quantile(cell_of, values, -1, -1, q));
+    }
+}
+
+}
+
+void TestQuantileStore::testAgainstScan() {
+    const int nelements = 100;
+    CellStore cells;
+    QuantileStore store;
+    QCOMPARE(store.addColumn(7), 0);
+    QCOMPARE(store.indexOf(7), 0);
+    QCOMPARE(store.indexOf(3), -1);
+    QVector<long> cell_of(nelements, -1);
+    QVector<double> values(nelements);
+    // Simple linear congruential generator to stay deterministic
+    quint32 seed = 4711;
+    for (int i = 0; i < 3000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        const int element = (seed >> 8) % nelements;
+        if (cell_of.at(element) >= 0) {
+            const long cell = cell_of.at(element);
+            cells.removeOne(cell, element);
+            store.remove(cell, cell % nrows, cell / nrows);
+            cell_of[element] = -1;
+        } else {
+            seed = seed * 1103515245u + 12345u;
+            const long cell = (seed >> 8) % (nrows*ncolumns);
+            values[element] = double((seed >> 16) % 1000) / 10.0;
+            store.setValue(0, element, values.at(element));
+            cells.append(cell, element);
+            store.add(cell, cell % nrows, cell / nrows, element);
+            cell_of[element] = cell;
+        }
+        if (i % 150 == 0) {
+            compare(store, cells, cell_of, values);
+        }
+    }
+    compare(store, cells, cell_of, values);
+    store.clear();
+    compare(store, cells, cell_of, values);
+}
+
+#include "testquantilestore.moc"
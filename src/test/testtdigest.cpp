@@ -0,0 +1,127 @@
+#include "tdigest.h"
+
+#include <QObject>
+#include <QTest>
+
+#include <algorithm>
+
+using namespace qdatacube;
+
+class TestTDigest : public QObject {
+    Q_OBJECT
+private Q_SLOTS:
+
+    /**
+     * Small sets give the exact quantiles, interpolated between values
+     */
+    void testExact();
+
+    /**
+     * Big sets give quantiles close in rank to the true ones, closest at the ends
+     */
+    void testEstimate();
+
+    /**
+     * Merging gives about the digest of the union, whether the digests are exact or not
+     */
+    void testMerge();
+};
+QTEST_GUILESS_MAIN(TestTDigest)
+
+namespace {
+
+const int nvalues = 100000;
+
+/**
+ * Add the values begin to end-1 in a scrambled order, as 7919 is prime to nvalues
+ */
+TDigest digest_of(int begin, int end) {
+    TDigest rv;
+    for (int i = begin; i < end; ++i) {
+        rv.add(double(begin + qint64(i - begin) * 7919 % (end - begin)));
+    }
+    return rv;
+}
+
+/**
+ * Check that the quantiles of digest for the values 0 to n-1 are within max_rank_error (a fraction of n) of the truth
+ */
+void compare_ranks(const TDigest& digest, int n, double max_rank_error) {
+    const double qs[] = { 0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999 };
+    for (unsigned i = 0; i < sizeof(qs)/sizeof(qs[0]); ++i) {
+        const double estimate = digest.quantile(qs[i]);
+        // The values are their own ranks. The error allowed shrinks towards the ends, down to a rank or so
+        const double error = qAbs(estimate - qs[i] * (n - 1)) / n;
+        const double allowed = max_rank_error * qMax(4.0 * qs[i] * (1.0 - qs[i]), 0.2) + 1.0 / n;
+        QVERIFY2(error <= allowed, qPrintable(QString("quantile %1 estimated as %2").arg(qs[i]).arg(estimate)));
+    }
+}
+
+}
+
+void TestTDigest::testExact() {
+    TDigest digest;
+    QVERIFY(digest.isEmpty());
+    QCOMPARE(digest.quantile(0.5), 0.0);
+    const double values[] = { 7.0, 1.0, 3.0, 3.0, 10.0 };
+    QVector<double> sorted;
+    for (int i = 0; i < 5; ++i) {
+        digest.add(values[i]);
+        sorted << values[i];
+    }
+    std::sort(sorted.begin(), sorted.end());
+    QVERIFY(digest.isExact());
+    QCOMPARE(digest.count(), qint64(5));
+    QCOMPARE(digest.quantile(0.0), 1.0);
+    QCOMPARE(digest.quantile(0.5), 3.0);
+    QCOMPARE(digest.quantile(1.0), 10.0);
+    // Position 0.9*4 = 3.6, between 7 and 10
+    QCOMPARE(digest.quantile(0.9), 7.0 + 0.6*3.0);
+    QCOMPARE(digest.quantile(0.9), TDigest::quantile(sorted, 0.9));
+
+    const TDigest hundred = digest_of(0, 100);
+    QVERIFY(hundred.isExact());
+    QCOMPARE(hundred.quantile(0.95), 94.05);
+    QVERIFY(!digest_of(0, 101).isExact());
+}
+
+void TestTDigest::testEstimate() {
+    TDigest digest = digest_of(0, nvalues);
+    QVERIFY(!digest.isExact());
+    QCOMPARE(digest.count(), qint64(nvalues));
+    digest.compress();
+    compare_ranks(digest, nvalues, 0.005);
+    QCOMPARE(digest.quantile(0.0), 0.0);
+    QCOMPARE(digest.quantile(1.0), double(nvalues - 1));
+}
+
+void TestTDigest::testMerge() {
+    // Exact with exact, staying exact
+    TDigest digest = digest_of(0, 40);
+    digest.merge(digest_of(40, 80));
+    QVERIFY(digest.isExact());
+    QCOMPARE(digest.quantile(0.5), 39.5);
+
+    // Exact with exact, overflowing
+    digest.merge(digest_of(80, 200));
+    QVERIFY(!digest.isExact());
+    QCOMPARE(digest.count(), qint64(200));
+    compare_ranks(digest, 200, 0.01);
+
+    // Many digests merged, as for a total over many cells
+    TDigest total;
+    for (int begin = 0; begin < nvalues; begin += 1000) {
+        TDigest part = digest_of(begin, begin + 1000);
+        part.compress();
+        total.merge(part);
+    }
+    QCOMPARE(total.count(), qint64(nvalues));
+    compare_ranks(total, nvalues, 0.005);
+
+    // Exact into big
+    TDigest big = digest_of(0, nvalues - 50);
+    big.merge(digest_of(nvalues - 50, nvalues));
+    compare_ranks(big, nvalues, 0.005);
+}
+
+#include "testtdigest.moc"